@@ -23,6 +23,8 @@
 #if ETH_JSONRPC
 #include "EthStubServer.h"
 #include <libethcore/Instruction.h>
+#include <libevm/VMProfiler.h>
+#include <libevm/SHA3Cache.h>
 #include <liblll/Compiler.h>
 #include <libethereum/Client.h>
 #include "CommonJS.h"
@@ -170,6 +172,41 @@ Json::Value EthStubServer::block(const std::string& _hash)
 	return blockJson(_hash);
 }
 
+Json::Value EthStubServer::vmProfile()
+{
+	Json::Value res;
+	VMProfile p = VMProfiler::profile();
+	res["enabled"] = VMProfiler::enabled();
+	Json::Value ops(Json::objectValue);
+	for (unsigned i = 0; i < 256; ++i)
+		if (p.opcodes[i].count)
+		{
+			auto info = c_instructionInfo.find((Instruction)i);
+			Json::Value o;
+			o["count"] = to_string(p.opcodes[i].count);
+			o["gas"] = to_string(p.opcodes[i].gas);
+			o["cycles"] = to_string(p.opcodes[i].cycles);
+			ops[info != c_instructionInfo.end() ? info->second.name : toHex(bytes(1, (byte)i))] = o;
+		}
+	res["opcodes"] = ops;
+	Json::Value code(Json::objectValue);
+	for (auto const& i: p.code)
+	{
+		Json::Value c;
+		c["runs"] = to_string(i.second.runs);
+		c["steps"] = to_string(i.second.steps);
+		c["gas"] = to_string(i.second.gas);
+		c["cycles"] = to_string(i.second.cycles);
+		code[toHex(i.first.ref())] = c;
+	}
+	res["code"] = code;
+	Json::Value sha3;
+	sha3["hits"] = to_string(SHA3Cache::totalHits());
+	sha3["misses"] = to_string(SHA3Cache::totalMisses());
+	res["sha3Cache"] = sha3;
+	return res;
+}
+
 Json::Value EthStubServer::blockJson(const std::string& _hash)
 {
 	Json::Value res;
@@ -55,6 +55,7 @@ public:
 	virtual Json::Value lastBlock();
 	virtual std::string lll(const std::string& s);
 	virtual Json::Value block(const std::string&);
+	virtual Json::Value vmProfile();
 	void setKeys(std::vector<eth::KeyPair> _keys) { m_keys = _keys; }
 private:
 	eth::Client& m_client;
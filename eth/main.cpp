@@ -33,6 +33,9 @@
 #include <libethereum/PeerNetwork.h>
 #include <libethereum/BlockChain.h>
 #include <libethereum/State.h>
+#include <libevm/VMProfiler.h>
+#include <libevm/SHA3Cache.h>
+#include <libevm/VMTrace.h>
 #include <libethcore/CommonEth.h>
 #if ETH_READLINE
 #include <readline/readline.h>
@@ -75,10 +78,13 @@ void interactiveHelp()
 		<< "    block  Gives the current block height." << endl
 		<< "    balance  Gives the current balance." << endl
 		<< "    peers  List the peers that are connected" << endl
+		<< "    txqueue  Shows how full the transaction queue is and what's come of the transactions sent to it." << endl
 		<< "    transact  Execute a given transaction." << endl
 		<< "    send  Execute a given transaction with current secret." << endl
 		<< "    contract  Create a new contract with current secret." << endl
 		<< "    inspect <contract> Dumps a contract to <APPDATA>/<contract>.evm." << endl
+		<< "    vmprofile (on|off|reset)  Turns VM profiling on or off, resets it, or shows the profile so far." << endl
+		<< "    vmtrace <file>|off  Traces everything the VM runs to the given file (read it with evmtrace), or stops." << endl
 		<< "    exit  Exits the application." << endl;
 }
 
@@ -102,8 +108,10 @@ void help()
         << "    -n,--upnp <on/off>  Use upnp for NAT (default: on)." << endl
         << "    -o,--mode <full/peer>  Start a full node or a peer node (Default: full)." << endl
         << "    -p,--port <port>  Connect to remote port (default: 30303)." << endl
+        << "    -P,--prune <blocks/off>  Delete state older than the given number of blocks, but for checkpoints (default: off)." << endl
         << "    -r,--remote <host>  Connect to remote host (default: none)." << endl
         << "    -s,--secret <secretkeyhex>  Set the secret key for use with send command (default: auto)." << endl
+        << "    -t,--vm-trace <file>  Trace everything the VM runs to file; read it with evmtrace (default: off)." << endl
         << "    -u,--public-ip <ip>  Force public ip to given (default; auto)." << endl
         << "    -v,--verbosity <0 - 9>  Set the log verbosity from 0 to 9 (Default: 8)." << endl
         << "    -x,--peers <number>  Attempt to connect to given number of peers (Default: 5)." << endl
@@ -176,6 +184,7 @@ int main(int argc, char** argv)
 #endif
 	string publicIP;
 	bool upnp = true;
+	unsigned prune = 0;
 	string clientName;
 
 	// Init defaults
@@ -247,6 +256,21 @@ int main(int argc, char** argv)
 				return -1;
 			}
 		}
+		else if ((arg == "-P" || arg == "--prune") && i + 1 < argc)
+		{
+			string m = argv[++i];
+			if (isTrue(m))
+				prune = c_defaultPruneHistory;
+			else if (isFalse(m))
+				prune = 0;
+			else if (int i = stoi(m))
+				prune = i;
+			else
+			{
+				cerr << "Unknown pruning option: " << m << endl;
+				return -1;
+			}
+		}
 		else if (arg == "-i" || arg == "--interactive")
 			interactive = true;
 #if ETH_JSONRPC
@@ -257,6 +281,19 @@ int main(int argc, char** argv)
 #endif
 		else if ((arg == "-v" || arg == "--verbosity") && i + 1 < argc)
 			g_logVerbosity = atoi(argv[++i]);
+		else if ((arg == "-t" || arg == "--vm-trace") && i + 1 < argc)
+		{
+			string f = argv[++i];
+			try
+			{
+				VMTracer::open(f);
+			}
+			catch (BadVMTrace const&)
+			{
+				cerr << "Can't write VM trace to " << f << endl;
+				return -1;
+			}
+		}
 		else if ((arg == "-x" || arg == "--peers") && i + 1 < argc)
 			peers = atoi(argv[++i]);
 		else if ((arg == "-o" || arg == "--mode") && i + 1 < argc)
@@ -283,6 +320,8 @@ int main(int argc, char** argv)
 	if (!clientName.empty())
 		clientName += "/";
     Client c("Ethereum(++)/" + clientName + "v" + eth::EthVersion + "/" ETH_QUOTED(ETH_BUILD_TYPE) "/" ETH_QUOTED(ETH_BUILD_PLATFORM), coinbase, dbPath);
+	if (prune)
+		c.setPruning(prune);
 	cout << credits();
 
 	cout << "Address: " << endl << toHex(us.address().asArray()) << endl;
@@ -400,6 +439,12 @@ int main(int argc, char** argv)
 						<< std::chrono::duration_cast<std::chrono::milliseconds>(it.lastPing).count() << "ms"
 						<< endl;
 			}
+			else if (cmd == "txqueue")
+			{
+				auto s = c.transactionQueueStatus();
+				cout << "Transaction queue: " << s.transactions << " transactions from " << s.senders << " senders, " << s.bytes << " bytes" << endl;
+				cout << s.imported << " imported, " << s.known << " known, " << s.rejected << " rejected, " << s.replaced << " replaced, " << s.evicted << " evicted" << endl;
+			}
 			else if (cmd == "balance")
 			{
 				ClientGuard g(&c);
@@ -561,6 +606,38 @@ int main(int argc, char** argv)
 					ofs.close();
 				}
 			}
+			else if (cmd == "vmprofile")
+			{
+				string arg;
+				iss >> arg;
+				if (arg == "on" || arg == "off")
+					VMProfiler::setEnabled(arg == "on");
+				else if (arg == "reset")
+					VMProfiler::reset();
+				else
+				{
+					cout << VMProfiler::profile();
+					cout << "SHA3 cache: " << SHA3Cache::totalHits() << " hits, " << SHA3Cache::totalMisses() << " misses" << endl;
+				}
+				cout << "VM profiling is " << (VMProfiler::enabled() ? "on" : "off") << endl;
+			}
+			else if (cmd == "vmtrace")
+			{
+				string arg;
+				iss >> arg;
+				if (arg.empty() || arg == "off")
+					VMTracer::close();
+				else
+					try
+					{
+						VMTracer::open(arg);
+					}
+					catch (BadVMTrace const&)
+					{
+						cout << "Can't write to " << arg << endl;
+					}
+				cout << "VM tracing is " << (VMTracer::active() ? "on" : "off") << endl;
+			}
 			else if (cmd == "help")
 				interactiveHelp();
 			else if (cmd == "exit")
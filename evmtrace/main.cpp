@@ -0,0 +1,166 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file main.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * Reader for binary VM traces.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <libethsupport/CommonIO.h>
+#include <libethsupport/CommonData.h>
+#include <libethcore/Instruction.h>
+#include <libevm/VMTrace.h>
+#include "BuildInfo.h"
+using namespace std;
+using namespace eth;
+
+void help()
+{
+	cout
+		<< "Usage evmtrace [OPTIONS] <file>" << endl
+		<< "Options:" << endl
+		<< "    -s,--state  Show the stack, memory and storage written before each step." << endl
+		<< "    -u,--summary  Only show how many times each instruction ran and the gas it took." << endl
+		<< "    -h,--help  Show this help message and exit." << endl
+		<< "    -V,--version  Show the version and exit." << endl;
+		exit(0);
+}
+
+void version()
+{
+	cout << "evmtrace, the VM trace reader " << eth::EthVersion << endl;
+	cout << "  By Gav Wood, (c) 2014." << endl;
+	cout << "Build: " << ETH_QUOTED(ETH_BUILD_PLATFORM) << "/" << ETH_QUOTED(ETH_BUILD_TYPE) << endl;
+	exit(0);
+}
+
+enum Mode { Steps, State, Summary };
+
+static string name(Instruction _i)
+{
+	auto it = c_instructionInfo.find(_i);
+	return it != c_instructionInfo.end() ? it->second.name : "0x" + toHex(bytes(1, (byte)_i));
+}
+
+static void showState(VMTraceFrame const& _f, string const& _indent)
+{
+	cout << _indent << "    STACK" << endl;
+	for (auto i: _f.stack)
+		cout << _indent << (h256)i << endl;
+	cout << _indent << "    MEMORY" << endl << memDump(_f.memory);
+	cout << _indent << "    STORAGE" << endl;
+	for (auto const& i: _f.storage)
+		cout << _indent << showbase << hex << i.first << ": " << i.second << dec << endl;
+}
+
+int main(int argc, char** argv)
+{
+	string infile;
+	Mode mode = Steps;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "-h" || arg == "--help")
+			help();
+		else if (arg == "-s" || arg == "--state")
+			mode = State;
+		else if (arg == "-u" || arg == "--summary")
+			mode = Summary;
+		else if (arg == "-V" || arg == "--version")
+			version();
+		else
+			infile = argv[i];
+	}
+
+	bytes trace = contents(infile);
+	if (trace.empty())
+	{
+		cerr << "Empty or missing trace: " << infile << endl;
+		return 1;
+	}
+
+	map<Instruction, pair<uint64_t, u256>> summary;
+	uint64_t steps = 0;
+	uint64_t runs = 0;
+	try
+	{
+		VMTraceReader r(&trace);
+		// For each run, the instruction last started and the gas it had, if there was one; for the summary.
+		vector<pair<Instruction, u256>> last;
+		vector<bool> started;
+		auto retire = [&]()
+		{
+			if (started.back())
+			{
+				summary[last.back().first].first++;
+				summary[last.back().first].second += last.back().second - r.gas();
+			}
+		};
+		while (r.next())
+		{
+			string indent(r.depth() * 4, ' ');
+			switch (r.record())
+			{
+			case VMTraceRecord::Enter:
+				++runs;
+				last.push_back(make_pair(Instruction::STOP, u256(0)));
+				started.push_back(false);
+				if (mode != Summary)
+					cout << indent << ">>> " << r.frame().address << " (" << r.frame().codeHash.abridged() << ") at " << r.pc() << " with " << r.gas() << " gas" << endl;
+				break;
+			case VMTraceRecord::Step:
+				retire();
+				last.back() = make_pair(r.instruction(), r.gas());
+				started.back() = true;
+				if (mode == State)
+					showState(r.frame(), indent);
+				if (mode != Summary)
+					cout << indent << " | #" << steps << " | " << hex << setw(4) << setfill('0') << r.pc() << setfill(' ') << " : " << name(r.instruction()) << " | " << dec << r.gas() << " ]" << endl;
+				++steps;
+				break;
+			case VMTraceRecord::Effects:
+				break;
+			case VMTraceRecord::Exit:
+				retire();
+				last.pop_back();
+				started.pop_back();
+				if (mode == State)
+					showState(r.frame(), indent);
+				if (mode != Summary)
+					cout << indent << "<<< " << (r.exit() == VMTraceExit::Halted ? "halted" : r.exit() == VMTraceExit::Excepted ? "exception" : "paused") << " with " << r.gas() << " gas" << endl;
+				break;
+			}
+		}
+	}
+	catch (BadVMTrace const&)
+	{
+		cerr << "Bad trace after " << steps << " steps." << endl;
+		return 1;
+	}
+
+	if (mode == Summary)
+	{
+		cout << runs << " runs, " << steps << " steps." << endl;
+		cout << "OPCODE          COUNT                   GAS" << endl;
+		for (auto const& i: summary)
+			cout << left << setw(12) << name(i.first) << right << setw(9) << i.second.first << setw(22) << i.second.second << endl;
+	}
+	return 0;
+}
@@ -21,46 +21,67 @@
 
 #pragma once
 
+#include <set>
 #include <libethsupport/Common.h>
 #include <libethsupport/RLP.h>
+#include <libethsupport/FlatHashMap.h>
+#include <libethcore/CommonEth.h>
 
 namespace eth
 {
 
+/// An account's storage overlay: the values of the locations that have been read or written.
+using StorageOverlay = FlatHashMap<u256, u256, U256Hash>;
+
 // TODO: Document fully.
 
 class AddressState
 {
 public:
-	AddressState(): m_isAlive(false), m_nonce(0), m_balance(0) {}
-	AddressState(u256 _nonce, u256 _balance, h256 _contractRoot, h256 _codeHash): m_isAlive(true), m_nonce(_nonce), m_balance(_balance), m_storageRoot(_contractRoot), m_codeHash(_codeHash) {}
+	AddressState(): m_isAlive(false), m_isDirty(true), m_nonce(0), m_balance(0) {}
+	AddressState(u256 _nonce, u256 _balance, h256 _contractRoot, h256 _codeHash): m_isAlive(true), m_isDirty(true), m_nonce(_nonce), m_balance(_balance), m_storageRoot(_contractRoot), m_codeHash(_codeHash) {}
 
-	void kill() { m_isAlive = false; m_storageOverlay.clear(); m_codeHash = EmptySHA3; m_storageRoot = h256(); m_balance = 0; m_nonce = 0; }
+	void kill() { m_isAlive = false; m_isDirty = true; m_storageOverlay.clear(); m_dirtyStorage.clear(); m_codeHash = EmptySHA3; m_storageRoot = h256(); m_balance = 0; m_nonce = 0; }
 	bool isAlive() const { return m_isAlive; }
 
+	/// @returns true if the account may differ from its entry in the state trie, and so needs writing back to it.
+	/// New accounts are dirty; those read from the trie are not until they're changed.
+	bool isDirty() const { return m_isDirty; }
+
+	/// Note that the account is now just as its entry in the state trie, with storage root @a _storageRoot.
+	/// Fresh code gets its hash.
+	void noteCommitted(h256 _storageRoot) { m_storageRoot = _storageRoot; if (!m_codeHash) m_codeHash = sha3(m_codeCache); m_dirtyStorage.clear(); m_isDirty = false; }
+
+	/// @note Changing the balance or nonce through these doesn't make the account dirty.
 	u256& balance() { return m_balance; }
 	u256 const& balance() const { return m_balance; }
-	void addBalance(bigint _i) { m_balance = (u256)((bigint)m_balance + _i); }
+	void addBalance(bigint _i) { m_balance = (u256)((bigint)m_balance + _i); m_isDirty = true; }
 
 	u256& nonce() { return m_nonce; }
 	u256 const& nonce() const { return m_nonce; }
-	void incNonce() { m_nonce++; }
+	void incNonce() { m_nonce++; m_isDirty = true; }
 
 	h256 oldRoot() const { return m_storageRoot; }
-	std::map<u256, u256> const& storage() const { return m_storageOverlay; }
-	void setStorage(u256 _p, u256 _v) { m_storageOverlay[_p] = _v; }
+	StorageOverlay const& storage() const { return m_storageOverlay; }
+	/// @returns the storage locations written since the account was last committed; each is in storage().
+	std::set<u256> const& dirtyStorage() const { return m_dirtyStorage; }
+	void setStorage(u256 _p, u256 _v) { m_storageOverlay[_p] = _v; m_dirtyStorage.insert(_p); m_isDirty = true; }
+	/// Take on the nonce and balance of @a _s, a changed copy of this account, and the storage locations written in it.
+	void mergeChanges(AddressState const& _s) { m_nonce = _s.m_nonce; m_balance = _s.m_balance; for (auto const& i: _s.m_dirtyStorage) setStorage(i, _s.m_storageOverlay.at(i)); m_isDirty = true; }
+	void noteStorage(u256 _p, u256 _v) { m_storageOverlay[_p] = _v; }
+	void dropStorage(u256 _p) { m_storageOverlay.erase(_p); m_dirtyStorage.erase(_p); }
 
 	bool isFreshCode() const { return !m_codeHash; }
 	bool codeBearing() const { return m_codeHash != EmptySHA3; }
 	bool codeCacheValid() const { return m_codeHash == EmptySHA3 || !m_codeHash || m_codeCache.size(); }
 	h256 codeHash() const { assert(m_codeHash); return m_codeHash; }
 	bytes const& code() const { assert(m_codeHash == EmptySHA3 || !m_codeHash || m_codeCache.size()); return m_codeCache; }
-	void setCode(bytesConstRef _code) { assert(!m_codeHash); m_codeCache = _code.toBytes(); }
+	void setCode(bytesConstRef _code) { assert(!m_codeHash); m_codeCache = _code.toBytes(); m_isDirty = true; }
 	void noteCode(bytesConstRef _code) { assert(sha3(_code) == m_codeHash); m_codeCache = _code.toBytes(); }
 
 private:
 	bool m_isAlive;
-	bool m_gotCode;
+	bool m_isDirty;
 	u256 m_nonce;
 	u256 m_balance;
 
@@ -72,11 +93,14 @@ private:
 	/// If anything else, then m_code is valid iff it's not empty, otherwise, State::ensureCached() needs to be called with the correct args.
 	h256 m_codeHash;
 
-	// TODO: change to unordered_map.
-	std::map<u256, u256> m_storageOverlay;
+	StorageOverlay m_storageOverlay;
+	std::set<u256> m_dirtyStorage;		///< The locations in m_storageOverlay set since the account was last committed.
 	bytes m_codeCache;
 };
 
+/// A set of accounts, by address.
+using AddressStateMap = FlatHashMap<Address, AddressState>;
+
 }
 
 
@@ -66,9 +66,9 @@ bytes BlockDetails::rlp() const
 	return rlpList(number, totalDifficulty, parent, children);
 }
 
-std::map<Address, AddressState> const& eth::genesisState()
+AddressStateMap const& eth::genesisState()
 {
-	static std::map<Address, AddressState> s_ret;
+	static AddressStateMap s_ret;
 	if (s_ret.empty())
 		// Initialise.
 		for (auto i: vector<string>({
@@ -97,7 +97,8 @@ bytes BlockChain::createGenesisBlock()
 		MemoryDB db;
 		TrieDB<Address, MemoryDB> state(&db);
 		state.init();
-		eth::commit(genesisState(), db, state);
+		AddressStateMap genesis = genesisState();
+		eth::commit(genesis, db, state);
 		stateRoot = state.root();
 	}
 
@@ -108,7 +109,8 @@ bytes BlockChain::createGenesisBlock()
 	return block.out();
 }
 
-BlockChain::BlockChain(std::string _path, bool _killExisting)
+BlockChain::BlockChain(std::string _path, bool _killExisting, unsigned _checkpointInterval):
+	m_checkpointInterval(_checkpointInterval)
 {
 	if (_path.empty())
 		_path = Defaults::get()->m_dbPath;
@@ -257,6 +259,8 @@ void BlockChain::import(bytes const& _block, OverlayDB const& _db)
 			lock_guard<mutex> l(m_lock);
 			m_details[newHash] = BlockDetails((uint)pd.number + 1, td, bi.parentHash, {});
 			m_details[bi.parentHash].children.push_back(newHash);
+			if ((pd.number + 1) % m_checkpointInterval == 0)
+				m_checkpoints[newHash] = bi.stateRoot;
 		}
 
 		m_detailsDB->Put(m_writeOptions, ldb::Slice((char const*)&newHash, 32), (ldb::Slice)eth::ref(m_details[newHash].rlp()));
@@ -292,6 +296,8 @@ void BlockChain::import(bytes const& _block, OverlayDB const& _db)
 
 void BlockChain::checkConsistency()
 {
+	// Look out for checkpoints too, as we're going through every block.
+	map<h256, h256> checkpoints;
 	m_details.clear();
 	ldb::Iterator* it = m_detailsDB->NewIterator(m_readOptions);
 	for (it->SeekToFirst(); it->Valid(); it->Next())
@@ -299,6 +305,8 @@ void BlockChain::checkConsistency()
 		{
 			h256 h((byte const*)it->key().data(), h256::ConstructFromPointer);
 			auto dh = details(h);
+			if (dh.number % m_checkpointInterval == 0)
+				checkpoints[h] = BlockInfo(block(h)).stateRoot;
 			auto p = dh.parent;
 			if (p != h256())
 			{
@@ -308,6 +316,8 @@ void BlockChain::checkConsistency()
 			}
 		}
 	delete it;
+	lock_guard<mutex> l(m_lock);
+	m_checkpoints = checkpoints;
 }
 
 bytesConstRef BlockChain::block(h256 _hash) const
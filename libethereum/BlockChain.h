@@ -55,6 +55,8 @@ typedef std::map<h256, BlockDetails> BlockDetailsHash;
 static const BlockDetails NullBlockDetails;
 static const h256s NullH256s;
 
+static const unsigned c_checkpointInterval = 1000;	///< By default, every block whose number is a multiple of this is a checkpoint.
+
 class OverlayDB;
 
 class AlreadyHaveBlock: public std::exception {};
@@ -65,7 +67,7 @@ struct BlockChainChat: public LogChannel { static const char* name() { return "-
 struct BlockChainNote: public LogChannel { static const char* name() { return "=B="; } static const int verbosity = 4; };
 
 // TODO: Move all this Genesis stuff into Genesis.h/.cpp
-std::map<Address, AddressState> const& genesisState();
+AddressStateMap const& genesisState();
 
 /**
  * @brief Implements the blockchain database. All data this gives is disk-backed.
@@ -74,7 +76,9 @@ class BlockChain
 {
 public:
 	BlockChain(bool _killExisting = false): BlockChain(std::string(), _killExisting) {}
-	BlockChain(std::string _path, bool _killExisting = false);
+	/// Open the block chain DB at @a _path, where every block whose number is a multiple of @a _checkpointInterval is a
+	/// checkpoint.
+	BlockChain(std::string _path, bool _killExisting = false, unsigned _checkpointInterval = c_checkpointInterval);
 	~BlockChain();
 
 	/// (Potentially) renders invalid existing bytesConstRef returned by lastBlock.
@@ -104,6 +108,10 @@ public:
 	/// Get the hash of the genesis block.
 	h256 genesisHash() const { return m_genesisHash; }
 
+	/// @returns the checkpoints, mapped to their state roots. A checkpoint's state is never pruned, so State::sync() never
+	/// has to play back from further than the last one before where it's going. Thread-safe.
+	std::map<h256, h256> checkpoints() const { std::lock_guard<std::mutex> l(m_lock); return m_checkpoints; }
+
 	std::vector<std::pair<Address, AddressState>> interestQueue() { std::vector<std::pair<Address, AddressState>> ret; swap(ret, m_interestQueue); return ret; }
 	void pushInterest(Address _a) { m_interest[_a]++; }
 	void popInterest(Address _a) { if (m_interest[_a] > 1) m_interest[_a]--; else if (m_interest[_a]) m_interest.erase(_a); }
@@ -117,6 +125,8 @@ private:
 	/// Get fully populated from disk DB.
 	mutable BlockDetailsHash m_details;
 	mutable std::map<h256, std::string> m_cache;
+	std::map<h256, h256> m_checkpoints;		///< The hashes of the checkpoint blocks we have, and their state roots.
+	unsigned m_checkpointInterval;
 	mutable std::mutex m_lock;
 
 	/// The queue of transactions that have happened that we're interested in.
@@ -179,6 +179,15 @@ void Client::inject(bytesConstRef _rlp)
 	m_changed = true;
 }
 
+void Client::setPruning(unsigned _history)
+{
+	lock_guard<recursive_mutex> l(m_lock);
+	if (_history)
+		m_pruner.reset(new StatePruner(m_stateDB, _history));
+	else
+		m_pruner.reset();
+}
+
 void Client::work()
 {
 	bool changed = false;
@@ -218,6 +227,8 @@ void Client::work()
 				cnote << "Additional transaction ready: Restarting mining operation.";
 			m_restartMining = true;
 		}
+		if (m_pruner)
+			m_pruner->noteChain(m_bc);
 	}
 
 	if (m_doMine)
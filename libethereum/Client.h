@@ -30,6 +30,7 @@
 #include "BlockChain.h"
 #include "TransactionQueue.h"
 #include "State.h"
+#include "StatePruner.h"
 #include "PeerNetwork.h"
 
 namespace eth
@@ -104,6 +105,12 @@ public:
 	/// @returns incoming minable transactions that we wanted to be notified of. Clears the queue.
 	Transactions pendingQueue() { ClientGuard g(this); return m_tq.interestQueue(); }
 
+	/// @returns how full the transaction queue is and what's happened to the transactions that came to it.
+	TransactionQueueStatus transactionQueueStatus() { ClientGuard g(this); return m_tq.status(); }
+
+	/// Bound the transaction queue to @a _transactions transactions, @a _bytes bytes and @a _perSender transactions per sender.
+	void setTransactionQueueLimits(size_t _transactions, size_t _bytes, size_t _perSender) { ClientGuard g(this); m_tq.setLimits(_transactions, _bytes, _perSender); }
+
 	/// @returns alterations in state of a mined block that we wanted to be notified of. Clears the queue.
 	std::vector<std::pair<Address, AddressState>> minedQueue() { ClientGuard g(this); return m_bc.interestQueue(); }
 
@@ -161,6 +168,12 @@ public:
 	void setParanoia(bool _p) { m_paranoia = _p; }
 	/// Set the coinbase address.
 	void setAddress(Address _us) { m_preMine.setAddress(_us); }
+
+	/// Delete state DB nodes that neither the last @a _history blocks' states nor the checkpoints' need, as blocks come
+	/// in. Stop pruning if @a _history is 0.
+	void setPruning(unsigned _history);
+	/// Get the pruner, or null if we're not pruning.
+	StatePruner const* pruner() const { return m_pruner.get(); }
 	/// Get the coinbase address.
 	Address address() const { return m_preMine.address(); }
 	/// Start mining.
@@ -187,6 +200,7 @@ private:
 	State m_preMine;					///< The present state of the client.
 	State m_postMine;					///< The state of the client which we're mining (i.e. it'll have all the rewards added).
 	std::unique_ptr<PeerServer> m_net;	///< Should run in background and send us events when blocks found and allow us to send blocks as required.
+	std::unique_ptr<StatePruner> m_pruner;	///< Deletes old state from m_stateDB, if we're pruning.
 	
 	std::unique_ptr<std::thread> m_work;///< The work thread.
 	
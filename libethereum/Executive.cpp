@@ -20,19 +20,22 @@
  */
 
 #include <libevm/VM.h>
+#include <libevm/VMArena.h>
 #include "Executive.h"
 #include "State.h"
 #include "ExtVM.h"
 using namespace std;
 using namespace eth;
 
-#define EVM_TRACE 1
-
 Executive::~Executive()
 {
 	// TODO: Make safe.
 	delete m_ext;
-	delete m_vm;
+	if (m_vm)
+		VMArena::threadArena().release(m_vm);
+
+	// The transaction's done; let the arena give back anything it had to grow for it.
+	VMArena::threadArena().endTransaction();
 }
 
 u256 Executive::gasUsed() const
@@ -41,9 +44,14 @@ u256 Executive::gasUsed() const
 }
 
 void Executive::setup(bytesConstRef _rlp)
+{
+	setup(Transaction(_rlp));
+}
+
+void Executive::setup(Transaction const& _t)
 {
 	// Entry point for a user-executed transaction.
-	m_t = Transaction(_rlp);
+	m_t = _t;
 
 	m_sender = m_t.sender();
 
@@ -107,9 +115,9 @@ void Executive::call(Address _receiveAddress, Address _senderAddress, u256 _valu
 
 	if (m_s.addressHasCode(_receiveAddress))
 	{
-		m_vm = new VM(_gas);
+		m_vm = VMArena::threadArena().acquire(_gas, m_vmKind);
 		bytes const& c = m_s.code(_receiveAddress);
-		m_ext = new ExtVM(m_s, _receiveAddress, _senderAddress, _originAddress, _value, _gasPrice, _data, &c);
+		m_ext = new ExtVM(m_s, _receiveAddress, _senderAddress, _originAddress, _value, _gasPrice, _data, &c, m_s.codeHash(_receiveAddress), m_vmKind);
 	}
 	else
 		m_endGas = _gas;
@@ -122,11 +130,11 @@ void Executive::create(Address _sender, u256 _endowment, u256 _gasPrice, u256 _g
 		m_newAddress = (u160)m_newAddress + 1;
 
 	// Set up new account...
-	m_s.m_cache[m_newAddress] = AddressState(0, _endowment, h256(), h256());
+	m_s.setAccount(m_newAddress, AddressState(0, _endowment, h256(), h256()));
 
 	// Execute _init.
-	m_vm = new VM(_gas);
-	m_ext = new ExtVM(m_s, m_newAddress, _sender, _origin, _endowment, _gasPrice, bytesConstRef(), _init);
+	m_vm = VMArena::threadArena().acquire(_gas, m_vmKind);
+	m_ext = new ExtVM(m_s, m_newAddress, _sender, _origin, _endowment, _gasPrice, bytesConstRef(), _init, h256(), m_vmKind);
 }
 
 bool Executive::go(uint64_t _steps)
@@ -136,34 +144,7 @@ bool Executive::go(uint64_t _steps)
 		bool revert = false;
 		try
 		{
-#if ETH_VMTRACE
-			if (_steps == (uint64_t)0 - 1)
-				for (uint64_t s = 0;; ++s)
-				{
-					ostringstream o;
-					o << endl << "    STACK" << endl;
-					for (auto i: vm().stack())
-						o << (h256)i << endl;
-					o << "    MEMORY" << endl << memDump(vm().memory());
-					o << "    STORAGE" << endl;
-					for (auto const& i: state().storage(ext().myAddress))
-						o << showbase << hex << i.first << ": " << i.second << endl;
-					eth::LogOutputStream<VMTraceChannel, false>(true) << o.str();
-					eth::LogOutputStream<VMTraceChannel, false>(false) << dec << " | #" << s << " | " << hex << setw(4) << setfill('0') << vm().curPC() << " : " << c_instructionInfo.at((Instruction)ext().getCode(vm().curPC())).name << " | " << dec << vm().gas() << " ]";
-					if (s >= _steps)
-						break;
-					try
-					{
-						m_out = m_vm->go(*m_ext, 1);
-						break;
-					}
-					catch (StepsDone const&) {}
-				}
-			else
-				m_out = m_vm->go(*m_ext, _steps);
-#else
 			m_out = m_vm->go(*m_ext, _steps);
-#endif
 			m_endGas = m_vm->gas();
 		}
 		catch (StepsDone const&)
@@ -211,7 +192,7 @@ void Executive::finalize()
 {
 	if (m_t.isCreation() && m_newAddress && m_out.size())
 		// non-reverted creation - put code in place.
-		m_s.m_cache[m_newAddress].setCode(m_out);
+		m_s.setCode(m_newAddress, m_out);
 
 //	cnote << "Refunding" << formatBalance(m_endGas * m_ext->gasPrice) << "to origin (=" << m_endGas << "*" << formatBalance(m_ext->gasPrice) << ")";
 	m_s.addBalance(m_sender, m_endGas * m_t.gasPrice);
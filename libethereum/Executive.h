@@ -23,6 +23,7 @@
 
 #include <libethsupport/Log.h>
 #include <libethcore/CommonEth.h>
+#include <libevm/ExtVMFace.h>
 #include "Transaction.h"
 
 namespace eth
@@ -32,15 +33,15 @@ class VM;
 class ExtVM;
 class State;
 
-struct VMTraceChannel: public LogChannel { static const char* name() { return "EVM"; } static const int verbosity = 11; };
-
 class Executive
 {
 public:
-	Executive(State& _s): m_s(_s) {}
+	/// Execute on @a _s, running any code with the engine @a _kind.
+	Executive(State& _s, VMKind _kind = VMKind::Interpreter): m_s(_s), m_vmKind(_kind) {}
 	~Executive();
 
 	void setup(bytesConstRef _transaction);
+	void setup(Transaction const& _transaction);
 	void create(Address _txSender, u256 _endowment, u256 _gasPrice, u256 _gas, bytesConstRef _code, Address _originAddress);
 	void call(Address _myAddress, Address _txSender, u256 _txValue, u256 _gasPrice, bytesConstRef _txData, u256 _gas, Address _originAddress);
 	bool go(uint64_t _steps = (uint64_t)-1);
@@ -60,6 +61,7 @@ public:
 
 private:
 	State& m_s;
+	VMKind m_vmKind;
 	ExtVM* m_ext = nullptr;	// TODO: make safe.
 	VM* m_vm = nullptr;
 	bytesConstRef m_out;
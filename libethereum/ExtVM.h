@@ -33,11 +33,19 @@ namespace eth
 class ExtVM: public ExtVMFace
 {
 public:
-	ExtVM(State& _s, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code):
-		ExtVMFace(_myAddress, _caller, _origin, _value, _gasPrice, _data, _code, _s.m_previousBlock, _s.m_currentBlock), m_s(_s), m_origCache(_s.m_cache)
+	ExtVM(State& _s, Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code, h256 _codeHash = h256(), VMKind _vmKind = VMKind::Interpreter):
+		ExtVMFace(_myAddress, _caller, _origin, _value, _gasPrice, _data, _code, _s.m_previousBlock, _s.m_currentBlock, _codeHash), vmKind(_vmKind), m_s(_s), m_checkpoint(_s.checkpoint())
 	{
 		m_s.ensureCached(_myAddress, true, true);
 	}
+	ExtVM(ExtVM const&) = delete;
+	ExtVM& operator=(ExtVM const&) = delete;
+
+	~ExtVM()
+	{
+		if (!m_reverted)
+			m_s.discardCheckpoint();
+	}
 
 	u256 store(u256 _n)
 	{
@@ -53,12 +61,12 @@ public:
 		// Increment associated nonce for sender.
 		m_s.noteSending(myAddress);
 
-		return m_s.create(myAddress, _endowment, gasPrice, _gas, _code, origin);
+		return m_s.create(myAddress, _endowment, gasPrice, _gas, _code, origin, vmKind);
 	}
 
 	bool call(Address _receiveAddress, u256 _txValue, bytesConstRef _txData, u256* _gas, bytesRef _out)
 	{
-		return m_s.call(_receiveAddress, myAddress, _txValue, gasPrice, _txData, _gas, _out, origin);
+		return m_s.call(_receiveAddress, myAddress, _txValue, gasPrice, _txData, _gas, _out, origin, vmKind);
 	}
 
 	u256 balance(Address _a) { return m_s.balance(_a); }
@@ -67,18 +75,22 @@ public:
 	void suicide(Address _a)
 	{
 		m_s.addBalance(_a, m_s.balance(myAddress));
-		m_s.m_cache[myAddress].kill();
+		m_s.kill(myAddress);
 	}
 
+	/// Undo everything done to the state since we were constructed.
 	void revert()
 	{
-		m_s.m_cache = m_origCache;
+		m_s.rollback(m_checkpoint);
+		m_reverted = true;
 	}
 
+	VMKind vmKind;				///< The engine for any calls and creations we make.
+
 private:
 	State& m_s;
-	std::map<Address, AddressState> m_origCache;
-	std::map<u256, u256>* m_store;
+	size_t m_checkpoint;		///< Where our changes start in the state's journal.
+	bool m_reverted = false;
 };
 
 }
@@ -35,6 +35,8 @@ namespace bi = boost::asio::ip;
 namespace eth
 {
 
+static const unsigned c_maxIncomingTransactions = 4096;	///< Transactions from peers held, at most, till they're queued.
+
 class PeerServer
 {
 	friend class PeerSession;
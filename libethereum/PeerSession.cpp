@@ -214,8 +214,12 @@ bool PeerSession::interpret(RLP const& _r)
 		m_rating += _r.itemCount() - 1;
 		for (unsigned i = 1; i < _r.itemCount(); ++i)
 		{
-			m_server->m_incomingTransactions.push_back(_r[i].data().toBytes());
-			m_knownTransactions.insert(sha3(_r[i].data()));
+			// One dropped for want of room may be taken when the peer sends it again, so it's not known till it's queued.
+			if (m_server->m_incomingTransactions.size() < c_maxIncomingTransactions)
+			{
+				m_server->m_incomingTransactions.push_back(_r[i].data().toBytes());
+				m_knownTransactions.insert(sha3(_r[i].data()));
+			}
 		}
 		break;
 	case BlocksPacket:
@@ -23,18 +23,27 @@
 
 #include <boost/filesystem.hpp>
 #include <time.h>
+#include <atomic>
+#include <mutex>
+#include <queue>
 #include <random>
+#include <thread>
 #include <secp256k1/secp256k1.h>
+#include <libethsupport/ThreadPool.h>
 #include <libethcore/Instruction.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/Dagger.h>
 #include <libevm/VM.h>
+#include <libevm/VMArena.h>
 #include "BlockChain.h"
 #include "Defaults.h"
 #include "ExtVM.h"
 using namespace std;
 using namespace eth;
 
+static mutex s_replayLock;
+static ReplayStats s_replay;
+
 #define ctrace clog(StateTrace)
 
 OverlayDB State::openDB(std::string _path, bool _killExisting)
@@ -68,7 +77,8 @@ State::State(Address _coinbaseAddress, OverlayDB const& _db):
 
 	paranoia("beginning of normal construction.", true);
 
-	eth::commit(genesisState(), m_db, m_state);
+	AddressStateMap genesis = genesisState();
+	eth::commit(genesis, m_db, m_state);
 	m_db.commit();
 
 	paranoia("after DB commit of normal construction.", true);
@@ -87,6 +97,10 @@ State::State(State const& _s):
 	m_transactions(_s.m_transactions),
 	m_transactionSet(_s.m_transactionSet),
 	m_cache(_s.m_cache),
+	m_absentRoot(_s.m_absentRoot),
+	m_absent(_s.m_absent),
+	m_prefetched(_s.m_prefetched),
+	m_speculationPool(_s.m_speculationPool),
 	m_previousBlock(_s.m_previousBlock),
 	m_currentBlock(_s.m_currentBlock),
 	m_ourAddress(_s.m_ourAddress),
@@ -118,8 +132,12 @@ State& State::operator=(State const& _s)
 	m_transactions = _s.m_transactions;
 	m_transactionSet = _s.m_transactionSet;
 	m_cache = _s.m_cache;
+	m_absentRoot = _s.m_absentRoot;
+	m_absent = _s.m_absent;
+	m_prefetched = _s.m_prefetched;
 	m_previousBlock = _s.m_previousBlock;
 	m_currentBlock = _s.m_currentBlock;
+	m_speculationPool = _s.m_speculationPool;
 	m_ourAddress = _s.m_ourAddress;
 	m_blockReward = _s.m_blockReward;
 	paranoia("after state cloning (assignment op)", true);
@@ -244,37 +262,276 @@ StateDiff State::diff(State const& _c) const
 
 void State::ensureCached(Address _a, bool _requireCode, bool _forceCreate) const
 {
+	if (m_reads)
+		m_reads->accounts.insert(_a);
 	ensureCached(m_cache, _a, _requireCode, _forceCreate);
 }
 
-void State::ensureCached(std::map<Address, AddressState>& _cache, Address _a, bool _requireCode, bool _forceCreate) const
+void State::ensureCached(AddressStateMap& _cache, Address _a, bool _requireCode, bool _forceCreate) const
 {
 	auto it = _cache.find(_a);
 	if (it == _cache.end())
 	{
+		if (!_forceCreate && m_absentRoot == m_state.root() && m_absent.count(_a))
+			return;
+
 		// populate basic info.
 		string stateBack = m_state.at(_a);
 		if (stateBack.empty() && !_forceCreate)
 			return;
-		RLP state(stateBack);
-		AddressState s;
-		if (state.isNull())
-			s = AddressState(0, 0, h256(), EmptySHA3);
-		else
-			s = AddressState(state[0].toInt<u256>(), state[1].toInt<u256>(), state[2].toHash<h256>(), state[3].toHash<h256>());
 		bool ok;
-		tie(it, ok) = _cache.insert(make_pair(_a, s));
+		tie(it, ok) = _cache.insert(make_pair(_a, accountFromTrie(RLP(stateBack))));
+		if (&_cache == &m_cache)
+			journal(JournalEntry::Cached, _a);
 	}
 	if (_requireCode && it != _cache.end() && !it->second.isFreshCode() && !it->second.codeCacheValid())
 		it->second.noteCode(it->second.codeHash() == EmptySHA3 ? bytesConstRef() : bytesConstRef(m_db.lookup(it->second.codeHash())));
 }
 
+AddressState State::accountFromTrie(RLP const& _rlp)
+{
+	if (_rlp.isNull())
+		return AddressState(0, 0, h256(), EmptySHA3);
+	AddressState ret(_rlp[0].toInt<u256>(), _rlp[1].toInt<u256>(), _rlp[2].toHash<h256>(), _rlp[3].toHash<h256>());
+	ret.noteCommitted(ret.oldRoot());
+	return ret;
+}
+
+static ThreadPool& prefetchPool()
+{
+	// Reading the DB is mostly waiting on the disk, so use more threads than cores.
+	static ThreadPool s_ret(max(thread::hardware_concurrency(), c_minPrefetchThreads) - 1);
+	return s_ret;
+}
+
+void State::prefetch(Addresses const& _addresses) const
+{
+	if (m_absentRoot != m_state.root())
+	{
+		m_absent.clear();
+		m_absentRoot = m_state.root();
+	}
+
+	Addresses todo;
+	set<Address> seen;
+	for (auto const& a: _addresses)
+		if (!m_cache.count(a) && !m_absent.count(a) && seen.insert(a).second)
+			todo.push_back(a);
+	if (todo.empty())
+		return;
+
+	// Walk each one's path through the trie, and read its code, several at once.
+	vector<string> found(todo.size());
+	vector<string> code(todo.size());
+	vector<byte> failed(todo.size(), 0);
+	prefetchPool().run(todo.size(), [&](size_t i)
+	{
+		// One whose nodes are missing or bad is left for ensureCached() to come across again, and complain about.
+		try
+		{
+			found[i] = m_state.at(todo[i]);
+			if (!found[i].empty())
+			{
+				h256 codeHash = RLP(found[i])[3].toHash<h256>();
+				if (codeHash != EmptySHA3)
+					code[i] = m_db.lookup(codeHash);
+			}
+		}
+		catch (...)
+		{
+			failed[i] = 1;
+		}
+	});
+
+	for (size_t i = 0; i < todo.size(); ++i)
+		if (failed[i])
+			continue;
+		else if (!found[i].empty())
+		{
+			auto it = m_cache.insert(make_pair(todo[i], accountFromTrie(RLP(found[i])))).first;
+			journal(JournalEntry::Cached, todo[i]);
+			if (it->second.codeHash() != EmptySHA3)
+				it->second.noteCode(&code[i]);
+		}
+		else
+			m_absent.insert(todo[i]);
+}
+
+void State::rollback(size_t _checkpoint)
+{
+	while (m_journal.size() > _checkpoint)
+	{
+		JournalEntry& e = m_journal.back();
+		switch (e.kind)
+		{
+		case JournalEntry::Cached:
+			m_cache.erase(e.address);
+			break;
+		case JournalEntry::Account:
+			m_cache[e.address] = *e.account;
+			break;
+		case JournalEntry::Balance:
+			m_cache[e.address].balance() = e.value;
+			break;
+		case JournalEntry::Nonce:
+			m_cache[e.address].nonce() = e.value;
+			break;
+		case JournalEntry::Storage:
+			if (e.existed)
+				m_cache[e.address].setStorage(e.key, e.value);
+			else
+				m_cache[e.address].dropStorage(e.key);
+			break;
+		}
+		m_journal.pop_back();
+	}
+	discardCheckpoint();
+}
+
+void State::setAccount(Address _a, AddressState const& _s)
+{
+	auto it = m_cache.find(_a);
+	if (it == m_cache.end())
+	{
+		m_cache.insert(make_pair(_a, _s));
+		journal(JournalEntry::Cached, _a);
+	}
+	else
+	{
+		if (m_checkpoints)
+			m_journal.push_back(JournalEntry{JournalEntry::Account, _a, 0, 0, true, make_shared<AddressState>(it->second)});
+		it->second = _s;
+	}
+}
+
+void State::kill(Address _a)
+{
+	AddressState s = m_cache.at(_a);
+	s.kill();
+	setAccount(_a, s);
+}
+
+void State::setCode(Address _a, bytesConstRef _code)
+{
+	AddressState s = m_cache.at(_a);
+	s.setCode(_code);
+	setAccount(_a, s);
+}
+
 void State::commit()
 {
 	eth::commit(m_cache, m_db, m_state);
 	m_cache.clear();
 }
 
+void State::commitDirty()
+{
+	eth::commit(m_cache, m_db, m_state);
+}
+
+vector<SpeculativeResult> State::speculate(Transactions const& _ts) const
+{
+	ThreadPool& pool = m_speculationPool ? *m_speculationPool : ThreadPool::shared();
+	size_t threads = min<size_t>(pool.size(), _ts.size());
+	if (threads < 2 || VMTracer::active() || VMProfiler::enabled())
+		return vector<SpeculativeResult>();
+
+	// Copying a State freezes its DB's changes, so make one copy here; each thread's copy of that one just shares.
+	State base(*this);
+	vector<SpeculativeResult> ret(_ts.size());
+	atomic<size_t> next(0);
+	pool.run(threads, [&](size_t)
+	{
+		State s(base);
+		for (size_t i; (i = next++) < _ts.size();)
+			s.speculate(_ts[i], ret[i]);
+	});
+	return ret;
+}
+
+void State::speculate(Transaction const& _t, SpeculativeResult& o_r)
+{
+	m_cache.clear();
+	m_journal.clear();
+	m_checkpoints = 0;
+
+	m_reads = &o_r.reads;
+	try
+	{
+		Executive e(*this);
+		e.setup(_t);
+		e.go();
+		e.finalize();
+		o_r.gasUsed = e.gasUsed();
+		o_r.ok = true;
+	}
+	catch (...) {}
+	m_reads = nullptr;
+	if (!o_r.ok)
+		return;
+
+	for (auto const& i: m_cache)
+	{
+		string base = m_state.at(i.first);
+		if (o_r.reads.accounts.count(i.first))
+		{
+			if (i.second.isDirty())
+			{
+				bool replaced = base.empty() || !i.second.isAlive() || i.second.isFreshCode() || i.second.oldRoot() != RLP(base)[2].toHash<h256>();
+				o_r.changed.push_back(SpeculativeResult::Change{i.first, i.second, replaced});
+			}
+		}
+		else
+			o_r.credits.push_back(make_pair(i.first, i.second.balance() - (base.empty() ? 0 : RLP(base)[1].toInt<u256>())));
+	}
+}
+
+u256 State::executeSpeculated(Transaction const& _t, SpeculativeResult const& _r, AccessSet& _written)
+{
+	u256 startGasUsed = gasUsed();
+	bool stale = !_r.ok || startGasUsed + _t.gas > m_currentBlock.gasLimit;
+	for (auto it = _r.reads.accounts.begin(); !stale && it != _r.reads.accounts.end(); ++it)
+		stale = _written.accounts.count(*it);
+	for (auto it = _r.reads.storage.begin(); !stale && it != _r.reads.storage.end(); ++it)
+		stale = _written.storage.count(*it);
+	if (stale)
+		return execute(_t, &_written);
+
+	// Nothing it looked at has changed, so it would do just the same now. Accounts it only paid into may have changed
+	// since, as may storage it didn't look at; so pay in again, and merge in just the locations it wrote.
+	for (auto const& i: _r.changed)
+		if (i.replaced)
+			setAccount(i.address, i.state);
+		else
+		{
+			ensureCached(i.address, false, false);
+			m_cache.at(i.address).mergeChanges(i.state);
+		}
+	for (auto const& i: _r.credits)
+		addBalance(i.first, i.second);
+
+	noteWrites(_written);
+	commitDirty();
+
+	m_transactions.push_back(TransactionReceipt(_t, rootHash(), startGasUsed + _r.gasUsed));
+	m_transactionSet.insert(_t.sha3());
+	return _r.gasUsed;
+}
+
+void State::noteWrites(AccessSet& o_written) const
+{
+	for (auto const& i: m_cache)
+		if (i.second.isDirty())
+		{
+			string base = m_state.at(i.first);
+			RLP r(base);
+			if (base.empty() || !i.second.isAlive() || i.second.isFreshCode() || i.second.nonce() != r[0].toInt<u256>() || i.second.balance() != r[1].toInt<u256>() || i.second.oldRoot() != r[2].toHash<h256>())
+				o_written.accounts.insert(i.first);
+			for (auto const& j: i.second.dirtyStorage())
+				o_written.storage.insert(make_pair(i.first, j));
+		}
+}
+
 bool State::sync(BlockChain const& _bc)
 {
 	return sync(_bc, _bc.currentHash());
@@ -315,7 +572,7 @@ bool State::sync(BlockChain const& _bc, h256 _block)
 	{
 		// New blocks available, or we've switched to a different branch. All change.
 		// Find most recent state dump and replay what's left.
-		// (Most recent state dump might end up being genesis.)
+		// (Checkpoints' states are never pruned, so it's no further back than the last one of those.)
 
 		std::vector<h256> chain;
 		while (bi.stateRoot != BlockChain::genesis().hash && m_db.lookup(bi.stateRoot).empty())	// while we don't have the state root of the latest block...
@@ -331,12 +588,28 @@ bool State::sync(BlockChain const& _bc, h256 _block)
 		for (auto it = chain.rbegin(); it != chain.rend(); ++it)
 			trustedPlayback(_bc.block(*it), true);
 
+		if (chain.size())
+		{
+			lock_guard<mutex> l(s_replayLock);
+			s_replay.syncs++;
+			s_replay.blocks += chain.size();
+			s_replay.most = max<unsigned>(s_replay.most, chain.size());
+			s_replay.last = chain.size();
+			clog(StateChat) << "Played back" << chain.size() << "blocks to sync.";
+		}
+
 		resetCurrent();
 		ret = true;
 	}
 	return ret;
 }
 
+ReplayStats State::replayStats()
+{
+	lock_guard<mutex> l(s_replayLock);
+	return s_replay;
+}
+
 map<Address, u256> State::addresses() const
 {
 	map<Address, u256> ret;
@@ -374,26 +647,18 @@ void State::resetCurrent()
 bool State::cull(TransactionQueue& _tq) const
 {
 	bool ret = false;
-	auto ts = _tq.transactions();
-	for (auto const& i: ts)
+	h256s stale;
+	for (auto const& s: _tq.bySender())
 	{
-		if (!m_transactionSet.count(i.first))
-		{
-			try
-			{
-				Transaction t(i.second);
-				if (t.nonce <= transactionsFrom(t.sender()))
-				{
-					_tq.drop(i.first);
-					ret = true;
-				}
-			}
-			catch (...)
-			{
-				_tq.drop(i.first);
-				ret = true;
-			}
-		}
+		u256 n = transactionsFrom(s.first);
+		for (auto it = s.second.begin(); it != s.second.end() && it->first < n; ++it)
+			if (!m_transactionSet.count(it->second))
+				stale.push_back(it->second);
+	}
+	for (auto const& h: stale)
+	{
+		_tq.drop(h);
+		ret = true;
 	}
 	return ret;
 }
@@ -401,51 +666,77 @@ bool State::cull(TransactionQueue& _tq) const
 bool State::sync(TransactionQueue& _tq, bool* _changed)
 {
 	// TRANSACTIONS
-	bool ret = false;
-	auto ts = _tq.transactions();
-	vector<pair<h256, bytes>> futures;
+	// Read in the senders' accounts; we need their nonces. Unless the queue or our state has changed since we last did,
+	// they're already here (or known not to exist).
+	if (m_prefetched != make_pair(_tq.changes(), rootHash()))
+	{
+		Addresses senders;
+		for (auto const& i: _tq.bySender())
+			senders.push_back(i.first);
+		prefetch(senders);
+	}
 
-	for (int goodTxs = 1; goodTxs;)
+	// Drop those superseded by the transactions on the chain.
+	if (cull(_tq) && _changed)
+		*_changed = true;
+
+	// A sender's transactions can only go in nonce order, from its next one. Take the first of each sender's, best gas
+	// price first; as each is executed, its sender's next (if any) takes its place.
+	priority_queue<pair<u256, h256>> ready;
+	Addresses touched;
+	for (auto const& i: _tq.bySender())
 	{
-		goodTxs = 0;
-		for (auto const& i: ts)
+		u256 n = transactionsFrom(i.first);
+		auto it = i.second.find(n);
+		if (it != i.second.end())
+			ready.push(make_pair(_tq.transaction(it->second)->gasPrice, it->second));
+		for (; it != i.second.end() && it->first == n; ++it, ++n)
 		{
-			if (!m_transactionSet.count(i.first))
-			{
-				// don't have it yet! Execute it now.
-				try
-				{
-					ret = true;
-					uncommitToMine();
-					execute(i.second);
-					if (_changed)
-						*_changed = true;
-					_tq.noteGood(i);
-					++goodTxs;
-				}
-				catch (InvalidNonce const& in)
-				{
-					if (in.required > in.candidate)
-					{
-						// too old
-						_tq.drop(i.first);
-						if (_changed)
-							*_changed = true;
-					}
-					else
-						_tq.setFuture(i);
-				}
-				catch (std::exception const&)
-				{
-					// Something else went wrong - drop it.
-					_tq.drop(i.first);
-					if (_changed)
-						*_changed = true;
-				}
-			}
+			touched.push_back(i.first);
+			if (Address to = _tq.transaction(it->second)->receiveAddress)
+				touched.push_back(to);
 		}
 	}
-	return ret;
+	if (ready.empty())
+	{
+		m_prefetched = make_pair(_tq.changes(), rootHash());
+		return false;
+	}
+
+	uncommitToMine();
+	prefetch(touched);
+
+	while (!ready.empty())
+	{
+		h256 h = ready.top().second;
+		ready.pop();
+		Transaction const& t = *_tq.transaction(h);
+		Address from = t.sender();
+		u256 nonce = t.nonce;
+		try
+		{
+			execute(t);
+			if (_changed)
+				*_changed = true;
+			auto const& next = _tq.bySender().at(from);
+			auto it = next.find(nonce + 1);
+			if (it != next.end())
+				ready.push(make_pair(_tq.transaction(it->second)->gasPrice, it->second));
+		}
+		catch (InvalidNonce const&)
+		{
+			// Leave it be; it may yet go in.
+		}
+		catch (std::exception const&)
+		{
+			// Something else went wrong - drop it.
+			_tq.drop(h);
+			if (_changed)
+				*_changed = true;
+		}
+	}
+	m_prefetched = make_pair(_tq.changes(), rootHash());
+	return true;
 }
 
 u256 State::playback(bytesConstRef _block, BlockInfo const& _bi, BlockInfo const& _parent, BlockInfo const& _grandParent, bool _fullCommit)
@@ -486,13 +777,51 @@ u256 State::playbackRaw(bytesConstRef _block, BlockInfo const& _grandParent, boo
 	GenericTrieDB<MemoryDB> transactionManifest(&tm);
 	transactionManifest.init();
 
+	// Decode the transactions and recover their senders up front, on every core; signatures don't depend on the state.
+	// Should one not decode, stop there and leave it to fail in turn below.
+	Transactions txs;
+	try
+	{
+		for (auto const& tr: RLP(_block)[1])
+			txs.push_back(Transaction(tr[0].data()));
+	}
+	catch (Exception const&) {}
+	recoverSenders(txs);
+
+	// Read in the accounts they're known to touch, along with those rewarded, rather than one at a time as they come up.
+	Addresses touched = { m_currentBlock.coinbaseAddress };
+	for (auto const& t: txs)
+	{
+		touched.push_back(t.safeSender());
+		if (t.receiveAddress)
+			touched.push_back(t.receiveAddress);
+	}
+	try
+	{
+		for (auto const& i: RLP(_block)[2])
+			touched.push_back(BlockInfo::fromHeader(i.data()).coinbaseAddress);
+	}
+	catch (Exception const&) {}
+	prefetch(touched);
+
+	// Run them all at once too, each alone against the state as it is now. Playing them back in turn then just takes
+	// each one's outcome, unless a transaction before it changed something it looked at.
+	commitDirty();
+	vector<SpeculativeResult> speculated = speculate(txs);
+	AccessSet written;
+
 	// All ok with the block generally. Play back the transactions now...
 	unsigned i = 0;
 	for (auto const& tr: RLP(_block)[1])
 	{
 //		cnote << m_state.root() << m_state;
 //		cnote << *this;
-		execute(tr[0].data());
+		if (i < speculated.size())
+			executeSpeculated(txs[i], speculated[i], written);
+		else if (i < txs.size())
+			execute(txs[i]);
+		else
+			execute(tr[0].data());
 		if (tr[1].toHash<h256>() != m_state.root())
 		{
 			// Invalid state root
@@ -763,19 +1092,26 @@ void State::noteSending(Address _id)
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 	if (it == m_cache.end())
-		m_cache[_id] = AddressState(1, 0, h256(), EmptySHA3);
+		setAccount(_id, AddressState(1, 0, h256(), EmptySHA3));
 	else
+	{
+		journal(JournalEntry::Nonce, _id, 0, it->second.nonce());
 		it->second.incNonce();
+	}
 }
 
 void State::addBalance(Address _id, u256 _amount)
 {
-	ensureCached(_id, false, false);
+	// Paying in doesn't depend on what's there, so doesn't count as looking at the account.
+	ensureCached(m_cache, _id, false, false);
 	auto it = m_cache.find(_id);
 	if (it == m_cache.end())
-		m_cache[_id] = AddressState(0, _amount, h256(), EmptySHA3);
+		setAccount(_id, AddressState(0, _amount, h256(), EmptySHA3));
 	else
+	{
+		journal(JournalEntry::Balance, _id, 0, it->second.balance());
 		it->second.addBalance(_amount);
+	}
 }
 
 void State::subBalance(Address _id, bigint _amount)
@@ -785,7 +1121,10 @@ void State::subBalance(Address _id, bigint _amount)
 	if (it == m_cache.end() || (bigint)it->second.balance() < _amount)
 		throw NotEnoughCash();
 	else
+	{
+		journal(JournalEntry::Balance, _id, 0, it->second.balance());
 		it->second.addBalance(-_amount);
+	}
 }
 
 u256 State::transactionsFrom(Address _id) const
@@ -800,6 +1139,8 @@ u256 State::transactionsFrom(Address _id) const
 
 u256 State::storage(Address _id, u256 _memory) const
 {
+	if (m_reads)
+		m_reads->storage.insert(make_pair(_id, _memory));
 	ensureCached(_id, false, false);
 	auto it = m_cache.find(_id);
 
@@ -816,10 +1157,34 @@ u256 State::storage(Address _id, u256 _memory) const
 	TrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), it->second.oldRoot());			// promise we won't change the overlay! :)
 	string payload = memdb.at(_memory);
 	u256 ret = payload.size() ? RLP(payload).toInt<u256>() : 0;
-	it->second.setStorage(_memory, ret);
+	it->second.noteStorage(_memory, ret);
 	return ret;
 }
 
+void State::setStorage(Address _contract, u256 _location, u256 _value)
+{
+	if (m_reads)
+	{
+		m_reads->accounts.insert(_contract);
+		m_reads->storage.insert(make_pair(_contract, _location));
+	}
+	auto it = m_cache.find(_contract);
+	if (it == m_cache.end())
+	{
+		it = m_cache.insert(make_pair(_contract, AddressState())).first;
+		journal(JournalEntry::Cached, _contract);
+	}
+	else if (m_checkpoints)
+	{
+		auto sit = it->second.storage().find(_location);
+		if (sit == it->second.storage().end())
+			journal(JournalEntry::Storage, _contract, _location);
+		else
+			journal(JournalEntry::Storage, _contract, _location, sit->second, true);
+	}
+	it->second.setStorage(_location, _value);
+}
+
 map<u256, u256> State::storage(Address _id) const
 {
 	map<u256, u256> ret;
@@ -846,6 +1211,35 @@ map<u256, u256> State::storage(Address _id) const
 	return ret;
 }
 
+map<u256, u256> State::storage(Address _id, u256 _from, u256 _to) const
+{
+	map<u256, u256> ret;
+
+	ensureCached(_id, false, false);
+	auto it = m_cache.find(_id);
+	if (it != m_cache.end() && _from < _to)
+	{
+		// Pull out the values in range from trie storage; keys are big-endian, so ordered as the positions are.
+		if (it->second.oldRoot())
+		{
+			TrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), it->second.oldRoot());		// promise we won't alter the overlay! :)
+			for (auto const& i: memdb.range(h256(_from), h256(_to)))
+				ret[i.first] = RLP(i.second).toInt<u256>();
+		}
+
+		// Then merge cached storage in range over the top.
+		for (auto const& i: it->second.storage())
+			if (i.first >= _from && i.first < _to)
+			{
+				if (i.second)
+					ret[i.first] = i.second;
+				else
+					ret.erase(i.first);
+			}
+	}
+	return ret;
+}
+
 h256 State::storageRoot(Address _id) const
 {
 	string s = m_state.at(_id);
@@ -857,6 +1251,16 @@ h256 State::storageRoot(Address _id) const
 	return h256();
 }
 
+TrieProof State::storageProof(Address _id, u256 _location) const
+{
+	// No account, no storage; its absence is shown by accountProof().
+	h256 root = storageRoot(_id);
+	if (!root)
+		return TrieProof();
+	TrieDB<h256, OverlayDB> memdb(const_cast<OverlayDB*>(&m_db), root);		// promise we won't alter the overlay! :)
+	return memdb.prove(_location);
+}
+
 bytes const& State::code(Address _contract) const
 {
 	if (!addressHasCode(_contract))
@@ -865,6 +1269,15 @@ bytes const& State::code(Address _contract) const
 	return m_cache[_contract].code();
 }
 
+h256 State::codeHash(Address _contract) const
+{
+	ensureCached(_contract, false, false);
+	auto it = m_cache.find(_contract);
+	if (it == m_cache.end())
+		return EmptySHA3;
+	return it->second.isFreshCode() ? h256() : it->second.codeHash();
+}
+
 bool State::isTrieGood(bool _enforceRefs, bool _requireNoLeftOvers) const
 {
 	for (int e = 0; e < (_enforceRefs ? 2 : 1); ++e)
@@ -905,20 +1318,25 @@ bool State::isTrieGood(bool _enforceRefs, bool _requireNoLeftOvers) const
 // TODO: TransactionReceipt trie should be MemoryDB and built as necessary
 
 u256 State::execute(bytesConstRef _rlp)
+{
+	return execute(Transaction(_rlp));
+}
+
+u256 State::execute(Transaction const& _t, AccessSet* o_written)
 {
 #ifndef RELEASE
-	commit();	// get an updated hash
+	commitDirty();	// get an updated hash
 #endif
 
 	paranoia("start of execution.", true);
 
-	State old(*this);
 #if ETH_PARANOIA
+	State old(*this);
 	auto h = rootHash();
 #endif
 
 	Executive e(*this);
-	e.setup(_rlp);
+	e.setup(_t);
 
 	u256 startGasUsed = gasUsed();
 
@@ -935,7 +1353,10 @@ u256 State::execute(bytesConstRef _rlp)
 	ctrace << old.diff(*this);
 #endif
 
-	commit();
+	// Just rehash what the transaction touched; the cache stays warm for the next one.
+	if (o_written)
+		noteWrites(*o_written);
+	commitDirty();
 
 #if ETH_PARANOIA
 	ctrace << "Executed; now" << rootHash();
@@ -962,7 +1383,7 @@ u256 State::execute(bytesConstRef _rlp)
 	return e.gasUsed();
 }
 
-bool State::call(Address _receiveAddress, Address _senderAddress, u256 _value, u256 _gasPrice, bytesConstRef _data, u256* _gas, bytesRef _out, Address _originAddress)
+bool State::call(Address _receiveAddress, Address _senderAddress, u256 _value, u256 _gasPrice, bytesConstRef _data, u256* _gas, bytesRef _out, Address _originAddress, VMKind _kind)
 {
 	if (!_originAddress)
 		_originAddress = _senderAddress;
@@ -972,13 +1393,13 @@ bool State::call(Address _receiveAddress, Address _senderAddress, u256 _value, u
 
 	if (addressHasCode(_receiveAddress))
 	{
-		VM vm(*_gas);
-		ExtVM evm(*this, _receiveAddress, _senderAddress, _originAddress, _value, _gasPrice, _data, &code(_receiveAddress));
+		VMFrame vm(*_gas, _kind);
+		ExtVM evm(*this, _receiveAddress, _senderAddress, _originAddress, _value, _gasPrice, _data, &code(_receiveAddress), codeHash(_receiveAddress), _kind);
 		bool revert = false;
 
 		try
 		{
-			auto out = vm.go(evm);
+			auto out = vm->go(evm);
 			memcpy(_out.data(), out.data(), std::min(out.size(), _out.size()));
 		}
 		catch (OutOfGas const& /*_e*/)
@@ -1003,14 +1424,14 @@ bool State::call(Address _receiveAddress, Address _senderAddress, u256 _value, u
 		if (revert)
 			evm.revert();
 
-		*_gas = vm.gas();
+		*_gas = vm->gas();
 
 		return !revert;
 	}
 	return true;
 }
 
-h160 State::create(Address _sender, u256 _endowment, u256 _gasPrice, u256* _gas, bytesConstRef _code, Address _origin)
+h160 State::create(Address _sender, u256 _endowment, u256 _gasPrice, u256* _gas, bytesConstRef _code, Address _origin, VMKind _kind)
 {
 	if (!_origin)
 		_origin = _sender;
@@ -1020,17 +1441,17 @@ h160 State::create(Address _sender, u256 _endowment, u256 _gasPrice, u256* _gas,
 		newAddress = (u160)newAddress + 1;
 
 	// Set up new account...
-	m_cache[newAddress] = AddressState(0, 0, h256(), h256());
+	setAccount(newAddress, AddressState(0, 0, h256(), h256()));
 
 	// Execute _init.
-	VM vm(*_gas);
-	ExtVM evm(*this, newAddress, _sender, _origin, _endowment, _gasPrice, bytesConstRef(), _code);
+	VMFrame vm(*_gas, _kind);
+	ExtVM evm(*this, newAddress, _sender, _origin, _endowment, _gasPrice, bytesConstRef(), _code, h256(), _kind);
 	bool revert = false;
 	bytesConstRef out;
 
 	try
 	{
-		out = vm.go(evm);
+		out = vm->go(evm);
 	}
 	catch (OutOfGas const& /*_e*/)
 	{
@@ -1056,9 +1477,9 @@ h160 State::create(Address _sender, u256 _endowment, u256 _gasPrice, u256* _gas,
 
 	// Set code as long as we didn't suicide.
 	if (addressInUse(newAddress))
-		m_cache[newAddress].setCode(out);
+		setCode(newAddress, out);
 
-	*_gas = vm.gas();
+	*_gas = vm->gas();
 
 	return newAddress;
 }
@@ -23,9 +23,12 @@
 
 #include <array>
 #include <map>
+#include <memory>
+#include <set>
 #include <unordered_map>
 #include <libethsupport/Common.h>
 #include <libethsupport/RLP.h>
+#include <libethsupport/ThreadPool.h>
 #include <libethsupport/TrieDB.h>
 #include <libethcore/Exceptions.h>
 #include <libethcore/BlockInfo.h>
@@ -45,6 +48,8 @@ class BlockChain;
 struct StateChat: public LogChannel { static const char* name() { return "=S="; } static const int verbosity = 4; };
 struct StateTrace: public LogChannel { static const char* name() { return "=S="; } static const int verbosity = 7; };
 
+static const unsigned c_minPrefetchThreads = 8;		///< The fewest threads State::prefetch() reads the DB on, however few cores.
+
 struct TransactionReceipt
 {
 	TransactionReceipt(Transaction const& _t, h256 _root, u256 _gasUsed): transaction(_t), stateRoot(_root), gasUsed(_gasUsed) {}
@@ -99,6 +104,67 @@ struct StateDiff
 	std::map<Address, AccountDiff> accounts;
 };
 
+/**
+ * @brief A single undoable change to State's address cache, as kept in its journal.
+ */
+struct JournalEntry
+{
+	enum Kind
+	{
+		Cached,		///< The account was put in the cache; undone by dropping it again.
+		Account,	///< The account was replaced wholesale; @a account holds what it was.
+		Balance,	///< @a value holds the old balance.
+		Nonce,		///< @a value holds the old nonce.
+		Storage		///< @a key is the location, @a value its old overlay value if @a existed.
+	};
+
+	Kind kind;
+	Address address;
+	u256 key;
+	u256 value;
+	bool existed;
+	std::shared_ptr<AddressState> account;
+};
+
+/**
+ * @brief The accounts and storage locations some transactions looked at, or changed.
+ */
+struct AccessSet
+{
+	std::set<Address> accounts;
+	std::set<std::pair<Address, u256>> storage;
+};
+
+/**
+ * @brief The outcome of running a transaction speculatively, alone against the state at the start of its block.
+ */
+struct SpeculativeResult
+{
+	struct Change
+	{
+		Address address;
+		AddressState state;			///< The account as the transaction left it.
+		bool replaced;				///< True if it was created, killed or had its storage reset, rather than just changed.
+	};
+
+	bool ok = false;				///< False if the transaction threw; it's then left to be executed in turn.
+	AccessSet reads;				///< What it looked at; should anything there be changed first, the outcome is stale.
+	std::vector<Change> changed;	///< The accounts it looked at and changed.
+	std::vector<std::pair<Address, u256>> credits;	///< The accounts it only paid into, and how much (e.g. the coinbase).
+	u256 gasUsed;
+};
+
+/**
+ * @brief How many blocks State::sync() has had to play back to catch up with the chain, over every State.
+ */
+struct ReplayStats
+{
+	unsigned syncs = 0;			///< Syncs that played back any blocks: new ones, or those of another branch.
+	uint64_t blocks = 0;		///< The blocks they played back.
+	unsigned most = 0;			///< The most that any one of them played back.
+	unsigned last = 0;			///< The number the latest of them played back.
+};
+
 /**
  * @brief Model of the current state of the ledger.
  * Maintains current ledger (m_current) as a fast hash-map. This is hashed only when required (i.e. to create or verify a block).
@@ -174,6 +240,13 @@ public:
 	/// This will append @a _t to the transaction list and change the state accordingly.
 	u256 execute(bytes const& _rlp) { return execute(&_rlp); }
 	u256 execute(bytesConstRef _rlp);
+	u256 execute(Transaction const& _t) { return execute(_t, nullptr); }
+
+	/// Read the accounts at @a _addresses, and their code, into the cache, several at once. Call it before executing
+	/// transactions whose accounts are known up front (their senders and recipients, say), so that executing them in
+	/// turn doesn't wait on the DB for each one. Those found not to exist are remembered, so aren't looked for again
+	/// until the state root changes.
+	void prefetch(Addresses const& _addresses) const;
 
 	/// Check if the address is in use.
 	bool addressInUse(Address _address) const;
@@ -198,22 +271,39 @@ public:
 	/// Get the root of the storage of an account.
 	h256 storageRoot(Address _contract) const;
 
+	/// @returns the proof of account @a _id's entry in the state trie, as of rootHash(); changes not yet committed
+	/// aren't in it. Check it with TrieDB<Address, OverlayDB>::verify().
+	TrieProof accountProof(Address _id) const { return m_state.prove(_id); }
+
+	/// @returns the proof of what's at @a _location in account @a _id's storage trie, whose root is storageRoot(),
+	/// as of rootHash(), or nothing if there's no such account. Check it with TrieDB<h256, OverlayDB>::verify(), against
+	/// that root, with the value as RLP.
+	TrieProof storageProof(Address _id, u256 _location) const;
+
 	/// Get the value of a storage position of an account.
 	/// @returns 0 if no account exists at that address.
 	u256 storage(Address _contract, u256 _memory) const;
 
 	/// Set the value of a storage position of an account.
-	void setStorage(Address _contract, u256 _location, u256 _value) { m_cache[_contract].setStorage(_location, _value); }
+	void setStorage(Address _contract, u256 _location, u256 _value);
 
 	/// Get the storage of an account.
 	/// @note This is expensive. Don't use it unless you need to.
 	/// @returns std::map<u256, u256> if no account exists at that address.
 	std::map<u256, u256> storage(Address _contract) const;
 
+	/// Get the storage of an account at positions no less than @a _from but less than @a _to.
+	/// Only the part of the storage trie between them is walked.
+	std::map<u256, u256> storage(Address _contract, u256 _from, u256 _to) const;
+
 	/// Get the code of an account.
 	/// @returns bytes() if no account exists at that address.
 	bytes const& code(Address _contract) const;
 
+	/// Get the hash of the code of an account.
+	/// @returns EmptySHA3 if no account exists at that address, or null if the code has not yet been committed.
+	h256 codeHash(Address _contract) const;
+
 	/// Note that the given address is sending a transaction and thus increment the associated ticker.
 	void noteSending(Address _id);
 
@@ -250,6 +340,13 @@ public:
 	/// @return the difference between this state (origin) and @a _c (destination).
 	StateDiff diff(State const& _c) const;
 
+	/// @returns how much playing back sync() has done, over every State.
+	static ReplayStats replayStats();
+
+	/// Run the transactions of blocks played back speculatively over @a _pool, rather than the shared pool. Given a
+	/// pool of just the one thread, they're played back strictly in turn.
+	void setSpeculationPool(ThreadPool& _pool) { m_speculationPool = &_pool; }
+
 private:
 	/// Undo the changes to the state for committing to mine.
 	void uncommitToMine();
@@ -261,11 +358,60 @@ private:
 	void ensureCached(Address _a, bool _requireCode, bool _forceCreate) const;
 
 	/// Retrieve all information about a given address into a cache.
-	void ensureCached(std::map<Address, AddressState>& _cache, Address _a, bool _requireCode, bool _forceCreate) const;
+	void ensureCached(AddressStateMap& _cache, Address _a, bool _requireCode, bool _forceCreate) const;
 
-	/// Commit all changes waiting in the address cache to the DB.
+	/// @returns the account whose RLP in the state trie is @a _rlp, clean; @a _rlp may be null.
+	static AddressState accountFromTrie(RLP const& _rlp);
+
+	/// Commit all changes waiting in the address cache to the DB, emptying it.
 	void commit();
 
+	/// Commit the changes made to the address cache since it was last committed, keeping it, so rootHash() is up to date.
+	/// Only the accounts and storage locations written since then are rehashed.
+	void commitDirty();
+
+	/// Execute @a _t, noting what it changed in @a o_written if it's non-null.
+	u256 execute(Transaction const& _t, AccessSet* o_written);
+
+	/// Run each of @a _ts on its own against the committed state, all at once on every core, each on a copy of us.
+	/// @returns their outcomes, or nothing if it's not worth it (too few transactions or cores, or the VM is being traced
+	/// or profiled).
+	std::vector<SpeculativeResult> speculate(Transactions const& _ts) const;
+
+	/// Run @a _t alone against the committed state, for speculate(), putting the outcome in @a o_r.
+	void speculate(Transaction const& _t, SpeculativeResult& o_r);
+
+	/// Execute the next transaction @a _t, given the outcome @a _r of running it speculatively. That's taken as it is
+	/// unless @a _written, what the transactions executed so far in the block changed, makes it stale; then @a _t is
+	/// executed again. Either way, what it changed is added to @a _written.
+	u256 executeSpeculated(Transaction const& _t, SpeculativeResult const& _r, AccessSet& _written);
+
+	/// Note in @a o_written the accounts and storage locations that the changes waiting in the cache would write.
+	void noteWrites(AccessSet& o_written) const;
+
+	/// Start journalling changes to the address cache, so they can be undone with rollback().
+	/// Checkpoints nest; each must be ended with exactly one of rollback() or discardCheckpoint().
+	/// @returns the checkpoint.
+	size_t checkpoint() { ++m_checkpoints; return m_journal.size(); }
+
+	/// Undo every change to the address cache since @a _checkpoint was taken, and end it.
+	void rollback(size_t _checkpoint);
+
+	/// End the most recent checkpoint, keeping its changes (they still get undone if an outer checkpoint is rolled back).
+	void discardCheckpoint() { if (!--m_checkpoints) m_journal.clear(); }
+
+	/// Journal a change of kind @a _kind to the account at @a _a, should there be a checkpoint to roll back to.
+	void journal(JournalEntry::Kind _kind, Address _a, u256 _key = 0, u256 _value = 0, bool _existed = false) const { if (m_checkpoints) m_journal.push_back(JournalEntry{_kind, _a, _key, _value, _existed, nullptr}); }
+
+	/// Replace the cached account at @a _a (which may not yet be cached) with @a _s.
+	void setAccount(Address _a, AddressState const& _s);
+
+	/// Kill the account at @a _a, which must be cached.
+	void kill(Address _a);
+
+	/// Set the code of the fresh account at @a _a, which must be cached.
+	void setCode(Address _a, bytesConstRef _code);
+
 	/// Execute the given block on our previous block. This will set up m_currentBlock first, then call the other playback().
 	/// Any failure will be critical.
 	u256 trustedPlayback(bytesConstRef _block, bool _fullCommit);
@@ -278,12 +424,12 @@ private:
 	// We assume all instrinsic fees are paid up before this point.
 
 	/// Execute a contract-creation transaction.
-	h160 create(Address _txSender, u256 _endowment, u256 _gasPrice, u256* _gas, bytesConstRef _code, Address _originAddress = Address());
+	h160 create(Address _txSender, u256 _endowment, u256 _gasPrice, u256* _gas, bytesConstRef _code, Address _originAddress = Address(), VMKind _kind = VMKind::Interpreter);
 
 	/// Execute a call.
 	/// @a _gas points to the amount of gas to use for the call, and will lower it accordingly.
 	/// @returns false if the call ran out of gas before completion. true otherwise.
-	bool call(Address _myAddress, Address _txSender, u256 _txValue, u256 _gasPrice, bytesConstRef _txData, u256* _gas, bytesRef _out, Address _originAddress = Address());
+	bool call(Address _myAddress, Address _txSender, u256 _txValue, u256 _gasPrice, bytesConstRef _txData, u256* _gas, bytesRef _out, Address _originAddress = Address(), VMKind _kind = VMKind::Interpreter);
 
 	/// Sets m_currentBlock to a clean state, (i.e. no change from m_previousBlock).
 	void resetCurrent();
@@ -306,7 +452,14 @@ private:
 //	GenericTrieDB<OverlayDB> m_transactionManifest;	///< The transactions trie; saved from the last commitToMine, or invalid/empty if commitToMine was never called.
 	OverlayDB m_lastTx;
 
-	mutable std::map<Address, AddressState> m_cache;	///< Our address cache. This stores the states of each address that has (or at least might have) been changed.
+	mutable AddressStateMap m_cache;			///< Our address cache. This stores the states of each address that has (or at least might have) been changed.
+	mutable h256 m_absentRoot;					///< The state root m_absent was found at.
+	mutable std::set<Address> m_absent;			///< Addresses prefetch() found no account at, in the trie at m_absentRoot.
+	std::pair<unsigned, h256> m_prefetched;		///< The transaction queue's changes() and our root when sync() last read in its senders.
+	mutable std::vector<JournalEntry> m_journal;	///< Changes to m_cache since the outermost checkpoint.
+	unsigned m_checkpoints = 0;					///< Number of checkpoints in force; we only journal when there's at least one.
+	AccessSet* m_reads = nullptr;				///< Where to note what's looked at, while running speculatively.
+	ThreadPool* m_speculationPool = nullptr;	///< What speculate() runs over; null for ThreadPool::shared().
 
 	BlockInfo m_previousBlock;					///< The previous block's information.
 	BlockInfo m_currentBlock;					///< The current block's information.
@@ -330,43 +483,104 @@ std::ostream& operator<<(std::ostream& _out, State const& _s);
 std::ostream& operator<<(std::ostream& _out, StateDiff const& _s);
 std::ostream& operator<<(std::ostream& _out, AccountDiff const& _s);
 
+/// Write the dirty accounts of @a _cache into @a _state, and their new storage and code into @a _db, marking them clean.
+/// Only the accounts, and storage locations, written since they were last committed are rehashed. Dead accounts are
+/// dropped from @a _cache, so what's left always agrees with @a _state.
 template <class DB>
-void commit(std::map<Address, AddressState> const& _cache, DB& _db, TrieDB<Address, DB>& _state)
+void commit(AddressStateMap& _cache, DB& _db, TrieDB<Address, DB>& _state)
 {
+	// The cache is unordered; write it out in address (and location) order so the DB sees the same thing every time.
+	std::vector<Address> dirty;
 	for (auto const& i: _cache)
-		if (!i.second.isAlive())
-			_state.remove(i.first);
-		else
-		{
-			RLPStream s(4);
-			s << i.second.nonce() << i.second.balance();
+		if (i.second.isDirty())
+			dirty.push_back(i.first);
+	std::sort(dirty.begin(), dirty.end());
 
-			if (i.second.storage().empty())
-				s.append(i.second.oldRoot(), false, true);
-			else
+	// Each trie is written in one batch, so a node is rehashed once however many of the changes are beneath it.
+	struct StorageBatch
+	{
+		std::vector<std::pair<h256, bytes>> changes;
+		h256 root;			///< The storage root before the changes, then after.
+	};
+	std::map<Address, StorageBatch> storage;
+	size_t slots = 0;
+	for (auto const& a: dirty)
+	{
+		AddressState const& s = _cache.at(a);
+		if (s.isAlive() && !s.dirtyStorage().empty())
+		{
+			StorageBatch& b = storage[a];
+			b.root = s.oldRoot();
+			b.changes.reserve(s.dirtyStorage().size());
+			for (auto const& j: s.dirtyStorage())
 			{
-				TrieDB<h256, DB> storageDB(&_db, i.second.oldRoot());
-				for (auto const& j: i.second.storage())
-					if (j.second)
-						storageDB.insert(j.first, rlp(j.second));
-					else
-						storageDB.remove(j.first);
-				s.append(storageDB.root(), false, true);
+				u256 v = s.storage().at(j);
+				b.changes.push_back(std::make_pair(h256(j), v ? rlp(v) : bytes()));
 			}
+			slots += b.changes.size();
+		}
+	}
 
-			if (i.second.isFreshCode())
+	// The storage tries are disjoint, so with enough of them changed they're rehashed on threads, each keeping its
+	// writes aside to be made below, account by account, just as they'd have been made on this thread.
+	ThreadPool& pool = ThreadPool::shared();
+	std::vector<StorageBatch*> todo;
+	std::vector<DeferredDB<DB>> deferred;
+	if (pool.size() > 1 && storage.size() > 1 && slots >= c_minParallelTrieBatch)
+	{
+		for (auto& i: storage)
+			todo.push_back(&i.second);
+		deferred.resize(todo.size(), DeferredDB<DB>(&_db));
+		pool.run(todo.size(), [&](size_t i)
+		{
+			TrieDB<h256, DeferredDB<DB>> storageDB(&deferred[i], todo[i]->root);
+			storageDB.applyBatch(todo[i]->changes);
+			todo[i]->root = storageDB.root();
+		});
+	}
+
+	std::vector<std::pair<Address, bytes>> accounts;
+	accounts.reserve(dirty.size());
+	size_t done = 0;
+	for (auto const& a: dirty)
+	{
+		AddressState& s = _cache.at(a);
+		if (!s.isAlive())
+		{
+			accounts.push_back(std::make_pair(a, bytes()));
+			_cache.erase(a);
+			continue;
+		}
+
+		h256 storageRoot = s.oldRoot();
+		auto it = storage.find(a);
+		if (it != storage.end())
+		{
+			if (todo.size())
 			{
-				h256 ch = sha3(i.second.code());
-				_db.insert(ch, &i.second.code());
-				s << ch;
+				deferred[done++].writeTo(_db);
+				storageRoot = it->second.root;
 			}
 			else
-				s << i.second.codeHash();
-
-			_state.insert(i.first, &s.out());
+			{
+				TrieDB<h256, DB> storageDB(&_db, s.oldRoot());
+				storageDB.applyBatch(it->second.changes, &pool);
+				storageRoot = storageDB.root();
+			}
 		}
-}
 
-}
+		bool freshCode = s.isFreshCode();
+		s.noteCommitted(storageRoot);
+		if (freshCode)
+			_db.insert(s.codeHash(), &s.code());
 
+		RLPStream r(4);
+		r << s.nonce() << s.balance();
+		r.append(storageRoot, false, true);
+		r << s.codeHash();
+		accounts.push_back(std::make_pair(a, r.out()));
+	}
+	_state.applyBatch(accounts, &pool);
+}
 
+}
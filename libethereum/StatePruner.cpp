@@ -0,0 +1,184 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StatePruner.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "StatePruner.h"
+
+#include <libethcore/BlockInfo.h>
+#include "BlockChain.h"
+using namespace std;
+using namespace eth;
+
+StatePruner::StatePruner(OverlayDB const& _db, unsigned _history, unsigned _interval):
+	m_db(_db),
+	m_history(_history),
+	m_interval(_interval),
+	m_marked(false)
+{
+}
+
+StatePruner::~StatePruner()
+{
+	if (m_marker)
+		m_marker->join();
+}
+
+void StatePruner::noteChain(BlockChain const& _bc)
+{
+	if (m_marker && m_marked)
+	{
+		m_marker->join();
+		m_marker.reset();
+		sweep(keptRoots(_bc));
+	}
+	if (!m_marker && _bc.number() >= m_lastPass + m_interval)
+	{
+		m_lastPass = _bc.number();
+		m_marked = false;
+		h256s roots = keptRoots(_bc);
+		m_marker.reset(new thread([=](){ markAndFind(roots); }));
+	}
+}
+
+void StatePruner::prune(BlockChain const& _bc)
+{
+	if (m_marker)
+	{
+		m_marker->join();
+		m_marker.reset();
+		m_live.clear();
+		m_dead.clear();
+	}
+	m_lastPass = _bc.number();
+	h256s roots = keptRoots(_bc);
+	markAndFind(roots);
+	sweep(roots);
+}
+
+h256s StatePruner::keptRoots(BlockChain const& _bc) const
+{
+	h256s ret;
+	for (auto const& i: _bc.checkpoints())
+		ret.push_back(i.second);
+
+	// Every block descended from the oldest recent one, whichever branch it's on.
+	h256 oldest = _bc.currentHash();
+	for (unsigned i = 0; i < m_history && oldest != _bc.genesisHash(); ++i)
+		oldest = _bc.details(oldest).parent;
+	h256s todo = { oldest };
+	while (!todo.empty())
+	{
+		h256 h = todo.back();
+		todo.pop_back();
+		ret.push_back(BlockInfo(_bc.block(h)).stateRoot);
+		for (auto const& c: _bc.details(h).children)
+			todo.push_back(c);
+	}
+	return ret;
+}
+
+void StatePruner::mark(h256 _root, bool _accounts)
+{
+	if (!m_live.insert(_root).second)
+		return;
+	string node = m_db.lookup(_root);
+	if (!node.empty())
+		markNode(RLP(node), _accounts);
+}
+
+void StatePruner::markNode(RLP const& _node, bool _accounts)
+{
+	auto markChild = [&](RLP const& _child)
+	{
+		if (_child.isList())
+			markNode(_child, _accounts);
+		else if (_child.size() == 32)
+			mark(_child.toHash<h256>(), _accounts);
+	};
+
+	if (!_node.isList())
+		return;
+	if (_node.itemCount() == 17)
+		for (unsigned i = 0; i < 16; ++i)
+			markChild(_node[i]);
+	else if (_node.itemCount() == 2)
+	{
+		bool leaf = _node[0].payload().size() && (_node[0].payload()[0] & 0x20);
+		if (!leaf)
+			markChild(_node[1]);
+		else if (_accounts)
+		{
+			// An account: [nonce, balance, storage root, code hash].
+			RLP account(_node[1].payload());
+			mark(account[2].toHash<h256>(), false);
+			h256 codeHash = account[3].toHash<h256>();
+			if (codeHash != EmptySHA3)
+				m_live.insert(codeHash);
+		}
+	}
+}
+
+void StatePruner::markAndFind(h256s const& _roots)
+{
+	if (!m_db.db())
+	{
+		m_marked = true;
+		return;
+	}
+	for (auto const& r: _roots)
+		mark(r, true);
+
+	unique_ptr<ldb::Iterator> it(m_db.db()->NewIterator(ldb::ReadOptions()));
+	for (it->SeekToFirst(); it->Valid(); it->Next())
+		if (it->key().size() == 32)
+		{
+			h256 h((byte const*)it->key().data(), h256::ConstructFromPointer);
+			if (!m_live.count(h))
+				m_dead.push_back(h);
+		}
+	m_marked = true;
+}
+
+void StatePruner::sweep(h256s const& _roots)
+{
+	if (!m_db.db())
+		return;
+
+	// Mark what's been committed since; some of it may have been found unmarked.
+	for (auto const& r: _roots)
+		mark(r, true);
+
+	ldb::WriteBatch batch;
+	size_t pruned = 0;
+	for (auto const& h: m_dead)
+		if (!m_live.count(h))
+		{
+			batch.Delete(ldb::Slice((char const*)h.data(), 32));
+			++pruned;
+		}
+	m_db.db()->Write(ldb::WriteOptions(), &batch);
+
+	++m_passes;
+	m_kept = m_live.size();
+	m_pruned += pruned;
+	clog(PrunerNote) << "Pruned" << pruned << "state nodes; kept" << m_kept;
+	m_live.clear();
+	m_dead.clear();
+}
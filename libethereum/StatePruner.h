@@ -0,0 +1,104 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file StatePruner.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <thread>
+#include <libethsupport/Common.h>
+#include <libethsupport/OverlayDB.h>
+
+namespace eth
+{
+
+class BlockChain;
+
+struct PrunerNote: public LogChannel { static const char* name() { return "=P="; } static const int verbosity = 4; };
+
+static const unsigned c_defaultPruneHistory = 256;		///< Recent blocks whose states are kept by default.
+static const unsigned c_pruneInterval = 64;				///< Blocks imported between passes by default.
+
+/**
+ * @brief Deletes the nodes of the state DB that no state worth keeping refers to.
+ * The states kept are those of the last few blocks (of every branch forking from among them, too) and those of the
+ * block chain's checkpoints, genesis among them. A pass marks every node of their tries, and their code, then deletes
+ * the rest.
+ *
+ * A pass starts once enough blocks have come in since the last one. Marking and finding what's unmarked happen on a
+ * thread of their own, while the DB is still being written to; the next call once that's done marks whatever has been
+ * committed since and deletes the rest, so nodes written meanwhile (even ones that once went unused) are safe.
+ * The DB mustn't be written to during that call.
+ *
+ * Only the nodes written through OverlayDB are touched: those keyed by 32-byte hashes.
+ */
+class StatePruner
+{
+public:
+	/// Prune the state DB @a _db, keeping the states of the last @a _history blocks and of the checkpoints, with a pass
+	/// each @a _interval blocks.
+	StatePruner(OverlayDB const& _db, unsigned _history = c_defaultPruneHistory, unsigned _interval = c_pruneInterval);
+	~StatePruner();
+
+	/// Call as blocks come in, with the DB not being written to. Starts a pass in the background if one's due, and
+	/// finishes one that's ready.
+	void noteChain(BlockChain const& _bc);
+
+	/// Make a whole pass now, waiting for any in the background first.
+	void prune(BlockChain const& _bc);
+
+	/// @returns the number of passes finished, the nodes kept by the last one and the nodes deleted by them all.
+	unsigned passes() const { return m_passes; }
+	size_t kept() const { return m_kept; }
+	size_t pruned() const { return m_pruned; }
+
+private:
+	/// @returns the state roots of the blocks whose states are to be kept.
+	h256s keptRoots(BlockChain const& _bc) const;
+
+	/// Mark the nodes of the trie at @a _root and those under them, and, if @a _accounts, the storage and code of the
+	/// accounts in it. Nodes already marked are taken to have all beneath them marked too.
+	void mark(h256 _root, bool _accounts);
+	void markNode(RLP const& _node, bool _accounts);
+
+	/// Mark from @a _roots, then find the nodes in the DB that weren't marked.
+	void markAndFind(h256s const& _roots);
+
+	/// Mark from @a _roots, then delete those found unmarked that still are.
+	void sweep(h256s const& _roots);
+
+	OverlayDB m_db;						///< Never written to, so lookups go straight to the DB.
+	unsigned m_history;
+	unsigned m_interval;
+
+	unsigned m_lastPass = 0;			///< The number of the head block when the last pass started.
+	std::unique_ptr<std::thread> m_marker;
+	std::atomic<bool> m_marked;			///< True once m_marker has found what's unmarked.
+	std::set<h256> m_live;
+	h256s m_dead;
+
+	unsigned m_passes = 0;
+	size_t m_kept = 0;
+	size_t m_pruned = 0;
+};
+
+}
@@ -63,6 +63,10 @@ Address Transaction::safeSender() const noexcept
 
 Address Transaction::sender() const
 {
+	h256 signedHash = sha3();
+	if (m_sender && m_senderOf == signedHash)
+		return m_sender;
+
 	secp256k1_start();
 
 	h256 sig[2] = { vrs.r, vrs.s };
@@ -83,9 +87,19 @@ Address Transaction::sender() const
 	cout << "PUB: " << toHex(bytesConstRef(&(pubkey[1]), 64)) << endl;
 	cout << "ADR: " << ret << endl;
 #endif
+	m_sender = ret;
+	m_senderOf = signedHash;
 	return ret;
 }
 
+void eth::recoverSenders(Transactions const& _ts, ThreadPool& _pool)
+{
+	// Set up the curve constants before anyone else can race to.
+	secp256k1_start();
+
+	_pool.run(_ts.size(), [&](size_t i){ _ts[i].safeSender(); });
+}
+
 void Transaction::sign(Secret _priv)
 {
 	int v = 0;
@@ -109,6 +123,7 @@ void Transaction::sign(Secret _priv)
 	vrs.v = (byte)(v + 27);
 	vrs.r = (u256)sig[0];
 	vrs.s = (u256)sig[1];
+	m_sender = Address();
 }
 
 void Transaction::fillStream(RLPStream& _s, bool _sig) const
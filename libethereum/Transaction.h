@@ -22,6 +22,7 @@
 #pragma once
 
 #include <libethsupport/RLP.h>
+#include <libethsupport/ThreadPool.h>
 #include <libethcore/CommonEth.h>
 
 namespace eth
@@ -54,7 +55,7 @@ struct Transaction
 	Signature vrs;		///< The signature of the transaction. Encodes the sender.
 
 	Address safeSender() const noexcept;	///< Like sender() but will never throw.
-	Address sender() const;	///< Determine the sender of the transaction from the signature (and hash).
+	Address sender() const;	///< Determine the sender of the transaction from the signature (and hash). Only worked out once for each.
 	void sign(Secret _priv);	///< Sign the transaction.
 
 	bool isCreation() const { return !receiveAddress; }
@@ -66,10 +67,20 @@ struct Transaction
 	std::string rlpString(bool _sig = true) const { return asString(rlp(_sig)); }
 	h256 sha3(bool _sig = true) const { RLPStream s; fillStream(s, _sig); return eth::sha3(s.out()); }
 	bytes sha3Bytes(bool _sig = true) const { RLPStream s; fillStream(s, _sig); return eth::sha3Bytes(s.out()); }
+
+private:
+	/// The sender, once sender() has recovered it; null until then.
+	mutable Address m_sender;
+	/// The sha3 of the signed transaction m_sender was recovered from; should any field change since, it's recovered again.
+	mutable h256 m_senderOf;
 };
 
 using Transactions = std::vector<Transaction>;
 
+/// Recover the senders of @a _ts all at once, sharing them between the threads of @a _pool, so later calls to sender()
+/// don't have to. Those with bad signatures are left for sender() to complain about.
+void recoverSenders(Transactions const& _ts, ThreadPool& _pool = ThreadPool::shared());
+
 inline std::ostream& operator<<(std::ostream& _out, Transaction const& _t)
 {
 	_out << "{";
@@ -27,12 +27,20 @@
 using namespace std;
 using namespace eth;
 
+static size_t footprint(bytes const& _rlp, Transaction const& _t)
+{
+	return _rlp.size() + _t.data.size();
+}
+
 bool TransactionQueue::import(bytesConstRef _block)
 {
 	// Check if we already know this transaction.
 	h256 h = sha3(_block);
 	if (m_data.count(h))
+	{
+		++m_status.known;
 		return false;
+	}
 
 	try
 	{
@@ -40,39 +48,154 @@ bool TransactionQueue::import(bytesConstRef _block)
 		// The transaction's nonce may yet be invalid (or, it could be "valid" but we may be missing a marginally older transaction).
 		Transaction t(_block);
 		auto s = t.sender();
-		if (m_interest.count(s))
-			m_interestQueue.push_back(t);
+
+		// Only one per sender and nonce; the better paying stays.
+		Takens taken;
+		auto bs = m_bySender.find(s);
+		if (bs != m_bySender.end() && bs->second.count(t.nonce))
+		{
+			h256 queued = bs->second.at(t.nonce);
+			if (m_decoded.at(queued).gasPrice >= t.gasPrice)
+			{
+				++m_status.rejected;
+				return false;
+			}
+			taken.push_back(take(queued));
+		}
+		bool replacing = !taken.empty();
 
 		// If valid, append to blocks.
-		m_data[h] = _block.toBytes();
+		put(h, _block.toBytes(), t, m_arrivals++);
+		enforceLimits(s, taken);
+		if (!m_data.count(h))
+		{
+			// No room for it after all; put back what went for it.
+			for (auto const& i: taken)
+				if (i.hash != h)
+					put(i);
+			++m_status.rejected;
+			return false;
+		}
+
+		if (replacing)
+			++m_status.replaced;
+		m_status.evicted += taken.size() - (replacing ? 1 : 0);
+		++m_status.imported;
+		if (m_interest.count(s))
+			m_interestQueue.push_back(t);
 	}
 	catch (InvalidTransactionFormat const& _e)
 	{
 		cwarn << "Ignoring invalid transaction: " << _e.description();
+		++m_status.rejected;
 		return false;
 	}
 	catch (std::exception const& _e)
 	{
 		cwarn << "Ignoring invalid transaction: " << _e.what();
+		++m_status.rejected;
 		return false;
 	}
 
 	return true;
 }
 
-void TransactionQueue::setFuture(std::pair<h256, bytes> const& _t)
+void TransactionQueue::drop(h256 _txHash)
+{
+	if (m_decoded.count(_txHash))
+		take(_txHash);
+}
+
+void TransactionQueue::put(h256 _txHash, bytes const& _rlp, Transaction const& _t, unsigned _arrival)
 {
-	if (m_data.count(_t.first))
+	Address s = _t.sender();
+	auto& rlp = m_data[_txHash];
+	rlp = _rlp;
+	m_bytes += footprint(rlp, _t);
+	++m_changes;
+	m_bySender[s][_t.nonce] = _txHash;
+	m_byGasPrice.insert(make_pair(_t.gasPrice, _txHash));
+	m_arrival[_txHash] = _arrival;
+	m_decoded.insert(make_pair(_txHash, _t));
+	noteGaps(s);
+}
+
+TransactionQueue::Taken TransactionQueue::take(h256 _txHash)
+{
+	auto it = m_decoded.find(_txHash);
+	auto d = m_data.find(_txHash);
+	auto a = m_arrival.find(_txHash);
+	Taken ret{_txHash, move(d->second), move(it->second), a->second};
+	Transaction const& t = ret.transaction;
+	Address sender = t.sender();
+	auto s = m_bySender.find(sender);
+	s->second.erase(t.nonce);
+	if (s->second.empty())
+		m_bySender.erase(s);
+	m_byGasPrice.erase(make_pair(t.gasPrice, _txHash));
+	m_future.erase(make_pair(ret.arrival, _txHash));
+	m_bytes -= footprint(ret.rlp, t);
+	m_data.erase(d);
+	m_decoded.erase(it);
+	m_arrival.erase(a);
+	++m_changes;
+	noteGaps(sender);
+	return ret;
+}
+
+void TransactionQueue::noteGaps(Address _sender)
+{
+	auto s = m_bySender.find(_sender);
+	if (s == m_bySender.end())
+		return;
+	// The lowest queued may be next for the sender, for all we know; those after it are, till a nonce is missed.
+	bool gap = false;
+	u256 next = s->second.begin()->first;
+	for (auto const& i: s->second)
 	{
-		m_data.erase(_t.first);
-		m_future.insert(make_pair(Transaction(_t.second).sender(), _t));
+		gap = gap || i.first != next;
+		next = i.first + 1;
+		auto f = make_pair(m_arrival.at(i.second), i.second);
+		if (gap)
+			m_future.insert(f);
+		else
+			m_future.erase(f);
 	}
 }
 
-void TransactionQueue::noteGood(std::pair<h256, bytes> const& _t)
+void TransactionQueue::setLimits(size_t _transactions, size_t _bytes, size_t _perSender)
+{
+	m_maxTransactions = _transactions;
+	m_maxBytes = _bytes;
+	m_maxPerSender = _perSender;
+	Addresses senders;
+	for (auto const& s: m_bySender)
+		senders.push_back(s.first);
+	Takens taken;
+	for (auto const& s: senders)
+		enforceLimits(s, taken);
+	m_status.evicted += taken.size();
+}
+
+void TransactionQueue::evict(h256 _txHash, Takens& o_taken)
 {
-	auto r = m_future.equal_range(Transaction(_t.second).sender());
-	for (auto it = r.first; it != r.second; ++it)
-		m_data.insert(_t);
-	m_future.erase(r.first, r.second);
+	Transaction const& t = m_decoded.at(_txHash);
+	auto const& queued = m_bySender.at(t.sender());
+	h256s doomed;
+	for (auto it = queued.find(t.nonce); it != queued.end(); ++it)
+		doomed.push_back(it->second);
+	for (auto const& h: doomed)
+		o_taken.push_back(take(h));
+}
+
+void TransactionQueue::enforceLimits(Address _sender, Takens& o_taken)
+{
+	auto s = m_bySender.find(_sender);
+	while (s != m_bySender.end() && s->second.size() > m_maxPerSender)
+	{
+		o_taken.push_back(take(s->second.rbegin()->second));
+		s = m_bySender.find(_sender);
+	}
+	while (m_data.size() > m_maxTransactions || m_bytes > m_maxBytes)
+		evict(m_future.empty() ? m_byGasPrice.begin()->second : m_future.begin()->second, o_taken);
 }
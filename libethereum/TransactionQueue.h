@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <set>
 #include <libethsupport/Common.h>
 #include "Transaction.h"
 
@@ -29,8 +30,33 @@ namespace eth
 
 class BlockChain;
 
+static const size_t c_maxQueuedTransactions = 8192;			///< Transactions queued, at most, by default.
+static const size_t c_maxQueuedBytes = 16 * 1024 * 1024;		///< Bytes they take, at most, by default.
+static const size_t c_maxQueuedPerSender = 256;				///< Transactions of any one sender queued, at most, by default.
+
+struct TransactionQueueStatus
+{
+	size_t transactions = 0;
+	size_t bytes = 0;				///< Their RLP and data, each counted once per transaction.
+	size_t senders = 0;
+
+	unsigned imported = 0;
+	unsigned known = 0;				///< Turned away as already queued.
+	unsigned rejected = 0;			///< Turned away as invalid, outbid by the one queued or for lack of room.
+	unsigned replaced = 0;			///< Dropped for one of the same sender and nonce with a better gas price.
+	unsigned evicted = 0;			///< Dropped to make room.
+};
+
 /**
- * @brief A queue of Transactions, each stored as RLP.
+ * @brief A queue of Transactions, each stored as RLP and decoded, with its sender recovered.
+ * They're indexed by sender, in nonce order, since a sender's transactions can only go into a block in that order,
+ * and by gas price. A sender has at most one queued per nonce; another with a better gas price replaces it.
+ *
+ * The queue is bounded in transactions, in bytes and in transactions per sender. Over the sender's limit, its
+ * transaction of the highest nonce goes. Over the others, those that can't go into a block till a gap in their
+ * sender's nonces is filled go first, oldest first; then the cheapest of the rest. Whichever goes, its sender's of
+ * higher nonce go with it, since they can't go in without it. A transaction that would itself have to go to make room
+ * is turned away, leaving the queue as it was.
  */
 class TransactionQueue
 {
@@ -38,21 +64,77 @@ public:
 	bool attemptImport(bytesConstRef _block) { try { import(_block); return true; } catch (...) { return false; } }
 	bool attemptImport(bytes const& _block) { try { import(&_block); return true; } catch (...) { return false; } }
 	bool import(bytesConstRef _block);
-	void drop(h256 _txHash) { m_data.erase(_txHash); }
+	void drop(h256 _txHash);
+
+	/// Bound the queue to @a _transactions transactions, @a _bytes bytes and @a _perSender transactions per sender.
+	void setLimits(size_t _transactions, size_t _bytes, size_t _perSender);
+
+	/// @returns how full the queue is and what's happened to the transactions that came to it.
+	TransactionQueueStatus status() const { auto ret = m_status; ret.transactions = m_data.size(); ret.bytes = m_bytes; ret.senders = m_bySender.size(); return ret; }
+
+	/// @returns the queued transactions' RLP, by hash.
 	std::map<h256, bytes> const& transactions() const { return m_data; }
 
-	void setFuture(std::pair<h256, bytes> const& _t);
-	void noteGood(std::pair<h256, bytes> const& _t);
+	/// @returns the queued transaction @a _txHash, or nullptr if there's none.
+	Transaction const* transaction(h256 _txHash) const { auto it = m_decoded.find(_txHash); return it != m_decoded.end() ? &it->second : nullptr; }
+
+	/// @returns the hashes of the queued transactions of each sender, by nonce.
+	std::map<Address, std::map<u256, h256>> const& bySender() const { return m_bySender; }
+
+	/// @returns the gas price and hash of each queued transaction, cheapest first.
+	std::set<std::pair<u256, h256>> const& byGasPrice() const { return m_byGasPrice; }
+
+	/// @returns a count of the transactions queued and dropped; it changes whenever what's queued does.
+	unsigned changes() const { return m_changes; }
 
 	Transactions interestQueue() { Transactions ret; swap(ret, m_interestQueue); return ret; }
 	void pushInterest(Address _a) { m_interest[_a]++; }
 	void popInterest(Address _a) { if (m_interest[_a] > 1) m_interest[_a]--; else if (m_interest[_a]) m_interest.erase(_a); }
 
 private:
+	/// A transaction taken from the queue, with what's needed to put it back.
+	struct Taken
+	{
+		h256 hash;
+		bytes rlp;
+		Transaction transaction;
+		unsigned arrival;
+	};
+	using Takens = std::vector<Taken>;
+
+	/// Queue @a _t, whose RLP is @a _rlp and hash @a _txHash, as the @a _arrival th to arrive.
+	void put(h256 _txHash, bytes const& _rlp, Transaction const& _t, unsigned _arrival);
+	void put(Taken const& _t) { put(_t.hash, _t.rlp, _t.transaction, _t.arrival); }
+
+	/// Take @a _txHash from the queue, which must hold it.
+	Taken take(h256 _txHash);
+
+	/// Take @a _txHash and its sender's transactions of higher nonce into @a o_taken, to make room.
+	void evict(h256 _txHash, Takens& o_taken);
+
+	/// Make room by the limits, taking what has to go into @a o_taken.
+	void enforceLimits(Address _sender, Takens& o_taken);
+
+	/// Note which of @a _sender's transactions are behind a gap in its nonces.
+	void noteGaps(Address _sender);
+
 	std::map<h256, bytes> m_data;		///< Map of SHA3(tx) to tx.
+	std::map<h256, Transaction> m_decoded;						///< The same, decoded; their senders are known.
+	std::map<Address, std::map<u256, h256>> m_bySender;
+	std::set<std::pair<u256, h256>> m_byGasPrice;
+	std::map<h256, unsigned> m_arrival;							///< When each arrived, in the order they did.
+	std::set<std::pair<unsigned, h256>> m_future;				///< Those behind a gap in their sender's nonces, by arrival.
+	unsigned m_arrivals = 0;
+	size_t m_bytes = 0;
+	unsigned m_changes = 0;
+
+	size_t m_maxTransactions = c_maxQueuedTransactions;
+	size_t m_maxBytes = c_maxQueuedBytes;
+	size_t m_maxPerSender = c_maxQueuedPerSender;
+	TransactionQueueStatus m_status;
+
 	Transactions m_interestQueue;
 	std::map<Address, int> m_interest;
-	std::multimap<Address, std::pair<h256, bytes>> m_future;		///< For transactions that have a future nonce; we map their sender address to the tx stuff, and insert once the sender has a valid TX.
 };
 
 }
@@ -161,6 +161,16 @@ template<> inline size_t FixedHash<32>::hash::operator()(FixedHash<32> const& va
 	return (size_t)hash;
 }
 
+/// Fast std::hash compatible hash function object for h160.
+template<> inline size_t FixedHash<20>::hash::operator()(FixedHash<20> const& value) const
+{
+	uint64_t data[2];
+	uint32_t last;
+	memcpy(data, value.data(), 16);
+	memcpy(&last, value.data() + 16, 4);
+	return (size_t)(data[0] ^ data[1] ^ last);
+}
+
 /// Stream I/O for the FixedHash class.
 template <unsigned N>
 inline std::ostream& operator<<(std::ostream& _out, FixedHash<N> const& _h)
@@ -231,4 +241,7 @@ namespace std
 {
 	/// Forward std::hash<eth::h256> to eth::h256::hash.
 	template<> struct hash<eth::h256>: eth::h256::hash {};
+
+	/// Forward std::hash<eth::h160> to eth::h160::hash.
+	template<> struct hash<eth::h160>: eth::h160::hash {};
 }
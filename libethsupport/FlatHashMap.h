@@ -0,0 +1,215 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file FlatHashMap.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ *
+ * Open-addressing hash map.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "Common.h"
+#include "FixedHash.h"
+
+namespace eth
+{
+
+/// std::hash compatible hash function object for u256, mixing its limbs.
+struct U256Hash
+{
+	size_t operator()(u256 const& _u) const
+	{
+		auto const& b = _u.backend();
+		uint64_t ret = 0;
+		for (unsigned i = 0; i < b.size(); ++i)
+			ret = (ret ^ b.limbs()[i]) * 0x100000001b3ull;
+		return (size_t)ret;
+	}
+};
+
+/**
+ * @brief A hash map keeping its entries in one flat array, found by linear probing.
+ * Finding a key is usually a single cache miss, rather than the walk down a tree of separately allocated nodes that a
+ * std::map takes. Keys with weak hashes (small integers, say) are fine; the hash is mixed before it picks a slot.
+ *
+ * Unlike std::map, iteration order is arbitrary, and inserting or erasing moves entries about, invalidating iterators
+ * and references (though entries are moved, so e.g. the data of a vector held by one stays put). Use sorted() where
+ * the order matters.
+ */
+template <class _Key, class _T, class _Hash = std::hash<_Key>>
+class FlatHashMap
+{
+public:
+	using key_type = _Key;
+	using mapped_type = _T;
+	using value_type = std::pair<_Key, _T>;		///< Keys mustn't be changed through iterators.
+
+private:
+	struct Slot
+	{
+		bool used = false;
+		value_type value;
+	};
+
+	template <class _Slot, class _Value>
+	class Iterator: public std::iterator<std::forward_iterator_tag, _Value>
+	{
+	public:
+		Iterator(): m_slot(nullptr), m_end(nullptr) {}
+		Iterator(_Slot* _slot, _Slot* _end): m_slot(_slot), m_end(_end) { skip(); }
+		template <class _S, class _V> Iterator(Iterator<_S, _V> const& _i): m_slot(_i.m_slot), m_end(_i.m_end) {}
+
+		_Value& operator*() const { return m_slot->value; }
+		_Value* operator->() const { return &m_slot->value; }
+		Iterator& operator++() { ++m_slot; skip(); return *this; }
+		Iterator operator++(int) { Iterator ret = *this; ++*this; return ret; }
+		bool operator==(Iterator const& _c) const { return m_slot == _c.m_slot; }
+		bool operator!=(Iterator const& _c) const { return m_slot != _c.m_slot; }
+
+	private:
+		template <class _S, class _V> friend class Iterator;
+		friend class FlatHashMap;
+		void skip() { while (m_slot != m_end && !m_slot->used) ++m_slot; }
+
+		_Slot* m_slot;
+		_Slot* m_end;
+	};
+
+public:
+	using iterator = Iterator<Slot, value_type>;
+	using const_iterator = Iterator<Slot const, value_type const>;
+
+	FlatHashMap() {}
+
+	iterator begin() { return iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+	iterator end() { return iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+	const_iterator begin() const { return const_iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+	const_iterator end() const { return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+
+	size_t size() const { return m_size; }
+	bool empty() const { return !m_size; }
+
+	/// Remove everything, keeping the room it took.
+	void clear() { for (auto& i: m_slots) if (i.used) { i.used = false; i.value = value_type(); } m_size = 0; }
+
+	iterator find(_Key const& _k) { size_t i = slotOf(_k); return m_slots.size() && m_slots[i].used ? iterator(m_slots.data() + i, m_slots.data() + m_slots.size()) : end(); }
+	const_iterator find(_Key const& _k) const { size_t i = slotOf(_k); return m_slots.size() && m_slots[i].used ? const_iterator(m_slots.data() + i, m_slots.data() + m_slots.size()) : end(); }
+	size_t count(_Key const& _k) const { return find(_k) != end() ? 1 : 0; }
+
+	_T& at(_Key const& _k) { auto it = find(_k); if (it == end()) throw std::out_of_range("FlatHashMap::at"); return it->second; }
+	_T const& at(_Key const& _k) const { auto it = find(_k); if (it == end()) throw std::out_of_range("FlatHashMap::at"); return it->second; }
+	_T& operator[](_Key const& _k) { return insert(value_type(_k, _T())).first->second; }
+
+	/// Insert @a _v if there's nothing at its key. @returns where the key's entry is, and true if it was inserted.
+	std::pair<iterator, bool> insert(value_type const& _v)
+	{
+		// Only grow for a new entry, so those already in it don't move.
+		size_t i = slotOf(_v.first);
+		if (m_slots.size() && m_slots[i].used)
+			return std::make_pair(iterator(m_slots.data() + i, m_slots.data() + m_slots.size()), false);
+		if ((m_size + 1) * 4 > m_slots.size() * 3)
+		{
+			grow();
+			i = slotOf(_v.first);
+		}
+		m_slots[i].used = true;
+		m_slots[i].value = _v;
+		++m_size;
+		return std::make_pair(iterator(m_slots.data() + i, m_slots.data() + m_slots.size()), true);
+	}
+
+	/// Remove the entry at @a _k, if any. @returns the number of entries removed.
+	size_t erase(_Key const& _k)
+	{
+		if (!m_slots.size())
+			return 0;
+		size_t i = slotOf(_k);
+		if (!m_slots[i].used)
+			return 0;
+		// Shift back any later entries of the run that would no longer be found past the gap.
+		size_t mask = m_slots.size() - 1;
+		for (size_t j = (i + 1) & mask; m_slots[j].used; j = (j + 1) & mask)
+		{
+			size_t home = homeOf(m_slots[j].value.first);
+			if (((j - home) & mask) >= ((j - i) & mask))
+			{
+				m_slots[i].value = std::move(m_slots[j].value);
+				i = j;
+			}
+		}
+		m_slots[i].used = false;
+		m_slots[i].value = value_type();
+		--m_size;
+		return 1;
+	}
+
+	/// @returns the entries, ordered by key.
+	std::vector<value_type const*> sorted() const
+	{
+		std::vector<value_type const*> ret;
+		ret.reserve(m_size);
+		for (auto const& i: *this)
+			ret.push_back(&i);
+		std::sort(ret.begin(), ret.end(), [](value_type const* a, value_type const* b) { return a->first < b->first; });
+		return ret;
+	}
+
+private:
+	/// @returns the slot the key @a _k would rather be in. There must be some slots.
+	size_t homeOf(_Key const& _k) const { return (size_t)(((uint64_t)_Hash()(_k) * 0x9e3779b97f4a7c15ull) >> m_shift); }
+
+	/// @returns the slot that either holds @a _k or is the free one it would go in. There must be some slots.
+	size_t slotOf(_Key const& _k) const
+	{
+		if (!m_slots.size())
+			return 0;
+		size_t mask = m_slots.size() - 1;
+		size_t i = homeOf(_k);
+		while (m_slots[i].used && !(m_slots[i].value.first == _k))
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	void grow()
+	{
+		std::vector<Slot> old;
+		old.swap(m_slots);
+		m_slots.resize(old.size() ? old.size() * 2 : 8);
+		m_shift = 64;
+		for (size_t s = m_slots.size(); s > 1; s >>= 1)
+			--m_shift;
+		for (auto& i: old)
+			if (i.used)
+			{
+				size_t j = slotOf(i.value.first);
+				m_slots[j].used = true;
+				m_slots[j].value = std::move(i.value);
+			}
+	}
+
+	std::vector<Slot> m_slots;		///< A power of two of them, or none. Always at least a quarter are free.
+	size_t m_size = 0;
+	unsigned m_shift = 64;			///< 64 less the log2 of the number of slots.
+};
+
+}
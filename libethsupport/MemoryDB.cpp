@@ -27,25 +27,95 @@ using namespace eth;
 namespace eth
 {
 
+MemoryDB& MemoryDB::operator=(MemoryDB const& _s)
+{
+	if (&_s != this)
+	{
+		_s.freeze();
+		m_over.clear();
+		m_layers = _s.m_layers;
+		m_nodeCache = _s.m_nodeCache;
+		m_enforceRefs = _s.m_enforceRefs;
+	}
+	return *this;
+}
+
+void MemoryDB::freeze() const
+{
+	if (m_over.empty())
+		return;
+	auto l = make_shared<Layer>();
+	if (m_layers && m_layers->depth >= c_maxMemoryDBLayers)
+	{
+		// Too many to look through quickly; squash them all (and our changes) into one, dropping what's hidden.
+		for (auto const& i: entries())
+			if (i.second->hasValue || i.second->refs)
+				l->entries.insert(make_pair(i.first, *i.second));
+	}
+	else
+	{
+		swap(l->entries, m_over);
+		l->parent = m_layers;
+		l->depth = m_layers ? m_layers->depth + 1 : 1;
+	}
+	m_over = Entries();
+	m_layers = l;
+}
+
+MemoryDB::Entry const* MemoryDB::find(h256 _h) const
+{
+	auto it = m_over.find(_h);
+	if (it != m_over.end())
+		return &it->second;
+	for (Layer const* l = m_layers.get(); l; l = l->parent.get())
+	{
+		auto lit = l->entries.find(_h);
+		if (lit != l->entries.end())
+			return &lit->second;
+	}
+	return nullptr;
+}
+
+MemoryDB::Entry& MemoryDB::entry(h256 _h)
+{
+	auto it = m_over.find(_h);
+	if (it != m_over.end())
+		return it->second;
+	Entry const* e = find(_h);
+	return m_over.insert(make_pair(_h, e ? *e : Entry())).first->second;
+}
+
+std::map<h256, MemoryDB::Entry const*> MemoryDB::entries() const
+{
+	std::vector<Layer const*> layers;
+	for (Layer const* l = m_layers.get(); l; l = l->parent.get())
+		layers.push_back(l);
+	std::map<h256, Entry const*> ret;
+	for (auto l = layers.rbegin(); l != layers.rend(); ++l)
+		for (auto const& i: (*l)->entries)
+			ret[i.first] = &i.second;
+	for (auto const& i: m_over)
+		ret[i.first] = &i.second;
+	return ret;
+}
+
 std::map<h256, std::string> MemoryDB::get() const
 {
-	if (!m_enforceRefs)
-		return m_over;
 	std::map<h256, std::string> ret;
-	for (auto const& i: m_refCount)
-		if (i.second)
-			ret.insert(*m_over.find(i.first));
+	for (auto const& i: entries())
+		if (i.second->hasValue && (!m_enforceRefs || i.second->refs))
+			ret.insert(make_pair(i.first, i.second->value));
 	return ret;
 }
 
 std::string MemoryDB::lookup(h256 _h) const
 {
-	auto it = m_over.find(_h);
-	if (it != m_over.end())
+	Entry const* e = find(_h);
+	if (e && e->hasValue)
 	{
-		if (!m_enforceRefs || (m_refCount.count(it->first) && m_refCount.at(it->first)))
-			return it->second;
-//		else if (m_enforceRefs && m_refCount.count(it->first) && !m_refCount.at(it->first))
+		if (!m_enforceRefs || e->refs)
+			return e->value;
+//		else if (m_enforceRefs && !e->refs)
 //			cnote << "Lookup required for value with no refs. Let's hope it's in the DB." << _h.abridged();
 	}
 	return std::string();
@@ -53,61 +123,66 @@ std::string MemoryDB::lookup(h256 _h) const
 
 bool MemoryDB::exists(h256 _h) const
 {
-	auto it = m_over.find(_h);
-	if (it != m_over.end() && (!m_enforceRefs || (m_refCount.count(it->first) && m_refCount.at(it->first))))
+	Entry const* e = find(_h);
+	if (e && e->hasValue && (!m_enforceRefs || e->refs))
 		return true;
 	return false;
 }
 
 void MemoryDB::insert(h256 _h, bytesConstRef _v)
 {
-	m_over[_h] = _v.toString();
-	m_refCount[_h]++;
+	Entry& e = entry(_h);
+	e.value = _v.toString();
+	e.hasValue = true;
+	e.refs++;
 #if ETH_PARANOIA
-	dbdebug << "INST" << _h.abridged() << "=>" << m_refCount[_h];
+	dbdebug << "INST" << _h.abridged() << "=>" << e.refs;
 #endif
 }
 
 bool MemoryDB::kill(h256 _h)
 {
-	if (m_refCount.count(_h))
+	Entry const* e = find(_h);
+	if (e && e->refs)
 	{
-		if (m_refCount[_h] > 0)
-			--m_refCount[_h];
+		uint refs = --entry(_h).refs;
 #if ETH_PARANOIA
-		else
-		{
-			// If we get to this point, then there was probably a node in the level DB which we need to remove and which we have previously
-			// used as part of the memory-based MemoryDB. Nothing to be worried about *as long as the node exists in the DB*.
-			dbdebug << "NOKILL-WAS" << _h.abridged();
-			return false;
-		}
-		dbdebug << "KILL" << _h.abridged() << "=>" << m_refCount[_h];
+		dbdebug << "KILL" << _h.abridged() << "=>" << refs;
+#else
+		(void)refs;
+#endif
 		return true;
 	}
-	else
-	{
-		dbdebug << "NOKILL" << _h.abridged();
-		return false;
-	}
+#if ETH_PARANOIA
+	// If we get to this point with a node we know of, then there was probably a node in the level DB which we need to
+	// remove and which we have previously used as part of the memory-based MemoryDB. Nothing to be worried about *as
+	// long as the node exists in the DB*.
+	dbdebug << (e ? "NOKILL-WAS" : "NOKILL") << _h.abridged();
+	return false;
 #else
-	}
 	return true;
 #endif
 }
 
 void MemoryDB::purge()
 {
-	for (auto const& i: m_refCount)
-		if (!i.second)
-			m_over.erase(i.first);
+	std::vector<h256> dead;
+	for (auto const& i: entries())
+		if (i.second->hasValue && !i.second->refs)
+			dead.push_back(i.first);
+	for (auto const& h: dead)
+	{
+		Entry& e = entry(h);
+		e.value.clear();
+		e.hasValue = false;
+	}
 }
 
 set<h256> MemoryDB::keys() const
 {
 	set<h256> ret;
-	for (auto const& i: m_refCount)
-		if (i.second)
+	for (auto const& i: entries())
+		if (i.second->refs)
 			ret.insert(i.first);
 	return ret;
 }
@@ -22,10 +22,13 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include "Common.h"
 #include "FixedHash.h"
+#include "FlatHashMap.h"
 #include "RLP.h"
 #include "Log.h"
+#include "TrieNodeCache.h"
 
 namespace eth
 {
@@ -34,14 +37,29 @@ struct DBChannel: public LogChannel  { static const char* name() { return "TDB";
 
 #define dbdebug clog(DBChannel)
 
+static const unsigned c_maxMemoryDBLayers = 8;		///< Frozen layers a MemoryDB looks through before they're squashed into one.
+
+/**
+ * @brief In-memory, reference-counted store of nodes, keyed by hash.
+ * Copies are cheap: copying freezes the nodes written so far into a layer that's shared by the original and the copy,
+ * each then writing its own changes on top. Lookups look through the changes and then each layer beneath in turn;
+ * once there are more than c_maxMemoryDBLayers of those, they're squashed into one.
+ *
+ * Copying changes what the original holds internally (though not what it looks like), so don't copy the same DB on
+ * several threads at once unless it has been copied since it was last written to.
+ *
+ * The DB and its copies share a cache of the trie nodes looked up in them, decoded.
+ */
 class MemoryDB
 {
 	friend class EnforceRefs;
 
 public:
-	MemoryDB() {}
+	MemoryDB(): m_nodeCache(std::make_shared<TrieNodeCache>()) {}
+	MemoryDB(MemoryDB const& _s): m_nodeCache(_s.m_nodeCache), m_enforceRefs(_s.m_enforceRefs) { _s.freeze(); m_layers = _s.m_layers; }
+	MemoryDB& operator=(MemoryDB const& _s);
 
-	void clear() { m_over.clear(); }
+	void clear() { m_over.clear(); m_layers.reset(); }
 	std::map<h256, std::string> get() const;
 
 	std::string lookup(h256 _h) const;
@@ -52,9 +70,44 @@ public:
 
 	std::set<h256> keys() const;
 
+	/// @returns the cache of decoded trie nodes, or nullptr if refs are being enforced; nodes must then come from the
+	/// DB itself, since a cached one may be no longer referenced.
+	TrieNodeCache* nodeCache() const { return m_enforceRefs ? nullptr : m_nodeCache.get(); }
+
 protected:
-	std::map<h256, std::string> m_over;
-	std::map<h256, uint> m_refCount;
+	/// What's known of a node. One with neither value nor refs hides any in the layers beneath.
+	struct Entry
+	{
+		std::string value;
+		uint refs = 0;
+		bool hasValue = false;		///< False if it was never inserted, or has since been purged.
+	};
+	using Entries = FlatHashMap<h256, Entry>;
+
+	/// @returns what's known of the node @a _h, or nullptr if nothing.
+	Entry const* find(h256 _h) const;
+
+	/// @returns every node known of, ordered by hash. Pointers are invalidated by any change.
+	std::map<h256, Entry const*> entries() const;
+
+private:
+	/// Nodes written, frozen and shared between copies, over those of the layer beneath.
+	struct Layer
+	{
+		Entries entries;
+		std::shared_ptr<Layer const> parent;
+		unsigned depth = 1;
+	};
+
+	/// @returns the entry of the node @a _h among our own changes, copying it up from the layers first if need be.
+	Entry& entry(h256 _h);
+
+	/// Move our own changes into a new shared layer, if there are any.
+	void freeze() const;
+
+	mutable Entries m_over;							///< Our own changes, over those of m_layers.
+	mutable std::shared_ptr<Layer const> m_layers;
+	std::shared_ptr<TrieNodeCache> m_nodeCache;
 
 	mutable bool m_enforceRefs = false;
 };
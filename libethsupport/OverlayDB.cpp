@@ -37,7 +37,7 @@ void OverlayDB::setDB(ldb::DB* _db, bool _clearOverlay)
 {
 	m_db = std::shared_ptr<ldb::DB>(_db);
 	if (_clearOverlay)
-		m_over.clear();
+		clear();
 }
 
 void OverlayDB::commit()
@@ -45,21 +45,19 @@ void OverlayDB::commit()
 	if (m_db)
 	{
 //		cnote << "Committing nodes to disk DB:";
-		for (auto const& i: m_over)
+		for (auto const& i: entries())
 		{
-//			cnote << i.first << "#" << m_refCount[i.first];
-			if (m_refCount[i.first])
-				m_db->Put(m_writeOptions, ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second.data(), i.second.size()));
+//			cnote << i.first << "#" << i.second->refs;
+			if (i.second->hasValue && i.second->refs)
+				m_db->Put(m_writeOptions, ldb::Slice((char const*)i.first.data(), i.first.size), ldb::Slice(i.second->value.data(), i.second->value.size()));
 		}
-		m_over.clear();
-		m_refCount.clear();
+		clear();
 	}
 }
 
 void OverlayDB::rollback()
 {
-	m_over.clear();
-	m_refCount.clear();
+	clear();
 }
 
 std::string OverlayDB::lookup(h256 _h) const
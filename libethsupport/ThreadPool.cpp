@@ -0,0 +1,125 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ThreadPool.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace eth;
+
+ThreadPool::ThreadPool(unsigned _threads):
+	m_busy(false),
+	m_next(0)
+{
+	for (unsigned i = 0; i < _threads; ++i)
+		m_threads.push_back(thread([=](){ work(); }));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> l(x_job);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& i: m_threads)
+		i.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool s_ret(max(thread::hardware_concurrency(), 1u) - 1);
+	return s_ret;
+}
+
+void ThreadPool::run(size_t _count, function<void(size_t)> const& _f)
+{
+	if (m_threads.empty() || _count < 2 || m_busy.exchange(true))
+	{
+		for (size_t i = 0; i < _count; ++i)
+			_f(i);
+		return;
+	}
+
+	{
+		lock_guard<mutex> l(x_job);
+		m_job = &_f;
+		m_count = _count;
+		m_next = 0;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	help(_f, _count);
+
+	// Wait for those still at it; any that wake later find nothing to do.
+	exception_ptr error;
+	{
+		unique_lock<mutex> l(x_job);
+		m_done.wait(l, [&](){ return !m_helping; });
+		m_job = nullptr;
+		swap(error, m_error);
+	}
+	m_busy = false;
+	if (error)
+		rethrow_exception(error);
+}
+
+void ThreadPool::help(function<void(size_t)> const& _f, size_t _count)
+{
+	try
+	{
+		for (size_t i; (i = m_next++) < _count;)
+			_f(i);
+	}
+	catch (...)
+	{
+		m_next = _count;
+		lock_guard<mutex> l(x_job);
+		if (!m_error)
+			m_error = current_exception();
+	}
+}
+
+void ThreadPool::work()
+{
+	unsigned seen = 0;
+	unique_lock<mutex> l(x_job);
+	while (true)
+	{
+		m_wake.wait(l, [&](){ return m_stop || m_generation != seen; });
+		if (m_stop)
+			return;
+		seen = m_generation;
+		if (!m_job)
+			continue;
+
+		auto job = m_job;
+		size_t count = m_count;
+		++m_helping;
+		l.unlock();
+		help(*job, count);
+		l.lock();
+		if (!--m_helping)
+			m_done.notify_all();
+	}
+}
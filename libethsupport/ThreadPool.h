@@ -0,0 +1,81 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file ThreadPool.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eth
+{
+
+/**
+ * @brief Threads kept waiting for work, so that doing a little on several of them doesn't cost starting them each time.
+ * One run() at a time has them; should another come meanwhile, its caller does all of it alone.
+ */
+class ThreadPool
+{
+public:
+	/// Start @a _threads threads; run() has those and its caller's.
+	explicit ThreadPool(unsigned _threads);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	/// Call @a _f with each of 0 to @a _count - 1, on the threads and the caller's, returning once all are done.
+	/// Should @a _f throw, no more calls are begun, and once those under way are done the first exception is rethrown.
+	void run(size_t _count, std::function<void(size_t)> const& _f);
+
+	/// @returns the number of threads that run() spreads the work over, the caller's among them.
+	unsigned size() const { return m_threads.size() + 1; }
+
+	/// @returns the pool shared by all that spreads its work over the cores; it has a thread for each but the caller's.
+	static ThreadPool& shared();
+
+private:
+	/// What each thread does: wait for run() to give it something, help do it, repeat.
+	void work();
+
+	/// Call @a _f for what's left of 0 to @a _count - 1; should it throw, keep the exception and leave the rest.
+	void help(std::function<void(size_t)> const& _f, size_t _count);
+
+	std::vector<std::thread> m_threads;
+	std::atomic<bool> m_busy;			///< Set while a run() has the threads; one within it, even on its own thread, sees it.
+
+	std::mutex x_job;					///< Guards what follows, but m_next.
+	std::condition_variable m_wake;		///< Notified when there's something to do, or it's time to stop.
+	std::condition_variable m_done;		///< Notified when the last thread helping leaves off.
+	std::function<void(size_t)> const* m_job = nullptr;	///< What to do, or null once done.
+	size_t m_count = 0;
+	std::atomic<size_t> m_next;			///< The next of 0 to m_count - 1 to be done.
+	unsigned m_generation = 0;			///< Bumped with each run(), so a thread knows when there's more to do.
+	unsigned m_helping = 0;				///< The threads helping with m_job.
+	std::exception_ptr m_error;			///< The first exception thrown by m_job.
+	bool m_stop = false;
+};
+
+}
@@ -53,6 +53,8 @@ struct NibbleSlice
 	uint shared(NibbleSlice _k) const { return sharedNibbles(data, offset, offset + size(), _k.data, _k.offset, _k.offset + _k.size()); }
 	bool operator==(NibbleSlice _k) const { return _k.size() == size() && shared(_k) == _k.size(); }
 	bool operator!=(NibbleSlice _s) const { return !operator==(_s); }
+	/// Ordered nibble by nibble, a prefix first; the same order as the keys' bytes.
+	bool operator<(NibbleSlice _k) const { uint s = shared(_k); return s < _k.size() && (s == size() || operator[](s) < _k[s]); }
 };
 
 inline std::ostream& operator<<(std::ostream& _out, NibbleSlice const& _m)
@@ -29,4 +29,70 @@ namespace eth
 
 const h256 c_shaNull = sha3(rlp(""));
 
+bool verifyTrieProof(h256 const& _root, bytesConstRef _key, bytesConstRef _value, TrieProof const& _proof)
+{
+	// Walk down from the root as GenericTrieDB::at() does, taking each node referred to by hash from the proof in
+	// turn, once it's checked to be the one referred to.
+	NibbleSlice key(_key);
+	h256 want = _root ? _root : c_shaNull;	// as GenericTrieDB::root() gives it for the empty trie.
+	bool byHash = true;
+	RLP here;
+	unsigned used = 0;
+	// Any RLP that's not well formed is as good as no proof.
+	try
+	{
+		while (true)
+		{
+			if (byHash)
+			{
+				if (used == _proof.size() || sha3(_proof[used]) != want)
+					return false;
+				here = RLP(_proof[used++]);
+			}
+
+			TrieNode n(here);
+			RLP next;
+			bytesConstRef found;
+			if (n.itemCount == 2 && n.isLeaf)
+				found = key == n.key ? n.items[1].payload() : bytesConstRef();
+			else if (n.itemCount == 2 && key.contains(n.key))
+			{
+				next = n.items[1];
+				key = key.mid(n.key.size());
+			}
+			else if (n.itemCount == 17 && !key.size())
+				found = n.items[16].payload();
+			else if (n.itemCount == 17)
+			{
+				next = n.items[key[0]];
+				key = key.mid(1);
+			}
+			else if (!n.itemCount && !here.isEmpty())
+				// not a node.
+				return false;
+
+			if (next.isNull() || next.isEmpty())
+				// nowhere further to go; what's here is all there is, and the proof should hold no more.
+				return used == _proof.size() && found.toBytes() == _value.toBytes();
+			if (next.isList())
+			{
+				here = next;
+				byHash = false;
+			}
+			else if (next.isData() && next.payload().size() == 32)
+			{
+				want = next.toHash<h256>();
+				byHash = true;
+			}
+			else
+				// a reference that's neither a node nor a hash.
+				return false;
+		}
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
 }
@@ -27,7 +27,9 @@
 #include "MemoryDB.h"
 #include "OverlayDB.h"
 #include "Log.h"
+#include "ThreadPool.h"
 #include "TrieCommon.h"
+#include "TrieNodeCache.h"
 namespace ldb = leveldb;
 
 namespace eth
@@ -39,6 +41,58 @@ struct TrieDBChannel: public LogChannel  { static const char* name() { return "-
 class InvalidTrie: public std::exception {};
 extern const h256 c_shaNull;
 
+/// The nodes on the path from a trie's root towards a key, each as stored; those inline in another come within it.
+using TrieProof = std::vector<bytes>;
+
+/// @returns true if @a _proof shows that the trie with root @a _root has @a _value at @a _key or, if @a _value is
+/// empty, that it has nothing there. No DB is needed; the proof's nodes are checked against the root by hash.
+bool verifyTrieProof(h256 const& _root, bytesConstRef _key, bytesConstRef _value, TrieProof const& _proof);
+
+static const unsigned c_minParallelTrieBatch = 64;	///< The fewest changes beneath a branch worth splitting between threads.
+
+/// A key, in nibbles, and the value it's to have, or none to remove it.
+struct TrieBatchItem
+{
+	NibbleSlice key;
+	bytesConstRef value;
+};
+
+/**
+ * @brief Reads through to a DB, but keeps what's written to itself, in order, to be written to the DB later.
+ * A thread can then change its own part of a trie in the DB while other threads do the same with theirs, reading the
+ * DB but not writing it; once they're all done, their writes go to the DB as though they'd been made one after another.
+ */
+template <class DB>
+class DeferredDB
+{
+public:
+	DeferredDB(DB const* _db): m_db(_db) {}
+
+	std::string lookup(h256 _h) const { auto it = m_inserted.find(_h); return it != m_inserted.end() ? m_log[it->second].value : m_db->lookup(_h); }
+	bool exists(h256 _h) const { return m_inserted.count(_h) || m_db->exists(_h); }
+	void insert(h256 _h, bytesConstRef _v) { m_inserted.insert(std::make_pair(_h, m_log.size())); m_log.push_back(Write{_h, _v.toString()}); }
+	void kill(h256 _h) { m_log.push_back(Write{_h, std::string()}); }
+	TrieNodeCache* nodeCache() const { return m_db->nodeCache(); }
+
+	/// Make the writes kept in @a _db.
+	void writeTo(DB& _db) const { for (auto const& i: m_log) if (i.value.empty()) _db.kill(i.hash); else _db.insert(i.hash, bytesConstRef((byte const*)i.value.data(), i.value.size())); }
+
+private:
+	/// An insert, or, with no value, a kill.
+	struct Write
+	{
+		h256 hash;
+		std::string value;
+	};
+
+	DB const* m_db;
+	std::vector<Write> m_log;
+	FlatHashMap<h256, size_t> m_inserted;		///< Where in m_log each node inserted is.
+};
+
+template <class DB> struct IsDeferredDB: std::false_type {};
+template <class DB> struct IsDeferredDB<DeferredDB<DB>>: std::true_type {};
+
 /**
  * @brief Merkle Patricia Tree "Trie": a modifed base-16 Radix tree.
  * This version uses an LDB backend
@@ -150,9 +204,22 @@ public:
 	}
 
 	std::string at(bytesConstRef _key) const;
+	/// @returns the proof of what's at @a _key (that at() gives), or that nothing is; see verifyTrieProof().
+	TrieProof prove(bytesConstRef _key) const;
 	void insert(bytesConstRef _key, bytesConstRef _value);
 	void remove(bytesConstRef _key);
 
+	/// A key and the value it's to have; an empty one removes it.
+	using Change = std::pair<bytesConstRef, bytesConstRef>;
+
+	/// Make all of @a _changes, which must be sorted by key with none twice, in one pass. Each node they change is
+	/// rewritten and hashed once, rather than once for each change beneath it as insert() and remove() would.
+	/// Given @a _pool, the changes beneath the children of the first branch that has enough of them are made on its
+	/// threads.
+	void applyBatch(std::vector<Change> const& _changes, ThreadPool* _pool = nullptr);
+
+	/// Walks the trie's entries in key order. It holds the nodes along its path as they're stored, so what it gives
+	/// refers into them, and is good till it moves on.
 	class iterator
 	{
 	public:
@@ -160,45 +227,72 @@ public:
 
 		iterator() {}
 		iterator(GenericTrieDB const* _db);
+		iterator(GenericTrieDB const* _db, bytesConstRef _key): m_that(_db) { seek(_key); }
 
 		iterator& operator++() { next(); return *this; }
 
 		value_type operator*() const { return at(); }
 		value_type operator->() const { return at(); }
 
-		bool operator==(iterator const& _c) const { return _c.m_trail == m_trail; }
-		bool operator!=(iterator const& _c) const { return _c.m_trail != m_trail; }
+		// An entry's key says where it is, so that's all that need be compared.
+		bool operator==(iterator const& _c) const { return m_trail.empty() ? _c.m_trail.empty() : !_c.m_trail.empty() && m_key == _c.m_key; }
+		bool operator!=(iterator const& _c) const { return !operator==(_c); }
 
 		value_type at() const;
 
+		/// Move to the first entry whose key is no less than @a _key, or to the end if there's none.
+		void seek(bytesConstRef _key);
+
 	private:
 		void next();
 
 		struct Node
 		{
-			std::string rlp;
-			std::string key;		// as hexPrefixEncoding.
+			std::shared_ptr<CachedTrieNode const> held;	///< The node as stored, unless it's inline in one above.
+			TrieNode node;			///< Refers into held, or into the node above it is inline in.
+			unsigned keySize;		///< The nibbles of m_key that lead to it.
 			byte child;				// 255 -> entering
 
 			void setFirstChild() { child = 16; }
 			void incrementChild() { child = child == 16 ? 0 : child == 15 ? 17 : (child + 1); }
-
-			bool operator==(Node const& _c) const { return rlp == _c.rlp && key == _c.key && child == _c.child; }
-			bool operator!=(Node const& _c) const { return !operator==(_c); }
 		};
 
+		/// Make @a _n the node referred to by @a _ref (a hash or a node inline), or that of hash @a _h.
+		/// @returns false if it's the empty node.
+		bool resolve(Node& _n, RLP const& _ref) const;
+		bool resolve(Node& _n, h256 const& _h) const;
+		/// Enter the node referred to by @a _ref beneath the last, unless it's the empty node. @returns true if it did.
+		bool enter(RLP const& _ref);
+		/// We're at an entry, so make its key from the nibbles leading to it.
+		void settle();
+
 		std::vector<Node> m_trail;
-		GenericTrieDB<DB> const* m_that;
+		bytes m_key;				///< The nibbles leading to the last node; as the trail, reused as it's walked.
+		bytes m_keyBytes;			///< The key of the entry we're at.
+		GenericTrieDB<DB> const* m_that = nullptr;
+	};
+
+	/// A run of entries, from the first of them to the first after them, to iterate over.
+	struct Range
+	{
+		iterator first;
+		iterator second;
+
+		iterator begin() const { return first; }
+		iterator end() const { return second; }
 	};
 
 	iterator begin() const { return this; }
 	iterator end() const { return iterator(); }
 
+	/// @returns the first entry whose key is no less than @a _key, or end() if there's none.
+	iterator lower_bound(bytesConstRef _key) const { return iterator(this, _key); }
+	/// @returns the entries whose keys are no less than @a _from but less than @a _to.
+	Range range(bytesConstRef _from, bytesConstRef _to) const { return Range{lower_bound(_from), lower_bound(_to)}; }
+
 private:
 	RLPStream& streamNode(RLPStream& _s, bytes const& _b);
 
-	std::string atAux(RLP const& _here, NibbleSlice _key) const;
-
 	void mergeAtAux(RLPStream& _out, RLP const& _replace, NibbleSlice _key, bytesConstRef _value);
 	bytes mergeAt(RLP const& _replace, NibbleSlice _k, bytesConstRef _v, bool _inLine = false);
 
@@ -242,10 +336,40 @@ private:
 	// out: [null ** i, H, null ** (16 - i)] ; [K, V] => H (INS)  (being [null ** i, [K, V], null ** (16 - i)]  if necessary)
 	bytes branch(RLP const& _orig);
 
+	template <class> friend class GenericTrieDB;
+
+	using BatchItem = TrieBatchItem;
+	using BatchItems = std::vector<BatchItem>;
+	using BatchIt = BatchItems::const_iterator;
+	using BatchGroup = std::pair<BatchIt, BatchIt>;
+
+	// Each of these makes the changes [_b, _e), whose keys are _o nibbles in by now, at or beneath a node: that
+	// referred to by _ref (a hash or a node inline), the node _n, the branch with the items _slots, the extension or
+	// leaf [_k, _v], or no node at all. @returns the node that results, not yet hashed, or nothing if none does.
+	bytes batchAtRef(RLP const& _ref, BatchIt _b, BatchIt _e, uint _o);
+	bytes batchAt(RLP const& _n, BatchIt _b, BatchIt _e, uint _o);
+	bytes batchBranch(RLP const* _slots, BatchIt _b, BatchIt _e, uint _o);
+	bytes batchPair(NibbleSlice _k, RLP const& _v, bool _leaf, BatchIt _b, BatchIt _e, uint _o);
+
+	/// Make the changes in @a _groups beneath the children @a _todo of the branch @a _slots, giving @a _fresh; on threads,
+	/// if the batch may still be split and they're enough. A trie over a DeferredDB is already one thread's part, so
+	/// is never split again.
+	void batchChildren(RLP const* _slots, BatchGroup const* _groups, byte const* _todo, unsigned _count, bytes* _fresh, uint _o, std::false_type);
+	void batchChildren(RLP const* _slots, BatchGroup const* _groups, byte const* _todo, unsigned _count, bytes* _fresh, uint _o, std::true_type);
+	bytes batchBuild(BatchIt _b, BatchIt _e, uint _o);
+
+	/// @returns the node of key @a _k over that referred to by @a _child, merging their keys if it's an extension or leaf.
+	bytes batchJoin(NibbleSlice _k, RLP const& _child);
+
+	/// Stream a reference to the node @a _ref: as it is, unless it's one made in this pass, too big to be inline.
+	void streamRef(RLPStream& _s, RLP const& _ref);
+
 	bool isTwoItemNode(RLP const& _n) const;
 	std::string deref(RLP const& _n) const;
 
 	std::string node(h256 _h) const { return m_db->lookup(_h); }
+	/// @returns the node @a _h, decoded; from the DB's node cache, if it has one, and into it, if it's found.
+	std::shared_ptr<CachedTrieNode const> cachedNode(h256 _h) const;
 	void insertNode(h256 _h, bytesConstRef _v) { m_db->insert(_h, _v); }
 	void killNode(h256 _h) { m_db->kill(_h); }
 
@@ -254,6 +378,7 @@ private:
 
 	h256 m_root;
 	DB* m_db = nullptr;
+	ThreadPool* m_batchPool = nullptr;	///< The threads the batch being applied may still be split between, if any.
 };
 
 template <class DB>
@@ -274,9 +399,19 @@ public:
 	std::string operator[](KeyType _k) const { return at(_k); }
 
 	std::string at(KeyType _k) const { return GenericTrieDB<DB>::at(bytesConstRef((byte const*)&_k, sizeof(KeyType))); }
+	TrieProof prove(KeyType _k) const { return GenericTrieDB<DB>::prove(bytesConstRef((byte const*)&_k, sizeof(KeyType))); }
+	static bool verify(h256 const& _root, KeyType _k, bytesConstRef _value, TrieProof const& _proof) { return verifyTrieProof(_root, bytesConstRef((byte const*)&_k, sizeof(KeyType)), _value, _proof); }
 	void insert(KeyType _k, bytesConstRef _value) { GenericTrieDB<DB>::insert(bytesConstRef((byte const*)&_k, sizeof(KeyType)), _value); }
 	void insert(KeyType _k, bytes const& _value) { insert(_k, bytesConstRef(&_value)); }
 	void remove(KeyType _k) { GenericTrieDB<DB>::remove(bytesConstRef((byte const*)&_k, sizeof(KeyType))); }
+	void applyBatch(std::vector<std::pair<KeyType, bytes>> const& _changes, ThreadPool* _pool = nullptr)
+	{
+		std::vector<typename GenericTrieDB<DB>::Change> c;
+		c.reserve(_changes.size());
+		for (auto const& i: _changes)
+			c.push_back(std::make_pair(bytesConstRef((byte const*)&i.first, sizeof(KeyType)), bytesConstRef(&i.second)));
+		GenericTrieDB<DB>::applyBatch(c, _pool);
+	}
 
 	class iterator: public GenericTrieDB<DB>::iterator
 	{
@@ -286,6 +421,7 @@ public:
 
 		iterator() {}
 		iterator(TrieDB const* _db): Super(_db) {}
+		iterator(TrieDB const* _db, KeyType _k): Super(_db, bytesConstRef((byte const*)&_k, sizeof(KeyType))) {}
 
 		value_type operator*() const { return at(); }
 		value_type operator->() const { return at(); }
@@ -295,6 +431,18 @@ public:
 
 	iterator begin() const { return this; }
 	iterator end() const { return iterator(); }
+
+	struct Range
+	{
+		iterator first;
+		iterator second;
+
+		iterator begin() const { return first; }
+		iterator end() const { return second; }
+	};
+
+	iterator lower_bound(KeyType _k) const { return iterator(this, _k); }
+	Range range(KeyType _from, KeyType _to) const { return Range{lower_bound(_from), lower_bound(_to)}; }
 };
 
 template <class KeyType, class DB>
@@ -314,22 +462,58 @@ namespace eth
 template <class DB> GenericTrieDB<DB>::iterator::iterator(GenericTrieDB const* _db)
 {
 	m_that = _db;
-	m_trail.push_back({_db->node(_db->m_root), std::string(1, '\0'), 255});	// one null byte is the HPE for the empty key.
-	next();
+	m_trail.push_back(Node{nullptr, TrieNode(), 0, 255});
+	if (resolve(m_trail.back(), _db->m_root))
+		next();
+	else
+		m_trail.clear();
+}
+
+template <class DB> bool GenericTrieDB<DB>::iterator::resolve(Node& _n, RLP const& _ref) const
+{
+	if (_ref.isEmpty())
+		return false;
+	if (!_ref.isList())
+		return resolve(_n, _ref.toHash<h256>());
+	// Inline, so it refers into whatever _n holds, or a node above does; _ref may be in _n, so decode it first.
+	TrieNode n(_ref);
+	_n.node = n;
+	return true;
+}
+
+template <class DB> bool GenericTrieDB<DB>::iterator::resolve(Node& _n, h256 const& _h) const
+{
+	_n.held = m_that->cachedNode(_h);
+	if (RLP(_n.held->rlp).isEmpty())
+		return false;
+	_n.node = _n.held->node;
+	return true;
+}
+
+template <class DB> bool GenericTrieDB<DB>::iterator::enter(RLP const& _ref)
+{
+	// Pushing may move the trail, so copy the reference out of it first.
+	RLP ref = _ref;
+	m_trail.push_back(Node{nullptr, TrieNode(), (unsigned)m_key.size(), 255});
+	if (resolve(m_trail.back(), ref))
+		return true;
+	m_trail.pop_back();
+	return false;
+}
+
+template <class DB> void GenericTrieDB<DB>::iterator::settle()
+{
+	assert(!(m_key.size() & 1));	// should be an integer number of bytes (i.e. not an odd number of nibbles).
+	m_keyBytes.resize(m_key.size() / 2);
+	for (unsigned i = 0; i < m_keyBytes.size(); ++i)
+		m_keyBytes[i] = (m_key[i * 2] << 4) | m_key[i * 2 + 1];
 }
 
 template <class DB> typename GenericTrieDB<DB>::iterator::value_type GenericTrieDB<DB>::iterator::at() const
 {
 	assert(m_trail.size());
-	Node const& b = m_trail.back();
-	assert(b.key.size());
-	assert(!(b.key[0] & 0x10));	// should be an integer number of bytes (i.e. not an odd number of nibbles).
-
-	RLP rlp(b.rlp);
-	if (rlp.itemCount() == 2)
-		return std::make_pair(bytesConstRef(b.key).cropped(1), rlp[1].payload());
-	else
-		return std::make_pair(bytesConstRef(b.key).cropped(1), rlp[16].payload());
+	TrieNode const& n = m_trail.back().node;
+	return std::make_pair(bytesConstRef(&m_keyBytes), n.items[n.itemCount == 2 ? 1 : 16].payload());
 }
 
 template <class DB> void GenericTrieDB<DB>::iterator::next()
@@ -337,100 +521,154 @@ template <class DB> void GenericTrieDB<DB>::iterator::next()
 	while (true)
 	{
 		if (m_trail.empty())
-		{
-			m_that = nullptr;
 			return;
-		}
 
-		Node const& b = m_trail.back();
-		RLP rlp(b.rlp);
+		Node& b = m_trail.back();
+		m_key.resize(b.keySize);
 
-		if (m_trail.back().child == 255)
+		if (b.child == 255)
 		{
 			// Entering. Look for first...
-			if (rlp.isEmpty())
-			{
-				m_trail.pop_back();
-				continue;
-			}
-			if (!(rlp.isList() && (rlp.itemCount() == 2 || rlp.itemCount() == 17)))
+			if (!b.node.itemCount)
 			{
 #if ETH_PARANOIA
 				cwarn << "BIG FAT ERROR. STATE TRIE CORRUPTED!!!!!";
-				cwarn << b.rlp.size() << toHex(b.rlp);
-				cwarn << rlp;
-				auto c = rlp.itemCount();
-				cwarn << c;
+				if (b.held)
+					cwarn << b.held->rlp.size() << toHex(b.held->rlp);
 				throw InvalidTrie();
 #else
-				m_that = nullptr;
+				m_trail.clear();
 				return;
 #endif
 			}
-			if (rlp.itemCount() == 2)
+			if (b.node.itemCount == 2)
 			{
 				// Just turn it into a valid Branch
-				m_trail.back().key = hexPrefixEncode(keyOf(m_trail.back().key), keyOf(rlp), false);
-				if (isLeaf(rlp))
+				for (unsigned i = 0; i < b.node.key.size(); ++i)
+					m_key.push_back(b.node.key[i]);
+				b.keySize = m_key.size();
+				if (b.node.isLeaf)
 				{
 					// leaf - exit now.
-					m_trail.back().child = 0;
+					b.child = 0;
+					settle();
 					return;
 				}
 
 				// enter child.
-				m_trail.back().rlp = m_that->deref(rlp[1]);
+				if (!resolve(b, b.node.items[1]))
+					m_trail.pop_back();
 				// no need to set .child as 255 - it's already done.
 				continue;
 			}
 			else
 			{
 				// Already a branch - look for first valid.
-				m_trail.back().setFirstChild();
+				b.setFirstChild();
 				// run through to...
 			}
 		}
 		else
 		{
 			// Continuing/exiting. Look for next...
-			if (!(rlp.isList() && rlp.itemCount() == 17))
+			if (b.node.itemCount != 17)
 			{
 				m_trail.pop_back();
 				continue;
 			}
 			// else run through to...
-			m_trail.back().incrementChild();
+			b.incrementChild();
 		}
 
-		// ...here. should only get here if we're a list.
-		assert(rlp.isList() && rlp.itemCount() == 17);
+		// ...here. should only get here if we're a branch.
+		assert(b.node.itemCount == 17);
+		// entering a child may move the trail, so don't hold on to b.
 		for (;; m_trail.back().incrementChild())
-			if (m_trail.back().child == 17)
+		{
+			Node& back = m_trail.back();
+			if (back.child == 17)
 			{
 				// finished here.
 				m_trail.pop_back();
 				break;
 			}
-			else if (!rlp[m_trail.back().child].isEmpty())
+			else if (!back.node.items[back.child].isEmpty())
 			{
-				if (m_trail.back().child == 16)
-					return;	// have a value at this node - exit now.
-				else
+				if (back.child == 16)
 				{
-					// lead-on to another node - enter child.
-					// fixed so that Node passed into push_back is constructed *before* m_trail is potentially resized (which invalidates back and rlp)
-					Node const& back = m_trail.back();
-					m_trail.push_back(Node{
-						m_that->deref(rlp[back.child]),
-						 hexPrefixEncode(keyOf(back.key), NibbleSlice(bytesConstRef(&back.child, 1), 1), false),
-						 255
-						});
-					break;
+					// have a value at this node - exit now.
+					settle();
+					return;
 				}
+				// lead-on to another node - enter child.
+				m_key.push_back(back.child);
+				if (enter(back.node.items[back.child]))
+					break;
+				m_key.pop_back();
 			}
+		}
 	}
 }
 
+template <class DB> void GenericTrieDB<DB>::iterator::seek(bytesConstRef _key)
+{
+	// Walk down towards the key. The first entry at or after it is then either the first beneath where we stop, if
+	// all beneath there comes after the key, or else the next after all that's beneath there.
+	m_trail.clear();
+	m_key.clear();
+	m_trail.push_back(Node{nullptr, TrieNode(), 0, 255});
+	if (!resolve(m_trail.back(), m_that->m_root))
+	{
+		m_trail.clear();
+		return;
+	}
+
+	NibbleSlice key(_key);
+	while (true)
+	{
+		Node& b = m_trail.back();
+		NibbleSlice rest = key.mid(b.keySize);
+		if (b.node.itemCount == 2)
+		{
+			NibbleSlice k = b.node.key;
+			if (!rest.contains(k) || b.node.isLeaf)
+			{
+				// If it comes before the key, so does all beneath it, so move on past it; else start with it.
+				if (k < rest)
+					b.child = 0;
+				break;
+			}
+			// The key goes on beneath; follow it.
+			for (unsigned i = 0; i < k.size(); ++i)
+				m_key.push_back(k[i]);
+			b.keySize = m_key.size();
+			if (!resolve(b, b.node.items[1]))
+			{
+				b.child = 0;
+				break;
+			}
+		}
+		else if (b.node.itemCount == 17)
+		{
+			if (!rest.size())
+				// Here, so everything beneath comes after it.
+				break;
+			// Follow it to the child; if there's none there, move on to the next after it.
+			b.child = rest[0];
+			m_key.push_back(b.child);
+			if (!enter(b.node.items[b.child]))
+			{
+				m_key.pop_back();
+				break;
+			}
+		}
+		else
+			// Corrupt; let next() deal with it.
+			break;
+	}
+	next();
+}
+
 template <class KeyType, class DB> typename TrieDB<KeyType, DB>::iterator::value_type TrieDB<KeyType, DB>::iterator::at() const
 {
 	auto p = Super::at();
@@ -466,39 +704,107 @@ template <class DB> void GenericTrieDB<DB>::insert(bytesConstRef _key, bytesCons
 	m_root = insertNode(&b);
 }
 
-template <class DB> std::string GenericTrieDB<DB>::at(bytesConstRef _key) const
+template <class DB> std::shared_ptr<CachedTrieNode const> GenericTrieDB<DB>::cachedNode(h256 _h) const
 {
-	return atAux(RLP(node(m_root)), _key);
+	TrieNodeCache* c = m_db->nodeCache();
+	if (!c)
+		return std::make_shared<CachedTrieNode const>(node(_h));
+	if (auto ret = c->find(_h))
+		return ret;
+	std::string s = node(_h);
+	if (s.empty())
+		return std::make_shared<CachedTrieNode const>(std::move(s));
+	return c->insert(_h, std::move(s));
 }
 
-template <class DB> std::string GenericTrieDB<DB>::atAux(RLP const& _here, NibbleSlice _key) const
+template <class DB> std::string GenericTrieDB<DB>::at(bytesConstRef _key) const
 {
-	if (_here.isEmpty() || _here.isNull())
-		// not found.
-		return std::string();
-	assert(_here.isList() && (_here.itemCount() == 2 || _here.itemCount() == 17));
-	if (_here.itemCount() == 2)
+	// Walk down from the root. A node inline in its parent refers into the RLP of the one last looked up, so hold on
+	// to that.
+	std::shared_ptr<CachedTrieNode const> held = cachedNode(m_root);
+	TrieNode const* here = &held->node;
+	TrieNode inLine;
+	NibbleSlice key(_key);
+	while (true)
 	{
-		auto k = keyOf(_here);
-		if (_key == k && isLeaf(_here))
-			// reached leaf and it's us
-			return _here[1].toString();
-		else if (_key.contains(k) && !isLeaf(_here))
+		RLP next;
+		if (here->itemCount == 2)
+		{
+			if (here->isLeaf)
+				// reached leaf; it's us or no-one.
+				return key == here->key ? here->items[1].toString() : std::string();
+			if (!key.contains(here->key))
+				// not us.
+				return std::string();
 			// not yet at leaf and it might yet be us. onwards...
-			return atAux(_here[1].isList() ? _here[1] : RLP(node(_here[1].toHash<h256>())), _key.mid(k.size()));
+			next = here->items[1];
+			key = key.mid(here->key.size());
+		}
+		else if (here->itemCount == 17)
+		{
+			if (key.size() == 0)
+				return here->items[16].toString();
+			next = here->items[key[0]];
+			key = key.mid(1);
+		}
 		else
-			// not us.
+			// not found.
+			return std::string();
+
+		if (next.isEmpty())
 			return std::string();
+		if (next.isList())
+		{
+			inLine = TrieNode(next);
+			here = &inLine;
+		}
+		else
+		{
+			held = cachedNode(next.toHash<h256>());
+			here = &held->node;
+		}
 	}
-	else
+}
+
+template <class DB> TrieProof GenericTrieDB<DB>::prove(bytesConstRef _key) const
+{
+	// Walk down as at() does, keeping each node referred to by hash; those inline come within them.
+	TrieProof ret;
+	std::shared_ptr<CachedTrieNode const> held = cachedNode(m_root);
+	ret.push_back(asBytes(held->rlp));
+	TrieNode const* here = &held->node;
+	TrieNode inLine;
+	NibbleSlice key(_key);
+	while (true)
 	{
-		if (_key.size() == 0)
-			return _here[16].toString();
-		auto n = _here[_key[0]];
-		if (n.isEmpty())
-			return std::string();
+		RLP next;
+		if (here->itemCount == 2 && !here->isLeaf && key.contains(here->key))
+		{
+			next = here->items[1];
+			key = key.mid(here->key.size());
+		}
+		else if (here->itemCount == 17 && key.size())
+		{
+			next = here->items[key[0]];
+			key = key.mid(1);
+		}
 		else
-			return atAux(n.isList() ? n : RLP(node(n.toHash<h256>())), _key.mid(1));
+			// at the leaf, the value, or where it would be.
+			return ret;
+
+		if (next.isEmpty())
+			return ret;
+		if (next.isList())
+		{
+			inLine = TrieNode(next);
+			here = &inLine;
+		}
+		else
+		{
+			held = cachedNode(next.toHash<h256>());
+			ret.push_back(asBytes(held->rlp));
+			here = &held->node;
+		}
 	}
 }
 
@@ -578,13 +884,13 @@ template <class DB> void GenericTrieDB<DB>::mergeAtAux(RLPStream& _out, RLP cons
 #endif
 
 	RLP r = _orig;
-	std::string s;
+	std::shared_ptr<CachedTrieNode const> s;
 	// _orig is always a segment of a node's RLP - removing it alone is pointless. However, if may be a hash, in which case we deref and we know it is removable.
 	bool isRemovable = false;
 	if (!r.isList() && !r.isEmpty())
 	{
-		s = node(_orig.toHash<h256>());
-		r = RLP(s);
+		s = cachedNode(_orig.toHash<h256>());
+		r = RLP(s->rlp);
 		assert(!r.isNull());
 		isRemovable = true;
 	}
@@ -608,9 +914,269 @@ template <class DB> void GenericTrieDB<DB>::remove(bytesConstRef _key)
 	}
 }
 
+template <class DB> void GenericTrieDB<DB>::applyBatch(std::vector<Change> const& _changes, ThreadPool* _pool)
+{
+	if (_changes.empty())
+		return;
+	BatchItems items;
+	items.reserve(_changes.size());
+	for (auto const& i: _changes)
+	{
+		items.push_back(BatchItem{NibbleSlice(i.first), i.second});
+		assert(items.size() == 1 || items[items.size() - 2].key < items.back().key);
+	}
+
+	// The root is always hashed, however small.
+	std::string rv = node(m_root);
+	killNode(m_root);
+	m_batchPool = _pool;
+	bytes b = batchAt(RLP(rv), items.begin(), items.end(), 0);
+	m_batchPool = nullptr;
+	m_root = insertNode(b.empty() ? bytesConstRef(&RLPNull) : bytesConstRef(&b));
+}
+
+template <class DB> bytes GenericTrieDB<DB>::batchAtRef(RLP const& _ref, BatchIt _b, BatchIt _e, uint _o)
+{
+	if (_ref.isEmpty())
+		return batchBuild(_b, _e, _o);
+	if (_ref.isList())
+		return batchAt(_ref, _b, _e, _o);
+	h256 h = _ref.toHash<h256>();
+	auto s = cachedNode(h);
+	killNode(h);
+	return batchAt(RLP(s->rlp), _b, _e, _o);
+}
+
+template <class DB> bytes GenericTrieDB<DB>::batchAt(RLP const& _n, BatchIt _b, BatchIt _e, uint _o)
+{
+	if (!_n.isList() || _n.isEmpty())
+		return batchBuild(_b, _e, _o);
+	assert(_n.itemCount() == 2 || _n.itemCount() == 17);
+	if (_n.itemCount() == 2)
+		return batchPair(keyOf(_n), _n[1], isLeaf(_n), _b, _e, _o);
+	RLP slots[17];
+	unsigned i = 0;
+	for (auto const& s: _n)
+		slots[i++] = s;
+	return batchBranch(slots, _b, _e, _o);
+}
+
+template <class DB> bytes GenericTrieDB<DB>::batchBranch(RLP const* _slots, BatchIt _b, BatchIt _e, uint _o)
+{
+	// Make the changes beneath each child, and to the value.
+	bytes fresh[16];
+	bool changed[17] = {};
+	bytesConstRef value;
+	auto it = _b;
+	if (it != _e && it->key.size() == _o)
+	{
+		changed[16] = true;
+		value = it->value;
+		++it;
+	}
+	BatchGroup groups[16];
+	while (it != _e)
+	{
+		byte n = it->key[_o];
+		auto end = it;
+		for (; end != _e && end->key[_o] == n; ++end) {}
+		groups[n] = std::make_pair(it, end);
+		changed[n] = true;
+		it = end;
+	}
+
+	byte todo[16];
+	unsigned todoCount = 0;
+	for (byte i = 0; i < 16; ++i)
+		if (changed[i])
+			todo[todoCount++] = i;
+	batchChildren(_slots, groups, todo, todoCount, fresh, _o, std::integral_constant<bool, !IsDeferredDB<DB>::value>());
+
+	byte only = 255;
+	unsigned children = 0;
+	for (byte i = 0; i < 16; ++i)
+		if (changed[i] ? !fresh[i].empty() : !_slots[i].isEmpty())
+		{
+			only = i;
+			++children;
+		}
+	bool hasValue = changed[16] ? !value.empty() : !_slots[16].isEmpty();
+
+	// With less than two things in it, it's no longer a branch.
+	if (!children && !hasValue)
+		return bytes();
+	if (!children)
+		return (RLPStream(2) << hexPrefixEncode(bytes(), true) << (changed[16] ? value : _slots[16].payload())).out();
+	if (children == 1 && !hasValue)
+		return batchJoin(NibbleSlice(bytesConstRef(&only, 1), 1), changed[only] ? RLP(fresh[only]) : _slots[only]);
+
+	RLPStream r(17);
+	for (byte i = 0; i < 16; ++i)
+		if (!changed[i])
+			streamRef(r, _slots[i]);
+		else if (fresh[i].empty())
+			r << "";
+		else
+			streamNode(r, fresh[i]);
+	if (changed[16])
+		r << value;
+	else
+		r.append(_slots[16]);
+	return r.out();
+}
+
+template <class DB> void GenericTrieDB<DB>::batchChildren(RLP const* _slots, BatchGroup const* _groups, byte const* _todo, unsigned _count, bytes* _fresh, uint _o, std::false_type)
+{
+	for (unsigned i = 0; i < _count; ++i)
+		_fresh[_todo[i]] = batchAtRef(_slots[_todo[i]], _groups[_todo[i]].first, _groups[_todo[i]].second, _o + 1);
+}
+
+template <class DB> void GenericTrieDB<DB>::batchChildren(RLP const* _slots, BatchGroup const* _groups, byte const* _todo, unsigned _count, bytes* _fresh, uint _o, std::true_type)
+{
+	if (!m_batchPool || m_batchPool->size() < 2 || _count < 2 || unsigned(_groups[_todo[_count - 1]].second - _groups[_todo[0]].first) < c_minParallelTrieBatch)
+		return batchChildren(_slots, _groups, _todo, _count, _fresh, _o, std::false_type());
+
+	// The children's subtries are disjoint, so make the changes beneath each on a thread, keeping the writes to
+	// the DB aside till they're all done; they then go in the order they'd have been made in one after another.
+	std::vector<DeferredDB<DB>> deferred(_count, DeferredDB<DB>(m_db));
+	m_batchPool->run(_count, [&](size_t i)
+	{
+		GenericTrieDB<DeferredDB<DB>> sub(&deferred[i]);
+		byte n = _todo[i];
+		_fresh[n] = sub.batchAtRef(_slots[n], _groups[n].first, _groups[n].second, _o + 1);
+	});
+	for (auto const& d: deferred)
+		d.writeTo(*m_db);
+}
+
+template <class DB> bytes GenericTrieDB<DB>::batchPair(NibbleSlice _k, RLP const& _v, bool _leaf, BatchIt _b, BatchIt _e, uint _o)
+{
+	if (_leaf)
+	{
+		// Build afresh from the changes and the leaf, unless one of them replaces it.
+		BatchItems items;
+		items.reserve(_e - _b + 1);
+		bool placed = false;
+		for (auto it = _b; it != _e; ++it)
+		{
+			NibbleSlice k = it->key.mid(_o);
+			if (!placed && !(k < _k))
+			{
+				if (k != _k)
+					items.push_back(BatchItem{_k, _v.payload()});
+				placed = true;
+			}
+			items.push_back(BatchItem{k, it->value});
+		}
+		if (!placed)
+			items.push_back(BatchItem{_k, _v.payload()});
+		return batchBuild(items.begin(), items.end(), 0);
+	}
+
+	// An extension. Are all the changes beneath it?
+	auto under = [&](BatchIt it) { return it->key.mid(_o).contains(_k); };
+	bool all = true;
+	for (auto it = _b; it != _e && all; ++it)
+		all = under(it);
+	if (all)
+	{
+		bytes child = batchAtRef(_v, _b, _e, _o + _k.size());
+		return child.empty() ? bytes() : batchJoin(_k, RLP(child));
+	}
+
+	// No; it becomes a branch with the remainder of the extension under its first nibble.
+	RLP empty(RLPNull);
+	RLP slots[17];
+	for (auto& s: slots)
+		s = empty;
+	bytes rest;
+	if (_k.size() == 1)
+		slots[_k[0]] = _v;
+	else
+	{
+		RLPStream s(2);
+		s << hexPrefixEncode(_k.mid(1), false);
+		s.append(_v);
+		rest = s.out();
+		slots[_k[0]] = RLP(rest);
+	}
+	return batchBranch(slots, _b, _e, _o);
+}
+
+template <class DB> bytes GenericTrieDB<DB>::batchBuild(BatchIt _b, BatchIt _e, uint _o)
+{
+	// Those removing keys have nothing to remove.
+	auto first = _b;
+	for (; first != _e && first->value.empty(); ++first) {}
+	if (first == _e)
+		return bytes();
+	auto last = _e - 1;
+	for (; last->value.empty(); --last) {}
+	if (first == last)
+		return (RLPStream(2) << hexPrefixEncode(first->key.mid(_o), true) << first->value).out();
+
+	// Any nibbles that all the keys share go into an extension.
+	uint shared = first->key.mid(_o).shared(last->key.mid(_o));
+	if (shared)
+	{
+		RLPStream r(2);
+		r << hexPrefixEncode(first->key.mid(_o), false, 0, (int)shared);
+		streamNode(r, batchBuild(first, last + 1, _o + shared));
+		return r.out();
+	}
+
+	RLPStream r(17);
+	auto it = first;
+	bytesConstRef value;
+	if (it->key.size() == _o)
+		value = (it++)->value;
+	for (byte i = 0; i < 16; ++i)
+	{
+		auto end = it;
+		for (; end != last + 1 && end->key[_o] == i; ++end) {}
+		bytes child = batchBuild(it, end, _o + 1);
+		if (child.empty())
+			r << "";
+		else
+			streamNode(r, child);
+		it = end;
+	}
+	r << value;
+	return r.out();
+}
+
+template <class DB> bytes GenericTrieDB<DB>::batchJoin(NibbleSlice _k, RLP const& _child)
+{
+	std::shared_ptr<CachedTrieNode const> s;
+	RLP n = _child;
+	if (!_child.isList())
+	{
+		s = cachedNode(_child.toHash<h256>());
+		n = RLP(s->rlp);
+	}
+	if (n.itemCount() == 2)
+	{
+		if (!_child.isList())
+			killNode(_child.toHash<h256>());
+		return (RLPStream(2) << hexPrefixEncode(_k, keyOf(n), isLeaf(n)) << n[1]).out();
+	}
+	RLPStream r(2);
+	r << hexPrefixEncode(_k, false);
+	streamRef(r, _child);
+	return r.out();
+}
+
+template <class DB> void GenericTrieDB<DB>::streamRef(RLPStream& _s, RLP const& _ref)
+{
+	if (_ref.isList() && _ref.data().size() >= 32)
+		_s.append(insertNode(_ref.data()));
+	else
+		_s.append(_ref);
+}
+
 template <class DB> bool GenericTrieDB<DB>::isTwoItemNode(RLP const& _n) const
 {
-	return (_n.isData() && RLP(node(_n.toHash<h256>())).itemCount() == 2)
+	return (_n.isData() && cachedNode(_n.toHash<h256>())->node.itemCount == 2)
 			|| (_n.isList() && _n.itemCount() == 2);
 }
 
@@ -723,7 +1289,10 @@ template <class DB> bool GenericTrieDB<DB>::deleteAtAux(RLPStream& _out, RLP con
 	tdebug << "deleteAtAux " << _orig << _k << sha3(_orig.data()).abridged() << ((_orig.isData() && _orig.size() <= 32) ? _orig.toHash<h256>().abridged() : std::string());
 #endif
 
-	bytes b = _orig.isEmpty() ? bytes() : deleteAt(_orig.isList() ? _orig : RLP(node(_orig.toHash<h256>())), _k);
+	std::shared_ptr<CachedTrieNode const> s;
+	if (!_orig.isEmpty() && !_orig.isList())
+		s = cachedNode(_orig.toHash<h256>());
+	bytes b = _orig.isEmpty() ? bytes() : deleteAt(_orig.isList() ? _orig : RLP(s->rlp), _k);
 
 	if (!b.size())	// not found - no change.
 		return false;
@@ -818,7 +1387,7 @@ template <class DB> bytes GenericTrieDB<DB>::graft(RLP const& _orig)
 #endif
 
 	assert(_orig.isList() && _orig.itemCount() == 2);
-	std::string s;
+	std::shared_ptr<CachedTrieNode const> s;
 	RLP n;
 	if (_orig[1].isList())
 		n = _orig[1];
@@ -826,9 +1395,9 @@ template <class DB> bytes GenericTrieDB<DB>::graft(RLP const& _orig)
 	{
 		// remove second item from the trie after derefrencing it into s & n.
 		auto lh = _orig[1].toHash<h256>();
-		s = node(lh);
+		s = cachedNode(lh);
 		killNode(lh);
-		n = RLP(s);
+		n = RLP(s->rlp);
 	}
 	assert(n.itemCount() == 2);
 
@@ -0,0 +1,121 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieNodeCache.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "TrieNodeCache.h"
+using namespace std;
+using namespace eth;
+
+TrieNode::TrieNode(RLP const& _rlp)
+{
+	if (!_rlp.isList())
+		return;
+	for (auto i: _rlp)
+	{
+		if (itemCount == 17)
+		{
+			// Not a node.
+			itemCount = 0;
+			return;
+		}
+		items[itemCount++] = i;
+	}
+	if (itemCount != 2 && itemCount != 17)
+		itemCount = 0;
+	else if (itemCount == 2)
+	{
+		key = keyOf(items[0].payload());
+		isLeaf = items[0].payload().size() && (items[0].payload()[0] & 0x20);
+	}
+}
+
+TrieNodeCache::TrieNodeCache(size_t _capacity):
+	m_shardCapacity(max<size_t>(_capacity / c_trieNodeCacheShards, 1))
+{
+}
+
+shared_ptr<CachedTrieNode const> TrieNodeCache::find(h256 const& _h)
+{
+	Shard& s = shardOf(_h);
+	lock_guard<mutex> l(s.lock);
+	auto it = s.index.find(_h);
+	if (it == s.index.end())
+	{
+		++s.misses;
+		return nullptr;
+	}
+	++s.hits;
+	s.lru.splice(s.lru.begin(), s.lru, it->second);
+	return it->second->second;
+}
+
+shared_ptr<CachedTrieNode const> TrieNodeCache::insert(h256 const& _h, string&& _rlp)
+{
+	// Decode it before taking the lock.
+	auto n = make_shared<CachedTrieNode const>(move(_rlp));
+
+	Shard& s = shardOf(_h);
+	lock_guard<mutex> l(s.lock);
+	auto it = s.index.find(_h);
+	if (it != s.index.end())
+		// Another thread beat us to it.
+		return it->second->second;
+	s.lru.push_front(make_pair(_h, n));
+	s.index.insert(make_pair(_h, s.lru.begin()));
+	while (s.lru.size() > m_shardCapacity)
+	{
+		s.index.erase(s.lru.back().first);
+		s.lru.pop_back();
+	}
+	return n;
+}
+
+size_t TrieNodeCache::size() const
+{
+	size_t ret = 0;
+	for (auto const& s: m_shards)
+	{
+		lock_guard<mutex> l(s.lock);
+		ret += s.index.size();
+	}
+	return ret;
+}
+
+unsigned TrieNodeCache::hits() const
+{
+	unsigned ret = 0;
+	for (auto const& s: m_shards)
+	{
+		lock_guard<mutex> l(s.lock);
+		ret += s.hits;
+	}
+	return ret;
+}
+
+unsigned TrieNodeCache::misses() const
+{
+	unsigned ret = 0;
+	for (auto const& s: m_shards)
+	{
+		lock_guard<mutex> l(s.lock);
+		ret += s.misses;
+	}
+	return ret;
+}
@@ -0,0 +1,107 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file TrieNodeCache.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include "Common.h"
+#include "FixedHash.h"
+#include "FlatHashMap.h"
+#include "RLP.h"
+#include "TrieCommon.h"
+
+namespace eth
+{
+
+static const size_t c_trieNodeCacheSize = 32768;	///< Nodes a TrieNodeCache holds, at most, by default.
+static const unsigned c_trieNodeCacheShards = 16;	///< Parts it's split into, each with its own lock.
+
+/**
+ * @brief The items of a trie node's RLP, found once.
+ * They refer into the RLP, which must outlive them.
+ */
+struct TrieNode
+{
+	TrieNode() {}
+	explicit TrieNode(RLP const& _rlp);
+
+	unsigned itemCount = 0;		///< 17 for a branch, 2 for an extension or leaf, 0 for the empty node (or not a node).
+	RLP items[17];				///< A branch's children and value, or an extension's or leaf's key and child or value.
+	NibbleSlice key;			///< An extension's or leaf's key, as nibbles.
+	bool isLeaf = false;
+};
+
+/**
+ * @brief A trie node as a TrieNodeCache holds it: its RLP and, found in it, its items.
+ * Shared between threads, so don't call anything on the items that caches within them (e.g. operator[]); copy them
+ * first.
+ */
+struct CachedTrieNode
+{
+	explicit CachedTrieNode(std::string&& _rlp): rlp(std::move(_rlp)), node(RLP(rlp)) {}
+	CachedTrieNode(CachedTrieNode const&) = delete;
+	CachedTrieNode& operator=(CachedTrieNode const&) = delete;
+
+	std::string rlp;
+	TrieNode node;
+};
+
+/**
+ * @brief The trie nodes most recently looked up, decoded, keyed by hash.
+ * Since a node's hash is that of its RLP, one cached stays right whatever happens to the DB; those gone from it are
+ * simply never asked for again, and, being least recently used, soon go. It's safe to use from several threads.
+ */
+class TrieNodeCache
+{
+public:
+	explicit TrieNodeCache(size_t _capacity = c_trieNodeCacheSize);
+
+	/// @returns the node @a _h, or nullptr if it's not cached.
+	std::shared_ptr<CachedTrieNode const> find(h256 const& _h);
+
+	/// Cache the node @a _h, whose RLP is @a _rlp, making room for it if need be.
+	/// @returns the node, decoded.
+	std::shared_ptr<CachedTrieNode const> insert(h256 const& _h, std::string&& _rlp);
+
+	/// @returns the number of nodes cached and the lookups that found them there or didn't.
+	size_t size() const;
+	unsigned hits() const;
+	unsigned misses() const;
+
+private:
+	struct Shard
+	{
+		mutable std::mutex lock;
+		std::list<std::pair<h256, std::shared_ptr<CachedTrieNode const>>> lru;	///< Most recently used first.
+		FlatHashMap<h256, decltype(lru)::iterator> index;
+		unsigned hits = 0;
+		unsigned misses = 0;
+	};
+
+	Shard& shardOf(h256 const& _h) { return m_shards[_h[0] % c_trieNodeCacheShards]; }
+
+	size_t m_shardCapacity;
+	Shard m_shards[c_trieNodeCacheShards];
+};
+
+}
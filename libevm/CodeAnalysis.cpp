@@ -0,0 +1,173 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeAnalysis.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "CodeAnalysis.h"
+
+#include <mutex>
+#include "FeeStructure.h"
+using namespace std;
+using namespace eth;
+
+static const unsigned c_maxCachedCodes = 1024;
+
+static std::map<h256, std::shared_ptr<CodeAnalysis const>> s_cache;
+static std::mutex s_cacheLock;
+
+static word256 staticGas(Instruction _inst)
+{
+	switch (_inst)
+	{
+	case Instruction::STOP:
+	case Instruction::SUICIDE:
+	case Instruction::SSTORE:	// Entirely dependent on the storage being altered.
+		return 0;
+	case Instruction::SLOAD:
+		return word256(c_sloadGas);
+	case Instruction::SHA3:
+		return word256(c_sha3Gas);
+	case Instruction::BALANCE:
+		return word256(c_balanceGas);
+	case Instruction::CALL:
+		return word256(c_callGas);
+	case Instruction::CREATE:
+		return word256(c_createGas);
+	default:
+		return word256(c_stepGas);
+	}
+}
+
+/// @returns true if the whole fee of @a _inst is known before running it.
+static bool hasStaticFee(Instruction _inst)
+{
+	switch (_inst)
+	{
+	case Instruction::STOP:
+	case Instruction::SHA3:
+	case Instruction::CALLDATACOPY:
+	case Instruction::CODECOPY:
+	case Instruction::MLOAD:
+	case Instruction::MSTORE:
+	case Instruction::MSTORE8:
+	case Instruction::SSTORE:
+	case Instruction::GAS:
+	case Instruction::CREATE:
+	case Instruction::CALL:
+	case Instruction::RETURN:
+	case Instruction::SUICIDE:
+		return false;
+	default:
+		return c_instructionInfo.count(_inst);
+	}
+}
+
+static unsigned pushBytes(Instruction _inst)
+{
+	return _inst >= Instruction::PUSH1 && _inst <= Instruction::PUSH32 ? (unsigned)_inst - (unsigned)Instruction::PUSH1 + 1 : 0;
+}
+
+static CodeItem decodeAt(bytesConstRef _code, size_t _pc)
+{
+	CodeItem ret;
+	ret.inst = (Instruction)_code[_pc];
+	ret.pc = _pc;
+	ret.next = 0;
+	ret.gas = staticGas(ret.inst);
+	ret.blockGas = 0;
+	ret.blockStack = 0;
+	ret.jumpTarget = 0;
+	// Anything past the end of the code ROM reads as zero.
+	byte data[32] = {};
+	unsigned n = pushBytes(ret.inst);
+	for (size_t i = 0; i < n; ++i)
+		data[32 - n + i] = _pc + 1 + i < _code.size() ? _code[_pc + 1 + i] : 0;
+	ret.data = word256::fromBigEndian(data);
+	return ret;
+}
+
+CodeAnalysis::CodeAnalysis(bytesConstRef _code):
+	m_jumpTable(_code.size() + 1),
+	m_instructionStarts(_code.size(), false)
+{
+	m_items.reserve(_code.size() + 1);
+
+	// Main stream; what you get from running straight through the code.
+	for (size_t pc = 0; pc < _code.size(); pc += 1 + pushBytes(m_items.back().inst))
+	{
+		m_instructionStarts[pc] = true;
+		m_jumpTable[pc] = m_items.size();
+		m_items.push_back(decodeAt(_code, pc));
+	}
+
+	// Sentinel; a STOP that loops onto itself.
+	m_jumpTable[_code.size()] = m_items.size();
+	m_items.push_back(CodeItem{Instruction::STOP, _code.size(), m_items.size(), 0, 0, 0, 0, 0});
+
+	// Offsets within PUSH data, only reachable through a jump.
+	for (size_t pc = 0; pc < _code.size(); ++pc)
+		if (!m_instructionStarts[pc])
+		{
+			m_jumpTable[pc] = m_items.size();
+			m_items.push_back(decodeAt(_code, pc));
+		}
+
+	for (auto& i: m_items)
+		if (i.pc < _code.size())
+		{
+			i.next = itemAt(i.pc + 1 + pushBytes(i.inst));
+			if (pushBytes(i.inst))
+				i.jumpTarget = itemAt(i.data);
+		}
+
+	// Sum up the blocks backwards; what follows an item is always at a higher offset.
+	for (size_t pc = _code.size(); pc--;)
+	{
+		CodeItem& i = m_items[m_jumpTable[pc]];
+		if (hasStaticFee(i.inst))
+		{
+			InstructionInfo const& info = c_instructionInfo.at(i.inst);
+			i.blockGas = i.gas;
+			i.blockStack = info.args;
+			CodeItem const& n = m_items[i.next];
+			if (i.inst != Instruction::JUMP && i.inst != Instruction::JUMPI && n.blockGas)
+			{
+				i.blockGas += n.blockGas;
+				i.blockStack = max<int>(info.args, (int)n.blockStack + info.args - info.ret);
+			}
+		}
+	}
+}
+
+std::shared_ptr<CodeAnalysis const> CodeAnalysis::get(bytesConstRef _code, h256 _codeHash)
+{
+	if (!_codeHash)
+		return make_shared<CodeAnalysis>(_code);
+
+	lock_guard<mutex> l(s_cacheLock);
+	auto it = s_cache.find(_codeHash);
+	if (it != s_cache.end())
+		return it->second;
+
+	if (s_cache.size() >= c_maxCachedCodes)
+		s_cache.clear();
+	auto ret = make_shared<CodeAnalysis>(_code);
+	s_cache[_codeHash] = ret;
+	return ret;
+}
@@ -0,0 +1,85 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file CodeAnalysis.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <memory>
+#include <libethsupport/Common.h>
+#include <libethsupport/FixedHash.h>
+#include <libethcore/Instruction.h>
+#include "Word256.h"
+
+namespace eth
+{
+
+/**
+ * @brief A single pre-decoded instruction of some EVM code.
+ */
+struct CodeItem
+{
+	Instruction inst;	///< The instruction itself.
+	size_t pc;			///< Offset of the instruction in the code ROM.
+	size_t next;		///< Index of the item that follows this one when execution falls through.
+	word256 gas;		///< Static part of the fee; the VM adds any dynamic part (memory, SSTORE, CALL gas).
+	word256 data;		///< Immediate value for the PUSH instructions; zero otherwise.
+	word256 blockGas;	///< Summed static fees of this item and those after it to the end of its basic block; zero if
+						///< this instruction's fee isn't wholly static, in which case it ends any block before it.
+	unsigned blockStack;	///< Stack items needed to run from this item to the end of its basic block without underflow.
+	size_t jumpTarget;		///< For PUSH, the index of the item the pushed value would jump to.
+};
+
+using CodeItems = std::vector<CodeItem>;
+
+/**
+ * @brief EVM code decoded into an instruction stream, ready for the VM to run.
+ * The items are in code order, with PUSH data folded into the preceding instruction, followed by a
+ * sentinel STOP which represents everything at or past the end of the code ROM.
+ * The jump table gives the item for each offset in the code. Jumping into PUSH data is legal in this
+ * VM, so such offsets get their own item appended past the main stream.
+ * A basic block here is a run of instructions with purely static fees, ending at the first JUMP or JUMPI. GAS is
+ * left out of blocks since it must see exactly what's been spent so far.
+ */
+class CodeAnalysis
+{
+public:
+	/// Decode @a _code.
+	explicit CodeAnalysis(bytesConstRef _code);
+
+	/// @returns the analysis for @a _code, shared with other users of the same code.
+	/// If @a _codeHash is null, the code is assumed not to be worth caching (e.g. init code) and is analysed afresh.
+	static std::shared_ptr<CodeAnalysis const> get(bytesConstRef _code, h256 _codeHash = h256());
+
+	/// @returns the decoded items.
+	CodeItems const& items() const { return m_items; }
+
+	/// @returns the index into items() of the instruction at code offset @a _pc.
+	size_t itemAt(word256 const& _pc) const { return _pc.fitsIn64() && _pc.low64() < m_jumpTable.size() ? m_jumpTable[_pc.low64()] : m_jumpTable.back(); }
+
+	/// @returns true if @a _pc is the start of an instruction when decoding from the beginning of the code.
+	bool isInstructionStart(size_t _pc) const { return _pc < m_instructionStarts.size() && m_instructionStarts[_pc]; }
+
+private:
+	CodeItems m_items;
+	std::vector<size_t> m_jumpTable;		///< Code offset -> item index. One entry longer than the code, for the sentinel.
+	std::vector<bool> m_instructionStarts;	///< Code offset -> whether it starts an instruction in the main stream.
+};
+
+}
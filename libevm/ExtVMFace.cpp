@@ -24,7 +24,7 @@
 using namespace std;
 using namespace eth;
 
-ExtVMFace::ExtVMFace(Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code, BlockInfo const& _previousBlock, BlockInfo const& _currentBlock):
+ExtVMFace::ExtVMFace(Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code, BlockInfo const& _previousBlock, BlockInfo const& _currentBlock, h256 _codeHash):
 	myAddress(_myAddress),
 	caller(_caller),
 	origin(_origin),
@@ -32,6 +32,7 @@ ExtVMFace::ExtVMFace(Address _myAddress, Address _caller, Address _origin, u256
 	gasPrice(_gasPrice),
 	data(_data),
 	code(_code),
+	codeHash(_codeHash),
 	previousBlock(_previousBlock),
 	currentBlock(_currentBlock)
 {}
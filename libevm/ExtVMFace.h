@@ -28,6 +28,13 @@
 namespace eth
 {
 
+/// The engines a VM can run code with.
+enum class VMKind
+{
+	Interpreter,	///< The interpreter loop picked at build time.
+	Compiled		///< Native code, compiled per code hash by VMCompiler, falling back to the interpreter.
+};
+
 /**
  * @brief A null implementation of the class for specifying VM externalities.
  */
@@ -38,7 +45,7 @@ public:
 	ExtVMFace() {}
 
 	/// Full constructor.
-	ExtVMFace(Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code, BlockInfo const& _previousBlock, BlockInfo const& _currentBlock);
+	ExtVMFace(Address _myAddress, Address _caller, Address _origin, u256 _value, u256 _gasPrice, bytesConstRef _data, bytesConstRef _code, BlockInfo const& _previousBlock, BlockInfo const& _currentBlock, h256 _codeHash = h256());
 
 
 	/// Get the code at the given location in code ROM.
@@ -75,6 +82,7 @@ public:
 	u256 gasPrice;				///< Price of gas (that we already paid).
 	bytesConstRef data;			///< Current input data.
 	bytesConstRef code;			///< Current code that is executing.
+	h256 codeHash;				///< Hash of the code that is executing, if known; null otherwise (e.g. for init code).
 	BlockInfo previousBlock;	///< The previous block's information.
 	BlockInfo currentBlock;		///< The current block's information.
 };
@@ -34,3 +34,6 @@ u256 const eth::c_callGas = 20;
 u256 const eth::c_memoryGas = 1;
 u256 const eth::c_txDataGas = 5;
 u256 const eth::c_txGas = 500;
+
+word256 const eth::c_sstoreGasWord = word256(c_sstoreGas);
+word256 const eth::c_memoryGasWord = word256(c_memoryGas);
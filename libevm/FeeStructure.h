@@ -22,6 +22,7 @@
 #pragma once
 
 #include <libethsupport/Common.h>
+#include "Word256.h"
 
 namespace eth
 {
@@ -37,4 +38,8 @@ extern u256 const c_memoryGas;			///< Times the address of the (highest referenc
 extern u256 const c_txDataGas;			///< Per byte of data attached to a transaction. NOTE: Not payable on data of calls between transactions.
 extern u256 const c_txGas;				///< Per transaction. NOTE: Not payable on data of calls between transactions.
 
+// The fees the VM has to work out as it goes, as words for its own gas accounting.
+extern word256 const c_sstoreGasWord;	///< c_sstoreGas.
+extern word256 const c_memoryGasWord;	///< c_memoryGas.
+
 }
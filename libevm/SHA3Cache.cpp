@@ -0,0 +1,58 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SHA3Cache.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "SHA3Cache.h"
+
+#include <atomic>
+#include <boost/thread.hpp>
+using namespace std;
+using namespace eth;
+
+static boost::thread_specific_ptr<SHA3Cache> t_cache;
+static std::atomic<uint64_t> s_hits(0);
+static std::atomic<uint64_t> s_misses(0);
+
+SHA3Cache& SHA3Cache::thread()
+{
+	if (!t_cache.get())
+		t_cache.reset(new SHA3Cache);
+	return *t_cache;
+}
+
+void SHA3Cache::clear()
+{
+	s_hits += m_hits;
+	s_misses += m_misses;
+	m_hits = 0;
+	m_misses = 0;
+	for (auto& i: m_entries)
+		i.size = c_sha3CacheMaxInput + 1;
+}
+
+uint64_t SHA3Cache::totalHits()
+{
+	return s_hits;
+}
+
+uint64_t SHA3Cache::totalMisses()
+{
+	return s_misses;
+}
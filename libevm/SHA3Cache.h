@@ -0,0 +1,107 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SHA3Cache.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <libethsupport/Common.h>
+#include <libethsupport/FixedHash.h>
+
+namespace eth
+{
+
+static const unsigned c_sha3CacheEntries = 256;		///< Slots in each thread's SHA3 cache; a power of two.
+static const unsigned c_sha3CacheMaxInput = 64;		///< The largest input the SHA3 cache will remember.
+
+/**
+ * @brief Per-thread, direct-mapped cache of the SHA3 of small inputs, for the VM's SHA3 instruction.
+ * Contracts tend to hash the same one- or two-word keys over and over (working out where a mapping lives in
+ * storage). Inputs up to c_sha3CacheMaxInput bytes go into the slot picked by a cheap fingerprint of their contents;
+ * a slot only hits if its size and contents match exactly, so the result is always what sha3() would give.
+ * It's emptied at the end of each transaction, when the hits and misses are added to the totals.
+ */
+class SHA3Cache
+{
+public:
+	/// @returns the cache of the calling thread.
+	static SHA3Cache& thread();
+
+	/// @returns the SHA3 of @a _data.
+	h256 operator()(bytesConstRef _data)
+	{
+		if (_data.size() > c_sha3CacheMaxInput)
+			return sha3(_data);
+		Entry& e = m_entries[fingerprint(_data) & (c_sha3CacheEntries - 1)];
+		if (e.size == _data.size() && !memcmp(e.data, _data.data(), _data.size()))
+		{
+			++m_hits;
+			return e.hash;
+		}
+		++m_misses;
+		e.size = _data.size();
+		memcpy(e.data, _data.data(), _data.size());
+		e.hash = sha3(_data);
+		return e.hash;
+	}
+
+	/// Forget everything, adding this thread's hits and misses to the totals.
+	void clear();
+
+	/// @returns the lookups that hit and missed since the last clear().
+	uint64_t hits() const { return m_hits; }
+	uint64_t misses() const { return m_misses; }
+
+	/// @returns the lookups that hit and missed over all threads, up to each one's last clear().
+	static uint64_t totalHits();
+	static uint64_t totalMisses();
+
+private:
+	SHA3Cache() { clear(); }
+
+	struct Entry
+	{
+		unsigned size;		///< Size of the input; more than c_sha3CacheMaxInput if the slot is empty.
+		byte data[c_sha3CacheMaxInput];
+		h256 hash;
+	};
+
+	/// @returns a cheap hash of @a _data, for picking a slot.
+	static unsigned fingerprint(bytesConstRef _data)
+	{
+		uint64_t h = _data.size();
+		size_t i = 0;
+		for (uint64_t w; i + 8 <= _data.size(); i += 8)
+		{
+			memcpy(&w, _data.data() + i, 8);
+			h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+		}
+		for (; i < _data.size(); ++i)
+			h = (h ^ _data[i]) * 0x100000001b3ull;
+		return (unsigned)(h >> 32);
+	}
+
+	std::array<Entry, c_sha3CacheEntries> m_entries;
+	uint64_t m_hits = 0;
+	uint64_t m_misses = 0;
+};
+
+}
@@ -26,6 +26,41 @@ using namespace eth;
 
 void VM::reset(u256 _gas)
 {
-	m_gas = _gas;
+	m_gas = word256(_gas);
 	m_curPC = 0;
+	m_code.reset();
+}
+
+static_assert(sizeof(word256) == sizeof(NativeWord), "Compiled code must see the stack as the VM has it.");
+
+void VM::nativeReserve(NativeRun* _r, uint64_t _n)
+{
+	VM& vm = *static_cast<VM*>(_r->vm);
+	vm.m_stack.resize(max<size_t>(_r->size + _n, vm.m_stack.size() * 2));
+	_r->stack = reinterpret_cast<NativeWord*>(vm.m_stack.data());
+	_r->room = vm.m_stack.size();
+}
+
+int VM::nativeGrow(NativeRun* _r, uint64_t _fee, uint64_t _size)
+{
+	VM& vm = *static_cast<VM*>(_r->vm);
+	vm.m_gas = fromNative(_r->gas);
+	word256 runGas = word256(_fee) + c_memoryGasWord * (_size - vm.m_temp.size()) / 32;
+	if (vm.m_gas < runGas)
+		return 0;
+	vm.m_gas -= runGas;
+	vm.m_temp.resize(_size);
+	_r->memory = vm.m_temp.data();
+	_r->memorySize = vm.m_temp.size();
+	_r->gas = toNative(vm.m_gas);
+	return 1;
+}
+
+void VM::nativeDivmod(NativeWord const* _a, NativeWord const* _b, NativeWord* o_q, NativeWord* o_r)
+{
+	word256 q;
+	word256 r;
+	word256::divmod(fromNative(*_a), fromNative(*_b), q, r);
+	*o_q = toNative(q);
+	*o_r = toNative(r);
 }
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <unordered_map>
 #include <libethsupport/Exceptions.h>
 #include <libethcore/CommonEth.h>
@@ -28,6 +29,12 @@
 #include <libethcore/BlockInfo.h>
 #include "FeeStructure.h"
 #include "ExtVMFace.h"
+#include "Word256.h"
+#include "CodeAnalysis.h"
+#include "SHA3Cache.h"
+#include "VMProfiler.h"
+#include "VMTrace.h"
+#include "VMCompiler.h"
 
 namespace eth
 {
@@ -42,17 +49,18 @@ class OperandOutOfRange: public VMException { public: OperandOutOfRange(u256 _mi
 
 // Convert from a 256-bit integer stack/memory entry into a 160-bit Address hash.
 // Currently we just pull out the right (low-order in BE) 160-bits.
-inline Address asAddress(u256 _item)
+inline Address asAddress(word256 const& _item)
 {
-	return right160(h256(_item));
+	h256 ret;
+	_item.toBigEndian(ret.data());
+	return right160(ret);
 }
 
-inline u256 fromAddress(Address _a)
+inline word256 fromAddress(Address _a)
 {
-	return (u160)_a;
-//	h256 ret;
-//	memcpy(&ret, &_a, sizeof(_a));
-//	return ret;
+	h256 ret;
+	memcpy(ret.data() + 12, _a.data(), 20);
+	return word256(ret);
 }
 
 /**
@@ -65,22 +73,78 @@ public:
 
 	void reset(u256 _gas = 0);
 
+	/// Execute the code of @a _ext for at most @a _steps steps, with the engine set by setKind(); for the interpreter,
+	/// the dispatch loop picked at build time.
+	/// While the VMProfiler is enabled or a VMTracer is open, the reference loop is used instead, feeding them.
 	template <class Ext>
 	bytesConstRef go(Ext& _ext, uint64_t _steps = (uint64_t)-1);
 
-	void require(u256 _n) { if (m_stack.size() < _n) throw StackTooSmall(_n, m_stack.size()); }
+	/// As go(), but with the reference interpreter: a fee switch followed by an execution switch.
+	template <class Ext>
+	bytesConstRef goReference(Ext& _ext, uint64_t _steps = (uint64_t)-1);
+
+	/// As go(), but with direct-threaded dispatch through a label table. Needs computed goto (GCC, Clang);
+	/// elsewhere it just calls goReference().
+	/// Unless limited in steps, each basic block with the gas and stack it needs has them checked once on entry, so its
+	/// instructions skip their own stack checks, and a PUSH followed by JUMP or JUMPI is taken as one direct jump.
+	template <class Ext>
+	bytesConstRef goThreaded(Ext& _ext, uint64_t _steps = (uint64_t)-1);
+
+	/// As go(), but running the code as compiled to native code by VMCompiler. Whatever the compiled code can't run
+	/// itself it hands back to the interpreter, as it does runs limited in steps and code with no compiled form.
+	template <class Ext>
+	bytesConstRef goCompiled(Ext& _ext, uint64_t _steps = (uint64_t)-1);
+
+	/// Set the engine go() uses.
+	void setKind(VMKind _kind) { m_kind = _kind; }
+	VMKind kind() const { return m_kind; }
+
+	void require(unsigned _n) { if (m_stack.size() < _n) throw StackTooSmall(_n, m_stack.size()); }
 	void requireMem(unsigned _n) { if (m_temp.size() < _n) { m_temp.resize(_n); } }
-	u256 gas() const { return m_gas; }
+	u256 gas() const { return (u256)m_gas; }
 	u256 curPC() const { return m_curPC; }
 
 	bytes const& memory() const { return m_temp; }
-	u256s const& stack() const { return m_stack; }
+	/// @returns a copy of the stack, for debugging.
+	u256s stack() const { u256s ret; for (auto const& i: m_stack) ret.push_back((u256)i); return ret; }
 
 private:
-	u256 m_gas = 0;
-	u256 m_curPC = 0;
+	friend class VMArena;
+	friend class TracedRun;
+
+	/// Hook for runReference() that does nothing.
+	struct NoHook { void next(Instruction) {} void stepped() {} };
+
+	/// The reference loop behind goReference(). @a _hook is told as each instruction starts and once it's done.
+	template <class Ext, class Hook>
+	bytesConstRef runReference(Ext& _ext, uint64_t _steps, Hook& _hook);
+
+	/// The threaded loop behind goThreaded(); with @a _Fused, blocks are checked whole and PUSH/JUMP pairs fused.
+	template <class Ext, bool _Fused>
+	bytesConstRef runThreaded(Ext& _ext, uint64_t _steps);
+
+	/// The dispatch loop picked at build time.
+	template <class Ext>
+	bytesConstRef goInterpreter(Ext& _ext, uint64_t _steps);
+
+	// The VM's side of a NativeRun (which see). While it has a step or memory growth in hand, the gas is in m_gas.
+	template <class Ext>
+	static void nativeStep(NativeRun* _r, unsigned _inst);
+	static void nativeReserve(NativeRun* _r, uint64_t _n);
+	static int nativeGrow(NativeRun* _r, uint64_t _fee, uint64_t _size);
+	static void nativeDivmod(NativeWord const* _a, NativeWord const* _b, NativeWord* o_q, NativeWord* o_r);
+
+	static const unsigned c_nativeStackRoom = 64;	///< Stack items made room for before running compiled code.
+
+	static word256 fromNative(NativeWord const& _w) { word256 ret; std::memcpy(&ret, &_w, sizeof(ret)); return ret; }
+	static NativeWord toNative(word256 const& _w) { NativeWord ret; std::memcpy(&ret, &_w, sizeof(ret)); return ret; }
+
+	word256 m_gas = 0;
+	size_t m_curPC = 0;
 	bytes m_temp;
-	u256s m_stack;
+	word256s m_stack;
+	std::shared_ptr<CodeAnalysis const> m_code;	///< Decoded form of the code we're running; picked up on the first go().
+	VMKind m_kind = VMKind::Interpreter;
 };
 
 }
@@ -88,37 +152,64 @@ private:
 // INLINE:
 template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 {
-	u256 nextPC = m_curPC + 1;
-	for (bool stopped = false; !stopped && _steps--; m_curPC = nextPC, nextPC = m_curPC + 1)
+	if (VMProfiler::enabled())
+	{
+		ProfiledRun p(_ext.codeHash, m_gas);
+		return runReference(_ext, _steps, p);
+	}
+	if (VMTracer::active())
+	{
+		TracedRun t(*this, _ext.myAddress, _ext.codeHash);
+		return runReference(_ext, _steps, t);
+	}
+	if (m_kind == VMKind::Compiled)
+		return goCompiled(_ext, _steps);
+	return goInterpreter(_ext, _steps);
+}
+
+template <class Ext> eth::bytesConstRef eth::VM::goInterpreter(Ext& _ext, uint64_t _steps)
+{
+#if ETH_VMTHREADED
+	return goThreaded(_ext, _steps);
+#else
+	return goReference(_ext, _steps);
+#endif
+}
+
+template <class Ext> eth::bytesConstRef eth::VM::goReference(Ext& _ext, uint64_t _steps)
+{
+	NoHook h;
+	return runReference(_ext, _steps, h);
+}
+
+template <class Ext, class Hook> eth::bytesConstRef eth::VM::runReference(Ext& _ext, uint64_t _steps, Hook& _hook)
+{
+	if (!m_code)
+		m_code = CodeAnalysis::get(_ext.code, _ext.codeHash);
+	CodeItem const* items = m_code->items().data();
+
+	size_t nextItem = m_code->itemAt(m_curPC);
+	for (bool stopped = false; !stopped && _steps--; _hook.stepped(), m_curPC = items[nextItem].pc)
 	{
 		// INSTRUCTION...
-		Instruction inst = (Instruction)_ext.getCode(m_curPC);
+		CodeItem const& item = items[nextItem];
+		Instruction inst = item.inst;
+		nextItem = item.next;
+		_hook.next(inst);
 
 		// FEES...
-		bigint runGas = c_stepGas;
+		word256 runGas = item.gas;
 		unsigned newTempSize = (unsigned)m_temp.size();
 		switch (inst)
 		{
-		case Instruction::STOP:
-			runGas = 0;
-			break;
-
-		case Instruction::SUICIDE:
-			runGas = 0;
-			break;
-
 		case Instruction::SSTORE:
 			require(2);
-			if (!_ext.store(m_stack.back()) && m_stack[m_stack.size() - 2])
-				runGas = c_sstoreGas * 2;
-			else if (_ext.store(m_stack.back()) && !m_stack[m_stack.size() - 2])
+			if (!_ext.store((u256)m_stack.back()) && m_stack[m_stack.size() - 2])
+				runGas = c_sstoreGasWord * 2;
+			else if (_ext.store((u256)m_stack.back()) && !m_stack[m_stack.size() - 2])
 				runGas = 0;
 			else
-				runGas = c_sstoreGas;
-			break;
-
-		case Instruction::SLOAD:
-            runGas = c_sloadGas;
+				runGas = c_sstoreGasWord;
 			break;
 
 		// These all operate on memory and therefore potentially expand it:
@@ -140,7 +231,6 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			break;
 		case Instruction::SHA3:
 			require(2);
-			runGas = c_sha3Gas;
 			newTempSize = (unsigned)m_stack.back() + (unsigned)m_stack[m_stack.size() - 2];
 			break;
 		case Instruction::CALLDATACOPY:
@@ -152,13 +242,9 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			newTempSize = (unsigned)m_stack.back() + (unsigned)m_stack[m_stack.size() - 3];
 			break;
 
-		case Instruction::BALANCE:
-			runGas = c_balanceGas;
-			break;
-
 		case Instruction::CALL:
 			require(7);
-			runGas = c_callGas + (unsigned)m_stack[m_stack.size() - 1];
+			runGas += (unsigned)m_stack[m_stack.size() - 1];
 			newTempSize = std::max((unsigned)m_stack[m_stack.size() - 6] + (unsigned)m_stack[m_stack.size() - 7], (unsigned)m_stack[m_stack.size() - 4] + (unsigned)m_stack[m_stack.size() - 5]);
 			break;
 
@@ -168,7 +254,6 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			unsigned inOff = (unsigned)m_stack[m_stack.size() - 2];
 			unsigned inSize = (unsigned)m_stack[m_stack.size() - 3];
 			newTempSize = inOff + inSize;
-            runGas = c_createGas;
 			break;
 		}
 
@@ -178,7 +263,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 
 		newTempSize = (newTempSize + 31) / 32 * 32;
 		if (newTempSize > m_temp.size())
-			runGas += c_memoryGas * (newTempSize - m_temp.size()) / 32;
+			runGas += c_memoryGasWord * (newTempSize - m_temp.size()) / 32;
 
 		if (m_gas < runGas)
 		{
@@ -187,7 +272,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			throw OutOfGas();
 		}
 
-		m_gas = (u256)((bigint)m_gas - runGas);
+		m_gas -= runGas;
 
 		if (newTempSize > m_temp.size())
 			m_temp.resize(newTempSize);
@@ -219,7 +304,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			break;
 		case Instruction::SDIV:
 			require(2);
-            m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? s2u(u2s(m_stack.back()) / u2s(m_stack[m_stack.size() - 2])) : 0;
+            m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? sdiv(m_stack.back(), m_stack[m_stack.size() - 2]) : 0;
 			m_stack.pop_back();
 			break;
 		case Instruction::MOD:
@@ -229,7 +314,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			break;
 		case Instruction::SMOD:
 			require(2);
-            m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? s2u(u2s(m_stack.back()) % u2s(m_stack[m_stack.size() - 2])) : 0;
+            m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? smod(m_stack.back(), m_stack[m_stack.size() - 2]) : 0;
 			m_stack.pop_back();
 			break;
 		case Instruction::EXP:
@@ -238,7 +323,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			auto base = m_stack.back();
 			unsigned expon = (unsigned)m_stack[m_stack.size() - 2];
 			m_stack.pop_back();
-			m_stack.back() = boost::multiprecision::pow(base, expon);
+			m_stack.back() = pow(base, expon);
 			break;
 		}
 		case Instruction::NEG:
@@ -257,12 +342,12 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			break;
 		case Instruction::SLT:
 			require(2);
-            m_stack[m_stack.size() - 2] = u2s(m_stack.back()) < u2s(m_stack[m_stack.size() - 2]) ? 1 : 0;
+            m_stack[m_stack.size() - 2] = slt(m_stack.back(), m_stack[m_stack.size() - 2]) ? 1 : 0;
 			m_stack.pop_back();
 			break;
 		case Instruction::SGT:
 			require(2);
-            m_stack[m_stack.size() - 2] = u2s(m_stack.back()) > u2s(m_stack[m_stack.size() - 2]) ? 1 : 0;
+            m_stack[m_stack.size() - 2] = sgt(m_stack.back(), m_stack[m_stack.size() - 2]) ? 1 : 0;
 			m_stack.pop_back();
 			break;
 		case Instruction::EQ:
@@ -291,7 +376,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			break;
 		case Instruction::BYTE:
 			require(2);
-			m_stack[m_stack.size() - 2] = m_stack.back() < 32 ? (m_stack[m_stack.size() - 2] >> (uint)(8 * (31 - m_stack.back()))) & 0xff : 0;
+			m_stack[m_stack.size() - 2] = m_stack.back() < 32 ? (m_stack[m_stack.size() - 2] >> (8 * (31 - (unsigned)m_stack.back()))) & 0xff : 0;
 			m_stack.pop_back();
 			break;
 		case Instruction::SHA3:
@@ -301,7 +386,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			m_stack.pop_back();
 			unsigned inSize = (unsigned)m_stack.back();
 			m_stack.pop_back();
-			m_stack.push_back(sha3(bytesConstRef(m_temp.data() + inOff, inSize)));
+			m_stack.push_back(word256(SHA3Cache::thread()(bytesConstRef(m_temp.data() + inOff, inSize))));
 			break;
 		}
 		case Instruction::ADDRESS:
@@ -313,26 +398,26 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 		case Instruction::BALANCE:
 		{
 			require(1);
-			m_stack.back() = _ext.balance(asAddress(m_stack.back()));
+			m_stack.back() = word256(_ext.balance(asAddress(m_stack.back())));
 			break;
 		}
 		case Instruction::CALLER:
 			m_stack.push_back(fromAddress(_ext.caller));
 			break;
 		case Instruction::CALLVALUE:
-			m_stack.push_back(_ext.value);
+			m_stack.push_back(word256(_ext.value));
 			break;
 		case Instruction::CALLDATALOAD:
 		{
 			require(1);
 			if ((unsigned)m_stack.back() + 31 < _ext.data.size())
-				m_stack.back() = (u256)*(h256 const*)(_ext.data.data() + (unsigned)m_stack.back());
+				m_stack.back() = word256::fromBigEndian(_ext.data.data() + (unsigned)m_stack.back());
 			else
 			{
 				h256 r;
 				for (unsigned i = (unsigned)m_stack.back(), e = (unsigned)m_stack.back() + 32, j = 0; i < e; ++i, ++j)
 					r[j] = i < _ext.data.size() ? _ext.data[i] : 0;
-				m_stack.back() = (u256)r;
+				m_stack.back() = word256(r);
 			}
 			break;
 		}
@@ -371,22 +456,22 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			break;
 		}
 		case Instruction::GASPRICE:
-			m_stack.push_back(_ext.gasPrice);
+			m_stack.push_back(word256(_ext.gasPrice));
 			break;
 		case Instruction::PREVHASH:
-			m_stack.push_back(_ext.previousBlock.hash);
+			m_stack.push_back(word256(_ext.previousBlock.hash));
 			break;
 		case Instruction::COINBASE:
-			m_stack.push_back((u160)_ext.currentBlock.coinbaseAddress);
+			m_stack.push_back(fromAddress(_ext.currentBlock.coinbaseAddress));
 			break;
 		case Instruction::TIMESTAMP:
-			m_stack.push_back(_ext.currentBlock.timestamp);
+			m_stack.push_back(word256(_ext.currentBlock.timestamp));
 			break;
 		case Instruction::NUMBER:
-			m_stack.push_back(_ext.currentBlock.number);
+			m_stack.push_back(word256(_ext.currentBlock.number));
 			break;
 		case Instruction::DIFFICULTY:
-			m_stack.push_back(_ext.currentBlock.difficulty);
+			m_stack.push_back(word256(_ext.currentBlock.difficulty));
 			break;
 		case Instruction::GASLIMIT:
 			m_stack.push_back(1000000);
@@ -423,14 +508,8 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 		case Instruction::PUSH30:
 		case Instruction::PUSH31:
 		case Instruction::PUSH32:
-		{
-			int i = (int)inst - (int)Instruction::PUSH1 + 1;
-			nextPC = m_curPC + 1;
-			m_stack.push_back(0);
-			for (; i--; nextPC++)
-				m_stack.back() = (m_stack.back() << 8) | _ext.getCode(nextPC);
+			m_stack.push_back(item.data);
 			break;
-		}
 		case Instruction::POP:
 			require(1);
 			m_stack.pop_back();
@@ -471,13 +550,13 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 		case Instruction::MLOAD:
 		{
 			require(1);
-			m_stack.back() = (u256)*(h256 const*)(m_temp.data() + (unsigned)m_stack.back());
+			m_stack.back() = word256::fromBigEndian(m_temp.data() + (unsigned)m_stack.back());
 			break;
 		}
 		case Instruction::MSTORE:
 		{
 			require(2);
-			*(h256*)&m_temp[(unsigned)m_stack.back()] = (h256)m_stack[m_stack.size() - 2];
+			m_stack[m_stack.size() - 2].toBigEndian(&m_temp[(unsigned)m_stack.back()]);
 			m_stack.pop_back();
 			m_stack.pop_back();
 			break;
@@ -485,30 +564,30 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 		case Instruction::MSTORE8:
 		{
 			require(2);
-			m_temp[(unsigned)m_stack.back()] = (byte)(m_stack[m_stack.size() - 2] & 0xff);
+			m_temp[(unsigned)m_stack.back()] = (byte)m_stack[m_stack.size() - 2].low64();
 			m_stack.pop_back();
 			m_stack.pop_back();
 			break;
 		}
 		case Instruction::SLOAD:
 			require(1);
-			m_stack.back() = _ext.store(m_stack.back());
+			m_stack.back() = word256(_ext.store((u256)m_stack.back()));
 			break;
 		case Instruction::SSTORE:
 			require(2);
-			_ext.setStore(m_stack.back(), m_stack[m_stack.size() - 2]);
+			_ext.setStore((u256)m_stack.back(), (u256)m_stack[m_stack.size() - 2]);
 			m_stack.pop_back();
 			m_stack.pop_back();
 			break;
 		case Instruction::JUMP:
 			require(1);
-			nextPC = m_stack.back();
+			nextItem = m_code->itemAt(m_stack.back());
 			m_stack.pop_back();
 			break;
 		case Instruction::JUMPI:
 			require(2);
 			if (m_stack[m_stack.size() - 2])
-				nextPC = m_stack.back();
+				nextItem = m_code->itemAt(m_stack.back());
 			m_stack.pop_back();
 			m_stack.pop_back();
 			break;
@@ -525,7 +604,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 		{
 			require(3);
 
-			u256 endowment = m_stack.back();
+			u256 endowment = (u256)m_stack.back();
 			m_stack.pop_back();
 			unsigned initOff = (unsigned)m_stack.back();
 			m_stack.pop_back();
@@ -535,7 +614,9 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			if (_ext.balance(_ext.myAddress) >= endowment)
 			{
 				_ext.subBalance(endowment);
-				m_stack.push_back((u160)_ext.create(endowment, &m_gas, bytesConstRef(m_temp.data() + initOff, initSize)));
+				u256 gas = (u256)m_gas;
+				m_stack.push_back(fromAddress(_ext.create(endowment, &gas, bytesConstRef(m_temp.data() + initOff, initSize))));
+				m_gas = word256(gas);
 			}
 			else
 				m_stack.push_back(0);
@@ -545,11 +626,11 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 		{
 			require(7);
 
-			u256 gas = m_stack.back();
+			u256 gas = (u256)m_stack.back();
 			m_stack.pop_back();
-			u160 receiveAddress = asAddress(m_stack.back());
+			Address receiveAddress = asAddress(m_stack.back());
 			m_stack.pop_back();
-			u256 value = m_stack.back();
+			u256 value = (u256)m_stack.back();
 			m_stack.pop_back();
 
 			unsigned inOff = (unsigned)m_stack.back();
@@ -569,7 +650,7 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 			else
 				m_stack.push_back(0);
 
-			m_gas += gas;
+			m_gas += word256(gas);
 			break;
 		}
 		case Instruction::RETURN:
@@ -601,3 +682,777 @@ template <class Ext> eth::bytesConstRef eth::VM::go(Ext& _ext, uint64_t _steps)
 	return bytesConstRef();
 }
 
+template <class Ext> eth::bytesConstRef eth::VM::goThreaded(Ext& _ext, uint64_t _steps)
+{
+	// Fused instructions count as one step, so a run that must stop at an exact step can't fuse them.
+	if (_steps != (uint64_t)-1)
+		return runThreaded<Ext, false>(_ext, _steps);
+	return runThreaded<Ext, true>(_ext, _steps);
+}
+
+template <class Ext, bool _Fused> eth::bytesConstRef eth::VM::runThreaded(Ext& _ext, uint64_t _steps)
+{
+#if defined(__GNUC__)
+	// One handler per opcode, each doing its own fee calculation and execution, then jumping straight to the next
+	// instruction's handler. Semantics (including the order of the checks) must stay exactly those of goReference().
+	// The static fees of each basic block are paid in one go on entering it (see CodeItem::blockGas). Whatever of that
+	// hasn't been used is given back should we stop part way through, so the gas left is always just as it would be
+	// having paid per instruction. Without enough gas for the whole block we fall back to paying per instruction.
+	// When _Fused, a block is only entered that way if the stack also holds all it needs (CodeItem::blockStack),
+	// which lets its instructions skip their own stack checks.
+	static void* const c_labels[256] =
+	{
+		&&l_STOP, &&l_ADD, &&l_MUL, &&l_SUB, &&l_DIV, &&l_SDIV, &&l_MOD, &&l_SMOD,
+		&&l_EXP, &&l_NEG, &&l_LT, &&l_GT, &&l_SLT, &&l_SGT, &&l_EQ, &&l_NOT,
+		&&l_AND, &&l_OR, &&l_XOR, &&l_BYTE, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_SHA3, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_ADDRESS, &&l_BALANCE, &&l_ORIGIN, &&l_CALLER, &&l_CALLVALUE, &&l_CALLDATALOAD, &&l_CALLDATASIZE, &&l_CALLDATACOPY,
+		&&l_CODESIZE, &&l_CODECOPY, &&l_GASPRICE, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_PREVHASH, &&l_COINBASE, &&l_TIMESTAMP, &&l_NUMBER, &&l_DIFFICULTY, &&l_GASLIMIT, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_POP, &&l_DUP, &&l_SWAP, &&l_MLOAD, &&l_MSTORE, &&l_MSTORE8, &&l_SLOAD, &&l_SSTORE,
+		&&l_JUMP, &&l_JUMPI, &&l_PC, &&l_MEMSIZE, &&l_GAS, &&l_bad, &&l_bad, &&l_bad,
+		&&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH,
+		&&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH,
+		&&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH,
+		&&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH, &&l_PUSH,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_CREATE, &&l_CALL, &&l_RETURN, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad,
+		&&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_bad, &&l_SUICIDE
+	};
+
+// Move on to the next item; steps are counted just as in goReference().
+#define ETH_VM_DISPATCH \
+	{ \
+		if (!_steps--) \
+		{ \
+			if (prepaid) \
+				m_gas += items[nextItem].blockGas; \
+			prepaid = false; \
+			throw StepsDone(); \
+		} \
+		item = items + nextItem; \
+		nextItem = item->next; \
+		goto *c_labels[(byte)item->inst]; \
+	}
+#define ETH_VM_NEXT { m_curPC = items[nextItem].pc; ETH_VM_DISPATCH }
+// Pay the static fee of the current item.
+#define ETH_VM_CHARGE { if (m_gas < item->gas) { m_gas = 0; throw OutOfGas(); } m_gas -= item->gas; }
+// Pay for the rest of the block from the current item, unless already done; if we can't, just pay for the item.
+#define ETH_VM_PRECHARGE \
+	if (!prepaid) \
+	{ \
+		if (m_gas >= item->blockGas && (!_Fused || m_stack.size() >= item->blockStack)) \
+		{ \
+			m_gas -= item->blockGas; \
+			prepaid = true; \
+		} \
+		else \
+			ETH_VM_CHARGE \
+	}
+// Check the stack has _N items, unless the block's been checked already.
+#define ETH_VM_REQUIRE(_N) if (!_Fused || !prepaid) require(_N)
+// Pay _RUNGAS plus whatever it costs to grow memory to cover _NEWTEMPSIZE, then grow it.
+#define ETH_VM_CHARGE_MEM(_RUNGAS, _NEWTEMPSIZE) \
+	{ \
+		word256 runGas = _RUNGAS; \
+		unsigned newTempSize = ((unsigned)(_NEWTEMPSIZE) + 31) / 32 * 32; \
+		if (newTempSize > m_temp.size()) \
+			runGas += c_memoryGasWord * (newTempSize - m_temp.size()) / 32; \
+		if (m_gas < runGas) \
+		{ \
+			m_gas = 0; \
+			throw OutOfGas(); \
+		} \
+		m_gas -= runGas; \
+		if (newTempSize > m_temp.size()) \
+			m_temp.resize(newTempSize); \
+	}
+
+	if (!m_code)
+		m_code = CodeAnalysis::get(_ext.code, _ext.codeHash);
+	CodeItem const* items = m_code->items().data();
+	CodeItem const* item = nullptr;
+	size_t nextItem = m_code->itemAt(m_curPC);
+	bool prepaid = false;	// Set while in a block whose static fees have been paid up front.
+	try
+	{
+		ETH_VM_DISPATCH;
+
+	l_ADD:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] += m_stack.back();
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_MUL:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] *= m_stack.back();
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SUB:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() - m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_DIV:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? m_stack.back() / m_stack[m_stack.size() - 2] : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SDIV:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? sdiv(m_stack.back(), m_stack[m_stack.size() - 2]) : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_MOD:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? m_stack.back() % m_stack[m_stack.size() - 2] : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SMOD:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack[m_stack.size() - 2] ? smod(m_stack.back(), m_stack[m_stack.size() - 2]) : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_EXP:
+		{
+			ETH_VM_PRECHARGE;
+			ETH_VM_REQUIRE(2);
+			auto base = m_stack.back();
+			unsigned expon = (unsigned)m_stack[m_stack.size() - 2];
+			m_stack.pop_back();
+			m_stack.back() = pow(base, expon);
+		}
+		ETH_VM_NEXT;
+	l_NEG:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		m_stack.back() = ~(m_stack.back() - 1);
+		ETH_VM_NEXT;
+	l_LT:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() < m_stack[m_stack.size() - 2] ? 1 : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_GT:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() > m_stack[m_stack.size() - 2] ? 1 : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SLT:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = slt(m_stack.back(), m_stack[m_stack.size() - 2]) ? 1 : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SGT:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = sgt(m_stack.back(), m_stack[m_stack.size() - 2]) ? 1 : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_EQ:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() == m_stack[m_stack.size() - 2] ? 1 : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_NOT:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		m_stack.back() = m_stack.back() ? 0 : 1;
+		ETH_VM_NEXT;
+	l_AND:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() & m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_OR:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() | m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_XOR:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() ^ m_stack[m_stack.size() - 2];
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_BYTE:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		m_stack[m_stack.size() - 2] = m_stack.back() < 32 ? (m_stack[m_stack.size() - 2] >> (8 * (31 - (unsigned)m_stack.back()))) & 0xff : 0;
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SHA3:
+		{
+			prepaid = false;
+			require(2);
+			ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + (unsigned)m_stack[m_stack.size() - 2]);
+			unsigned inOff = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned inSize = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			m_stack.push_back(word256(SHA3Cache::thread()(bytesConstRef(m_temp.data() + inOff, inSize))));
+		}
+		ETH_VM_NEXT;
+	l_ADDRESS:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(fromAddress(_ext.myAddress));
+		ETH_VM_NEXT;
+	l_ORIGIN:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(fromAddress(_ext.origin));
+		ETH_VM_NEXT;
+	l_BALANCE:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		m_stack.back() = word256(_ext.balance(asAddress(m_stack.back())));
+		ETH_VM_NEXT;
+	l_CALLER:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(fromAddress(_ext.caller));
+		ETH_VM_NEXT;
+	l_CALLVALUE:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(word256(_ext.value));
+		ETH_VM_NEXT;
+	l_CALLDATALOAD:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		if ((unsigned)m_stack.back() + 31 < _ext.data.size())
+			m_stack.back() = word256::fromBigEndian(_ext.data.data() + (unsigned)m_stack.back());
+		else
+		{
+			h256 r;
+			for (unsigned i = (unsigned)m_stack.back(), e = (unsigned)m_stack.back() + 32, j = 0; i < e; ++i, ++j)
+				r[j] = i < _ext.data.size() ? _ext.data[i] : 0;
+			m_stack.back() = word256(r);
+		}
+		ETH_VM_NEXT;
+	l_CALLDATASIZE:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(_ext.data.size());
+		ETH_VM_NEXT;
+	l_CALLDATACOPY:
+		{
+			prepaid = false;
+			require(3);
+			ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + (unsigned)m_stack[m_stack.size() - 3]);
+			unsigned mf = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned cf = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned l = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned el = cf + l > _ext.data.size() ? _ext.data.size() < cf ? 0 : _ext.data.size() - cf : l;
+			memcpy(m_temp.data() + mf, _ext.data.data() + cf, el);
+			memset(m_temp.data() + mf + el, 0, l - el);
+		}
+		ETH_VM_NEXT;
+	l_CODESIZE:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(_ext.code.size());
+		ETH_VM_NEXT;
+	l_CODECOPY:
+		{
+			prepaid = false;
+			require(3);
+			ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + (unsigned)m_stack[m_stack.size() - 3]);
+			unsigned mf = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned cf = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned l = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned el = cf + l > _ext.code.size() ? _ext.code.size() < cf ? 0 : _ext.code.size() - cf : l;
+			memcpy(m_temp.data() + mf, _ext.code.data() + cf, el);
+			memset(m_temp.data() + mf + el, 0, l - el);
+		}
+		ETH_VM_NEXT;
+	l_GASPRICE:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(word256(_ext.gasPrice));
+		ETH_VM_NEXT;
+	l_PREVHASH:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(word256(_ext.previousBlock.hash));
+		ETH_VM_NEXT;
+	l_COINBASE:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(fromAddress(_ext.currentBlock.coinbaseAddress));
+		ETH_VM_NEXT;
+	l_TIMESTAMP:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(word256(_ext.currentBlock.timestamp));
+		ETH_VM_NEXT;
+	l_NUMBER:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(word256(_ext.currentBlock.number));
+		ETH_VM_NEXT;
+	l_DIFFICULTY:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(word256(_ext.currentBlock.difficulty));
+		ETH_VM_NEXT;
+	l_GASLIMIT:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(1000000);
+		ETH_VM_NEXT;
+	l_PUSH:
+		ETH_VM_PRECHARGE;
+		if (_Fused && prepaid && items[nextItem].inst == Instruction::JUMP)
+		{
+			// PUSH/JUMP: go straight there.
+			nextItem = item->jumpTarget;
+			prepaid = false;
+		}
+		else if (_Fused && prepaid && items[nextItem].inst == Instruction::JUMPI)
+		{
+			// PUSH/JUMPI: test the condition in place.
+			nextItem = m_stack.back() ? item->jumpTarget : items[nextItem].next;
+			m_stack.pop_back();
+			prepaid = false;
+		}
+		else
+			m_stack.push_back(item->data);
+		ETH_VM_NEXT;
+	l_POP:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_DUP:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		m_stack.push_back(m_stack.back());
+		ETH_VM_NEXT;
+	l_SWAP:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		std::swap(m_stack.back(), m_stack[m_stack.size() - 2]);
+		ETH_VM_NEXT;
+	l_MLOAD:
+		prepaid = false;
+		require(1);
+		ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + 32);
+		m_stack.back() = word256::fromBigEndian(m_temp.data() + (unsigned)m_stack.back());
+		ETH_VM_NEXT;
+	l_MSTORE:
+		prepaid = false;
+		require(2);
+		ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + 32);
+		m_stack[m_stack.size() - 2].toBigEndian(&m_temp[(unsigned)m_stack.back()]);
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_MSTORE8:
+		prepaid = false;
+		require(2);
+		ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + 1);
+		m_temp[(unsigned)m_stack.back()] = (byte)m_stack[m_stack.size() - 2].low64();
+		m_stack.pop_back();
+		m_stack.pop_back();
+		ETH_VM_NEXT;
+	l_SLOAD:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		m_stack.back() = word256(_ext.store((u256)m_stack.back()));
+		ETH_VM_NEXT;
+	l_SSTORE:
+		{
+			prepaid = false;
+			require(2);
+			word256 runGas;
+			u256 current = _ext.store((u256)m_stack.back());
+			if (!current && m_stack[m_stack.size() - 2])
+				runGas = c_sstoreGasWord * 2;
+			else if (current && !m_stack[m_stack.size() - 2])
+				runGas = 0;
+			else
+				runGas = c_sstoreGasWord;
+			if (m_gas < runGas)
+			{
+				m_gas = 0;
+				throw OutOfGas();
+			}
+			m_gas -= runGas;
+			_ext.setStore((u256)m_stack.back(), (u256)m_stack[m_stack.size() - 2]);
+			m_stack.pop_back();
+			m_stack.pop_back();
+		}
+		ETH_VM_NEXT;
+	l_JUMP:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(1);
+		nextItem = m_code->itemAt(m_stack.back());
+		m_stack.pop_back();
+		prepaid = false;
+		ETH_VM_NEXT;
+	l_JUMPI:
+		ETH_VM_PRECHARGE;
+		ETH_VM_REQUIRE(2);
+		if (m_stack[m_stack.size() - 2])
+			nextItem = m_code->itemAt(m_stack.back());
+		m_stack.pop_back();
+		m_stack.pop_back();
+		prepaid = false;
+		ETH_VM_NEXT;
+	l_PC:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(m_curPC);
+		ETH_VM_NEXT;
+	l_MEMSIZE:
+		ETH_VM_PRECHARGE;
+		m_stack.push_back(m_temp.size());
+		ETH_VM_NEXT;
+	l_GAS:
+		prepaid = false;
+		ETH_VM_CHARGE;
+		m_stack.push_back(m_gas);
+		ETH_VM_NEXT;
+	l_CREATE:
+		{
+			prepaid = false;
+			require(3);
+			ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack[m_stack.size() - 2] + (unsigned)m_stack[m_stack.size() - 3]);
+
+			u256 endowment = (u256)m_stack.back();
+			m_stack.pop_back();
+			unsigned initOff = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned initSize = (unsigned)m_stack.back();
+			m_stack.pop_back();
+
+			if (_ext.balance(_ext.myAddress) >= endowment)
+			{
+				_ext.subBalance(endowment);
+				u256 gas = (u256)m_gas;
+				m_stack.push_back(fromAddress(_ext.create(endowment, &gas, bytesConstRef(m_temp.data() + initOff, initSize))));
+				m_gas = word256(gas);
+			}
+			else
+				m_stack.push_back(0);
+		}
+		ETH_VM_NEXT;
+	l_CALL:
+		{
+			prepaid = false;
+			require(7);
+			ETH_VM_CHARGE_MEM(item->gas + (unsigned)m_stack[m_stack.size() - 1], std::max((unsigned)m_stack[m_stack.size() - 6] + (unsigned)m_stack[m_stack.size() - 7], (unsigned)m_stack[m_stack.size() - 4] + (unsigned)m_stack[m_stack.size() - 5]));
+
+			u256 gas = (u256)m_stack.back();
+			m_stack.pop_back();
+			Address receiveAddress = asAddress(m_stack.back());
+			m_stack.pop_back();
+			u256 value = (u256)m_stack.back();
+			m_stack.pop_back();
+
+			unsigned inOff = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned inSize = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned outOff = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned outSize = (unsigned)m_stack.back();
+			m_stack.pop_back();
+
+			if (_ext.balance(_ext.myAddress) >= value)
+			{
+				_ext.subBalance(value);
+				m_stack.push_back(_ext.call(receiveAddress, value, bytesConstRef(m_temp.data() + inOff, inSize), &gas, bytesRef(m_temp.data() + outOff, outSize)));
+			}
+			else
+				m_stack.push_back(0);
+
+			m_gas += word256(gas);
+		}
+		ETH_VM_NEXT;
+	l_RETURN:
+		{
+			prepaid = false;
+			require(2);
+			ETH_VM_CHARGE_MEM(item->gas, (unsigned)m_stack.back() + (unsigned)m_stack[m_stack.size() - 2]);
+
+			unsigned b = (unsigned)m_stack.back();
+			m_stack.pop_back();
+			unsigned s = (unsigned)m_stack.back();
+			m_stack.pop_back();
+
+			return bytesConstRef(m_temp.data() + b, s);
+		}
+	l_SUICIDE:
+		prepaid = false;
+		require(1);
+		_ext.suicide(asAddress(m_stack.back()));
+		return bytesConstRef();
+	l_STOP:
+		return bytesConstRef();
+	l_bad:
+		prepaid = false;
+		ETH_VM_CHARGE;
+		throw BadInstruction();
+	}
+	catch (...)
+	{
+		// Give back the prepaid fees of the rest of the block.
+		if (prepaid)
+			m_gas += item->blockGas - item->gas;
+		throw;
+	}
+
+#undef ETH_VM_CHARGE_MEM
+#undef ETH_VM_PRECHARGE
+#undef ETH_VM_REQUIRE
+#undef ETH_VM_CHARGE
+#undef ETH_VM_NEXT
+#undef ETH_VM_DISPATCH
+#else
+	return goReference(_ext, _steps);
+#endif
+}
+
+template <class Ext> eth::bytesConstRef eth::VM::goCompiled(Ext& _ext, uint64_t _steps)
+{
+	// Compiled code runs to the end; only the interpreter can stop at an exact step.
+	NativeEntry native = _steps == (uint64_t)-1 ? VMCompiler::get(_ext.code, _ext.codeHash) : nullptr;
+	if (!native)
+		return goInterpreter(_ext, _steps);
+	if (!m_code)
+		m_code = CodeAnalysis::get(_ext.code, _ext.codeHash);
+
+	NativeRun r;
+	r.size = m_stack.size();
+	m_stack.resize(r.size + c_nativeStackRoom);
+	r.stack = reinterpret_cast<NativeWord*>(m_stack.data());
+	r.room = m_stack.size();
+	r.memory = m_temp.data();
+	r.memorySize = m_temp.size();
+	r.gas = toNative(m_gas);
+	r.pc = m_curPC;
+	r.outOffset = 0;
+	r.outSize = 0;
+	r.data = _ext.data.data();
+	r.dataSize = _ext.data.size();
+	r.vm = this;
+	r.ext = &_ext;
+	r.reserve = &VM::nativeReserve;
+	r.grow = &VM::nativeGrow;
+	r.step = &VM::nativeStep<Ext>;
+	r.divmod = &VM::nativeDivmod;
+
+	int exit;
+	try
+	{
+		exit = native(&r);
+	}
+	catch (...)
+	{
+		// Only the VM's side throws, and then the gas is already back in m_gas.
+		m_stack.resize(r.size);
+		m_curPC = r.pc;
+		throw;
+	}
+	m_stack.resize(r.size);
+	m_gas = fromNative(r.gas);
+	m_curPC = r.pc;
+
+	if (exit == NativeReturned)
+		return bytesConstRef(m_temp.data() + r.outOffset, r.outSize);
+	if (exit == NativeInterpret)
+		return goInterpreter(_ext, _steps);
+	return bytesConstRef();
+}
+
+template <class Ext> void eth::VM::nativeStep(NativeRun* _r, unsigned _inst)
+{
+	// Just as runReference() does it, but on the stack of _r.
+	VM& vm = *static_cast<VM*>(_r->vm);
+	Ext& ext = *static_cast<Ext*>(_r->ext);
+	word256* stack = reinterpret_cast<word256*>(_r->stack);
+	uint64_t& n = _r->size;
+	CodeItem const& item = vm.m_code->items()[vm.m_code->itemAt(_r->pc)];
+	vm.m_gas = fromNative(_r->gas);
+
+	auto require = [&](unsigned _n) { if (n < _n) throw StackTooSmall(_n, n); };
+	auto charge = [&](word256 _runGas, unsigned _newTempSize)
+	{
+		_newTempSize = (_newTempSize + 31) / 32 * 32;
+		if (_newTempSize > vm.m_temp.size())
+			_runGas += c_memoryGasWord * (_newTempSize - vm.m_temp.size()) / 32;
+		if (vm.m_gas < _runGas)
+		{
+			vm.m_gas = 0;
+			throw OutOfGas();
+		}
+		vm.m_gas -= _runGas;
+		if (_newTempSize > vm.m_temp.size())
+		{
+			vm.m_temp.resize(_newTempSize);
+			_r->memory = vm.m_temp.data();
+			_r->memorySize = vm.m_temp.size();
+		}
+	};
+	auto copy = [&](bytesConstRef _from)
+	{
+		require(3);
+		charge(item.gas, (unsigned)stack[n - 1] + (unsigned)stack[n - 3]);
+		unsigned mf = (unsigned)stack[n - 1];
+		unsigned cf = (unsigned)stack[n - 2];
+		unsigned l = (unsigned)stack[n - 3];
+		n -= 3;
+		unsigned el = cf + l > _from.size() ? _from.size() < cf ? 0 : _from.size() - cf : l;
+		memcpy(vm.m_temp.data() + mf, _from.data() + cf, el);
+		memset(vm.m_temp.data() + mf + el, 0, l - el);
+	};
+
+	switch ((Instruction)_inst)
+	{
+	case Instruction::ADDRESS:
+		stack[n++] = fromAddress(ext.myAddress);
+		break;
+	case Instruction::ORIGIN:
+		stack[n++] = fromAddress(ext.origin);
+		break;
+	case Instruction::BALANCE:
+		stack[n - 1] = word256(ext.balance(asAddress(stack[n - 1])));
+		break;
+	case Instruction::CALLER:
+		stack[n++] = fromAddress(ext.caller);
+		break;
+	case Instruction::CALLVALUE:
+		stack[n++] = word256(ext.value);
+		break;
+	case Instruction::GASPRICE:
+		stack[n++] = word256(ext.gasPrice);
+		break;
+	case Instruction::PREVHASH:
+		stack[n++] = word256(ext.previousBlock.hash);
+		break;
+	case Instruction::COINBASE:
+		stack[n++] = fromAddress(ext.currentBlock.coinbaseAddress);
+		break;
+	case Instruction::TIMESTAMP:
+		stack[n++] = word256(ext.currentBlock.timestamp);
+		break;
+	case Instruction::NUMBER:
+		stack[n++] = word256(ext.currentBlock.number);
+		break;
+	case Instruction::DIFFICULTY:
+		stack[n++] = word256(ext.currentBlock.difficulty);
+		break;
+	case Instruction::SLOAD:
+		stack[n - 1] = word256(ext.store((u256)stack[n - 1]));
+		break;
+	case Instruction::SHA3:
+	{
+		require(2);
+		charge(item.gas, (unsigned)stack[n - 1] + (unsigned)stack[n - 2]);
+		unsigned inOff = (unsigned)stack[n - 1];
+		unsigned inSize = (unsigned)stack[n - 2];
+		--n;
+		stack[n - 1] = word256(SHA3Cache::thread()(bytesConstRef(vm.m_temp.data() + inOff, inSize)));
+		break;
+	}
+	case Instruction::CALLDATACOPY:
+		copy(ext.data);
+		break;
+	case Instruction::CODECOPY:
+		copy(ext.code);
+		break;
+	case Instruction::SSTORE:
+	{
+		require(2);
+		word256 runGas;
+		u256 current = ext.store((u256)stack[n - 1]);
+		if (!current && stack[n - 2])
+			runGas = c_sstoreGasWord * 2;
+		else if (current && !stack[n - 2])
+			runGas = 0;
+		else
+			runGas = c_sstoreGasWord;
+		if (vm.m_gas < runGas)
+		{
+			vm.m_gas = 0;
+			throw OutOfGas();
+		}
+		vm.m_gas -= runGas;
+		ext.setStore((u256)stack[n - 1], (u256)stack[n - 2]);
+		n -= 2;
+		break;
+	}
+	case Instruction::CREATE:
+	{
+		require(3);
+		charge(item.gas, (unsigned)stack[n - 2] + (unsigned)stack[n - 3]);
+		u256 endowment = (u256)stack[n - 1];
+		unsigned initOff = (unsigned)stack[n - 2];
+		unsigned initSize = (unsigned)stack[n - 3];
+		n -= 3;
+		if (ext.balance(ext.myAddress) >= endowment)
+		{
+			ext.subBalance(endowment);
+			u256 gas = (u256)vm.m_gas;
+			stack[n++] = fromAddress(ext.create(endowment, &gas, bytesConstRef(vm.m_temp.data() + initOff, initSize)));
+			vm.m_gas = word256(gas);
+		}
+		else
+			stack[n++] = 0;
+		break;
+	}
+	case Instruction::CALL:
+	{
+		require(7);
+		charge(item.gas + (unsigned)stack[n - 1], std::max((unsigned)stack[n - 6] + (unsigned)stack[n - 7], (unsigned)stack[n - 4] + (unsigned)stack[n - 5]));
+		u256 gas = (u256)stack[n - 1];
+		Address receiveAddress = asAddress(stack[n - 2]);
+		u256 value = (u256)stack[n - 3];
+		unsigned inOff = (unsigned)stack[n - 4];
+		unsigned inSize = (unsigned)stack[n - 5];
+		unsigned outOff = (unsigned)stack[n - 6];
+		unsigned outSize = (unsigned)stack[n - 7];
+		n -= 7;
+		if (ext.balance(ext.myAddress) >= value)
+		{
+			ext.subBalance(value);
+			stack[n++] = ext.call(receiveAddress, value, bytesConstRef(vm.m_temp.data() + inOff, inSize), &gas, bytesRef(vm.m_temp.data() + outOff, outSize));
+		}
+		else
+			stack[n++] = 0;
+		vm.m_gas += word256(gas);
+		break;
+	}
+	case Instruction::SUICIDE:
+		require(1);
+		ext.suicide(asAddress(stack[n - 1]));
+		break;
+	default:
+		break;
+	}
+	_r->gas = toNative(vm.m_gas);
+}
@@ -0,0 +1,87 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMArena.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "VMArena.h"
+
+#include <boost/thread.hpp>
+using namespace std;
+using namespace eth;
+
+static boost::thread_specific_ptr<VMArena> t_arena;
+
+VMArena& VMArena::threadArena()
+{
+	if (!t_arena.get())
+		t_arena.reset(new VMArena);
+	return *t_arena;
+}
+
+VM* VMArena::acquire(u256 _gas, VMKind _kind)
+{
+	if (m_free.empty())
+	{
+		m_vms.push_back(unique_ptr<VM>(new VM));
+		m_vms.back()->m_stack.reserve(c_stackSlabWords);
+		m_free.push_back(m_vms.back().get());
+	}
+	VM* ret = m_free.back();
+	m_free.pop_back();
+	ret->reset(_gas);
+	ret->setKind(_kind);
+	ret->m_stack.clear();
+	ret->m_temp.clear();
+	return ret;
+}
+
+void VMArena::release(VM* _vm)
+{
+	// Don't hang on to what the code it ran was.
+	_vm->m_code.reset();
+	m_free.push_back(_vm);
+}
+
+void VMArena::endTransaction()
+{
+	if (inUse())
+		return;
+
+	if (m_vms.size() > c_maxPooledVMs)
+	{
+		m_vms.resize(c_maxPooledVMs);
+		m_free.clear();
+		for (auto const& i: m_vms)
+			m_free.push_back(i.get());
+	}
+
+	SHA3Cache::thread().clear();
+
+	for (auto const& i: m_vms)
+	{
+		if (i->m_temp.capacity() > c_maxPooledMemory)
+			bytes().swap(i->m_temp);
+		if (i->m_stack.capacity() > c_stackSlabWords)
+		{
+			word256s s;
+			s.reserve(c_stackSlabWords);
+			i->m_stack.swap(s);
+		}
+	}
+}
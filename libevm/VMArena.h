@@ -0,0 +1,84 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMArena.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <memory>
+#include "VM.h"
+
+namespace eth
+{
+
+static const unsigned c_stackSlabWords = 1024;				///< Words of stack each pooled VM starts out with room for.
+static const unsigned c_maxPooledMemory = 1024 * 1024;		///< Bytes of memory a pooled VM may keep hold of between transactions.
+static const unsigned c_maxPooledVMs = 64;					///< VMs the pool keeps between transactions.
+
+/**
+ * @brief Per-thread pool of VMs, one for each call frame.
+ * A VM handed out has an empty stack with room for c_stackSlabWords words and empty memory, but both keep the
+ * storage of their previous use, so a message call normally runs without going to the allocator at all. There's no
+ * stack limit, so the stack can still grow past its slab if it must.
+ * Once a transaction is finished, endTransaction() gives back in one go whatever the pool grew beyond its limits,
+ * and empties the thread's SHA3Cache.
+ * VMs must be released on the thread that acquired them.
+ */
+class VMArena
+{
+public:
+	/// @returns the arena of the calling thread.
+	static VMArena& threadArena();
+
+	/// @returns a fresh VM with @a _gas gas, running code with @a _kind. Hand it back with release().
+	VM* acquire(u256 _gas, VMKind _kind = VMKind::Interpreter);
+
+	/// Return @a _vm, as given by acquire(), to the pool.
+	void release(VM* _vm);
+
+	/// Trim the pool back to its limits and empty the SHA3 cache, if no VM is in use.
+	void endTransaction();
+
+	/// @returns the number of VMs currently handed out.
+	unsigned inUse() const { return m_vms.size() - m_free.size(); }
+
+private:
+	std::vector<std::unique_ptr<VM>> m_vms;		///< Every VM we own.
+	std::vector<VM*> m_free;					///< Those not handed out.
+};
+
+/**
+ * @brief A VM on loan from the thread's arena for the lifetime of the object.
+ */
+class VMFrame
+{
+public:
+	explicit VMFrame(u256 _gas, VMKind _kind = VMKind::Interpreter): m_vm(VMArena::threadArena().acquire(_gas, _kind)) {}
+	~VMFrame() { VMArena::threadArena().release(m_vm); }
+	VMFrame(VMFrame const&) = delete;
+	VMFrame& operator=(VMFrame const&) = delete;
+
+	VM& operator*() const { return *m_vm; }
+	VM* operator->() const { return m_vm; }
+
+private:
+	VM* m_vm;
+};
+
+}
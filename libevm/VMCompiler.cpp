@@ -0,0 +1,570 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMCompiler.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "VMCompiler.h"
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+#include <libethsupport/CommonIO.h>
+#include <libethsupport/FileSystem.h>
+#include <libethsupport/Log.h>
+#include "CodeAnalysis.h"
+using namespace std;
+using namespace eth;
+namespace fs = boost::filesystem;
+
+static map<h256, NativeEntry> s_compiled;		///< Code hash -> its compiled form, or null if it has none.
+static string s_cacheDir;
+static string s_compiler = "c++";
+static mutex s_lock;
+
+/// What the generated code is built with, besides the interface: 256-bit arithmetic on NativeWord, as word256 does it,
+/// and the macros each instruction is written in terms of. s, n and room are the stack, mem and memSize the memory,
+/// and gas the gas left, all kept locally and handed back in the NativeRun r around calls into the VM.
+static char const* c_prelude = R"(
+typedef NativeWord W;
+
+static inline W w(uint64_t _v) { W ret = {{_v, 0, 0, 0}}; return ret; }
+static inline W w4(uint64_t _a, uint64_t _b, uint64_t _c, uint64_t _d) { W ret = {{_a, _b, _c, _d}}; return ret; }
+static inline bool nz(W const& _a) { return (_a.limbs[0] | _a.limbs[1] | _a.limbs[2] | _a.limbs[3]) != 0; }
+static inline unsigned lo32(W const& _a) { return (unsigned)_a.limbs[0]; }
+static inline bool eq(W const& _a, W const& _b) { return _a.limbs[0] == _b.limbs[0] && _a.limbs[1] == _b.limbs[1] && _a.limbs[2] == _b.limbs[2] && _a.limbs[3] == _b.limbs[3]; }
+static inline bool lt(W const& _a, W const& _b) { for (unsigned i = 4; i--;) if (_a.limbs[i] != _b.limbs[i]) return _a.limbs[i] < _b.limbs[i]; return false; }
+static inline bool negative(W const& _a) { return _a.limbs[3] >> 63; }
+static inline bool slt(W const& _a, W const& _b) { return negative(_a) != negative(_b) ? negative(_a) : lt(_a, _b); }
+static inline W band(W _a, W const& _b) { for (unsigned i = 0; i < 4; ++i) _a.limbs[i] &= _b.limbs[i]; return _a; }
+static inline W bor(W _a, W const& _b) { for (unsigned i = 0; i < 4; ++i) _a.limbs[i] |= _b.limbs[i]; return _a; }
+static inline W bxor(W _a, W const& _b) { for (unsigned i = 0; i < 4; ++i) _a.limbs[i] ^= _b.limbs[i]; return _a; }
+static inline W bnot(W _a) { for (unsigned i = 0; i < 4; ++i) _a.limbs[i] = ~_a.limbs[i]; return _a; }
+
+static inline W add(W _a, W const& _b)
+{
+	uint64_t carry = 0;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		uint64_t s = _a.limbs[i] + carry;
+		carry = s < carry;
+		_a.limbs[i] = s + _b.limbs[i];
+		carry += _a.limbs[i] < s;
+	}
+	return _a;
+}
+
+static inline W sub(W _a, W const& _b)
+{
+	uint64_t borrow = 0;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		uint64_t d = _a.limbs[i] - _b.limbs[i];
+		uint64_t b = _a.limbs[i] < _b.limbs[i];
+		_a.limbs[i] = d - borrow;
+		borrow = b | (d < borrow);
+	}
+	return _a;
+}
+
+static inline W negate(W const& _a) { return sub(w(0), _a); }
+
+static inline uint64_t mul64(uint64_t _a, uint64_t _b, uint64_t& o_hi)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 p = (unsigned __int128)_a * _b;
+	o_hi = (uint64_t)(p >> 64);
+	return (uint64_t)p;
+#else
+	uint64_t al = (uint32_t)_a, ah = _a >> 32, bl = (uint32_t)_b, bh = _b >> 32;
+	uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+	uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+	o_hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+static inline W mul(W const& _a, W const& _b)
+{
+	W ret = w(0);
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		uint64_t carry = 0;
+		for (unsigned j = 0; i + j < 4; ++j)
+		{
+			uint64_t hi;
+			uint64_t lo = mul64(_a.limbs[i], _b.limbs[j], hi);
+			lo += carry;
+			hi += lo < carry;
+			ret.limbs[i + j] += lo;
+			hi += ret.limbs[i + j] < lo;
+			carry = hi;
+		}
+	}
+	return ret;
+}
+
+static inline W power(W _b, unsigned _e)
+{
+	W ret = w(1);
+	for (; _e; _e >>= 1, _b = mul(_b, _b))
+		if (_e & 1)
+			ret = mul(ret, _b);
+	return ret;
+}
+
+static inline W udiv(NativeRun* r, W const& _a, W const& _b) { W q, m; r->divmod(&_a, &_b, &q, &m); return q; }
+static inline W umod(NativeRun* r, W const& _a, W const& _b) { W q, m; r->divmod(&_a, &_b, &q, &m); return m; }
+static inline W magnitude(W const& _a) { return negative(_a) ? negate(_a) : _a; }
+static inline W sdiv(NativeRun* r, W const& _a, W const& _b) { W q = udiv(r, magnitude(_a), magnitude(_b)); return negative(_a) != negative(_b) ? negate(q) : q; }
+static inline W smod(NativeRun* r, W const& _a, W const& _b) { W m = umod(r, magnitude(_a), magnitude(_b)); return negative(_a) ? negate(m) : m; }
+
+static inline W byteOf(W const& _i, W const& _v)
+{
+	if (_i.limbs[1] | _i.limbs[2] | _i.limbs[3] || _i.limbs[0] >= 32)
+		return w(0);
+	unsigned b = 31 - (unsigned)_i.limbs[0];
+	return w((_v.limbs[b / 8] >> (8 * (b % 8))) & 0xff);
+}
+
+static inline W fromBigEndian(unsigned char const* _p)
+{
+	W ret = w(0);
+	for (unsigned i = 0; i < 4; ++i)
+		for (unsigned j = 0; j < 8; ++j)
+			ret.limbs[3 - i] = (ret.limbs[3 - i] << 8) | _p[i * 8 + j];
+	return ret;
+}
+
+static inline void toBigEndian(W const& _w, unsigned char* _p)
+{
+	for (unsigned i = 0; i < 4; ++i)
+		for (unsigned j = 0; j < 8; ++j)
+			_p[i * 8 + j] = (unsigned char)(_w.limbs[3 - i] >> (56 - 8 * j));
+}
+
+static inline W callDataLoad(NativeRun const* r, W const& _offset)
+{
+	unsigned o = lo32(_offset);
+	if (o + 31 < r->dataSize)
+		return fromBigEndian(r->data + o);
+	unsigned char d[32] = {};
+	for (unsigned i = o, e = o + 32, j = 0; i < e; ++i, ++j)
+		d[j] = i < r->dataSize ? r->data[i] : 0;
+	return fromBigEndian(d);
+}
+
+// Hand everything back in r, leaving at _PC.
+#define ETH_LEAVE(_PC) { r->size = n; r->gas = gas; r->pc = _PC; }
+// Leave for the interpreter to carry on from _PC.
+#define ETH_INTERPRET(_PC) { ETH_LEAVE(_PC); return NativeInterpret; }
+// Pick up again from r whatever the VM may have changed.
+#define ETH_RELOAD { s = r->stack; n = r->size; room = r->room; mem = r->memory; memSize = r->memorySize; gas = r->gas; }
+// Make sure the stack has room for _N more items.
+#define ETH_ROOM(_N) if (n + _N > room) { r->size = n; r->reserve(r, _N); s = r->stack; room = r->room; }
+// Enter a block at _PC: check it has _STACK items and the gas, _GAS, and pay it; it pushes no more than _N items.
+#define ETH_ENTER(_PC, _GAS, _STACK, _N) { if (n < _STACK || lt(gas, _GAS)) ETH_INTERPRET(_PC); ETH_ROOM(_N); gas = sub(gas, _GAS); }
+// Pay _FEE plus the cost of growing memory to cover _SIZE bytes, and grow it.
+#define ETH_CHARGE_MEM(_PC, _FEE, _SIZE) \
+	{ \
+		unsigned newSize = ((unsigned)(_SIZE) + 31) / 32 * 32; \
+		if (newSize > memSize) \
+		{ \
+			ETH_LEAVE(_PC); \
+			if (!r->grow(r, _FEE, newSize)) \
+				return NativeInterpret; \
+			ETH_RELOAD; \
+		} \
+		else if (lt(gas, w(_FEE))) \
+			ETH_INTERPRET(_PC) \
+		else \
+			gas = sub(gas, w(_FEE)); \
+	}
+// Have the VM run _INST, with the rest of the block's fees, _PREPAID, given back meanwhile.
+#define ETH_STEP(_PC, _INST, _PREPAID) { ETH_LEAVE(_PC); r->gas = add(gas, _PREPAID); r->step(r, _INST); n = r->size; }
+// Have the VM run _INST, paying for it there.
+#define ETH_STEP_DYNAMIC(_PC, _INST) { ETH_ROOM(1); ETH_LEAVE(_PC); r->step(r, _INST); ETH_RELOAD; }
+)";
+
+/// @returns @a _w as an expression in the generated code.
+static string literal(word256 const& _w)
+{
+	ostringstream ret;
+	if (_w.fitsIn64())
+		ret << "w(" << _w.low64() << "ull)";
+	else
+		ret << "w4(" << _w.limbs()[0] << "ull, " << _w.limbs()[1] << "ull, " << _w.limbs()[2] << "ull, " << _w.limbs()[3] << "ull)";
+	return ret.str();
+}
+
+/// @returns the label of the entry to the item @a _i, which checks for the block it starts.
+static string entry(size_t _i) { return "e" + toString(_i); }
+
+/// @returns the label of the item @a _i, for running on within a block already paid for.
+static string within(size_t _i) { return "l" + toString(_i); }
+
+/// @returns the statement taking a jump to the constant @a _target in @a _code, whose main stream ends at @a _end.
+static string jumpTo(CodeAnalysis const& _code, size_t _end, word256 const& _target)
+{
+	size_t i = _code.itemAt(_target);
+	// Into PUSH data, which only the interpreter runs.
+	if (i > _end)
+		return "ETH_INTERPRET(" + toString(_code.items()[i].pc) + "ull)";
+	return "goto " + entry(i) + ";";
+}
+
+/// @returns true if @a _inst's fee is paid by the block it's in (see CodeItem::blockGas).
+static bool inBlock(CodeItem const& _item)
+{
+	switch (_item.inst)
+	{
+	case Instruction::STOP:
+	case Instruction::SHA3:
+	case Instruction::CALLDATACOPY:
+	case Instruction::CODECOPY:
+	case Instruction::MLOAD:
+	case Instruction::MSTORE:
+	case Instruction::MSTORE8:
+	case Instruction::SSTORE:
+	case Instruction::GAS:
+	case Instruction::CREATE:
+	case Instruction::CALL:
+	case Instruction::RETURN:
+	case Instruction::SUICIDE:
+		return false;
+	default:
+		return c_instructionInfo.count(_item.inst);
+	}
+}
+
+string VMCompiler::source(bytesConstRef _code)
+{
+	CodeAnalysis code(_code);
+	CodeItems const& items = code.items();
+
+	// The main stream and the sentinel; items for offsets within PUSH data follow, and are left to the interpreter.
+	size_t end = code.itemAt(_code.size());
+	size_t count = end + 1;
+
+	// Which items carry on into the next with the block already paid for, and how many items there are from each to
+	// the end of its block: no more than it can push.
+	vector<bool> chained(count, false);
+	vector<size_t> pushes(count, 1);
+	for (size_t i = end; i--;)
+	{
+		CodeItem const& item = items[i];
+		if (!item.gas.fitsIn64())
+			return string();
+		chained[i] = inBlock(item) && item.blockGas && item.inst != Instruction::JUMP && item.inst != Instruction::JUMPI && items[item.next].blockGas;
+		if (chained[i])
+			pushes[i] += pushes[i + 1];
+	}
+
+	ostringstream out;
+	out << "// Compiled from EVM code of " << _code.size() << " bytes, hash " << sha3(_code) << ".\n";
+	out << "#include <stdint.h>\n\n" << nativeInterface() << "\n" << c_prelude << "\n";
+	out << "extern \"C\" int ethNativeRun(NativeRun* r)\n{\n";
+	out << "\tW* s = r->stack;\n\tuint64_t n = r->size;\n\tuint64_t room = r->room;\n\tunsigned char* mem = r->memory;\n\tuint64_t memSize = r->memorySize;\n\tW gas = r->gas;\n";
+	out << "\tW target = w(r->pc);\n\tgoto jump;\n\n";
+
+	for (size_t i = 0; i < end; ++i)
+	{
+		CodeItem const& item = items[i];
+		string pc = toString(item.pc) + "ull";
+		string fee = toString(item.gas.low64()) + "ull";
+		// What's been paid for the rest of the block, beyond this item.
+		string prepaid = literal(item.blockGas ? item.blockGas - item.gas : word256());
+		out << entry(i) << ":\n";
+		if (inBlock(item))
+		{
+			InstructionInfo const& info = c_instructionInfo.at(item.inst);
+			if (item.blockGas)
+				out << "\tETH_ENTER(" << pc << ", " << literal(item.blockGas) << ", " << item.blockStack << ", " << pushes[i] << ");\n";
+			else
+				out << "\tETH_ENTER(" << pc << ", " << literal(item.gas) << ", " << info.args << ", 1);\n";
+		}
+		out << within(i) << ":\n\t";
+
+		switch (item.inst)
+		{
+		case Instruction::STOP:
+			out << "ETH_LEAVE(" << pc << "); return NativeStopped;";
+			break;
+		case Instruction::ADD:
+			out << "s[n - 2] = add(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::MUL:
+			out << "s[n - 2] = mul(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::SUB:
+			out << "s[n - 2] = sub(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::DIV:
+			out << "s[n - 2] = nz(s[n - 2]) ? udiv(r, s[n - 1], s[n - 2]) : w(0); --n;";
+			break;
+		case Instruction::SDIV:
+			out << "s[n - 2] = nz(s[n - 2]) ? sdiv(r, s[n - 1], s[n - 2]) : w(0); --n;";
+			break;
+		case Instruction::MOD:
+			out << "s[n - 2] = nz(s[n - 2]) ? umod(r, s[n - 1], s[n - 2]) : w(0); --n;";
+			break;
+		case Instruction::SMOD:
+			out << "s[n - 2] = nz(s[n - 2]) ? smod(r, s[n - 1], s[n - 2]) : w(0); --n;";
+			break;
+		case Instruction::EXP:
+			out << "s[n - 2] = power(s[n - 1], lo32(s[n - 2])); --n;";
+			break;
+		case Instruction::NEG:
+			out << "s[n - 1] = bnot(sub(s[n - 1], w(1)));";
+			break;
+		case Instruction::LT:
+			out << "s[n - 2] = w(lt(s[n - 1], s[n - 2])); --n;";
+			break;
+		case Instruction::GT:
+			out << "s[n - 2] = w(lt(s[n - 2], s[n - 1])); --n;";
+			break;
+		case Instruction::SLT:
+			out << "s[n - 2] = w(slt(s[n - 1], s[n - 2])); --n;";
+			break;
+		case Instruction::SGT:
+			out << "s[n - 2] = w(slt(s[n - 2], s[n - 1])); --n;";
+			break;
+		case Instruction::EQ:
+			out << "s[n - 2] = w(eq(s[n - 1], s[n - 2])); --n;";
+			break;
+		case Instruction::NOT:
+			out << "s[n - 1] = w(!nz(s[n - 1]));";
+			break;
+		case Instruction::AND:
+			out << "s[n - 2] = band(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::OR:
+			out << "s[n - 2] = bor(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::XOR:
+			out << "s[n - 2] = bxor(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::BYTE:
+			out << "s[n - 2] = byteOf(s[n - 1], s[n - 2]); --n;";
+			break;
+		case Instruction::ADDRESS:
+		case Instruction::BALANCE:
+		case Instruction::ORIGIN:
+		case Instruction::CALLER:
+		case Instruction::CALLVALUE:
+		case Instruction::GASPRICE:
+		case Instruction::PREVHASH:
+		case Instruction::COINBASE:
+		case Instruction::TIMESTAMP:
+		case Instruction::NUMBER:
+		case Instruction::DIFFICULTY:
+		case Instruction::SLOAD:
+			out << "ETH_STEP(" << pc << ", " << (unsigned)item.inst << ", " << prepaid << ");";
+			break;
+		case Instruction::CALLDATALOAD:
+			out << "s[n - 1] = callDataLoad(r, s[n - 1]);";
+			break;
+		case Instruction::CALLDATASIZE:
+			out << "s[n++] = w(r->dataSize);";
+			break;
+		case Instruction::CODESIZE:
+			out << "s[n++] = w(" << _code.size() << "ull);";
+			break;
+		case Instruction::GASLIMIT:
+			out << "s[n++] = w(1000000);";
+			break;
+		case Instruction::POP:
+			out << "--n;";
+			break;
+		case Instruction::DUP:
+			out << "s[n] = s[n - 1]; ++n;";
+			break;
+		case Instruction::SWAP:
+			out << "{ W t = s[n - 1]; s[n - 1] = s[n - 2]; s[n - 2] = t; }";
+			break;
+		case Instruction::MLOAD:
+			out << "if (n < 1) ETH_INTERPRET(" << pc << ");\n\tETH_CHARGE_MEM(" << pc << ", " << fee << ", lo32(s[n - 1]) + 32);\n\t";
+			out << "s[n - 1] = fromBigEndian(mem + lo32(s[n - 1]));";
+			break;
+		case Instruction::MSTORE:
+			out << "if (n < 2) ETH_INTERPRET(" << pc << ");\n\tETH_CHARGE_MEM(" << pc << ", " << fee << ", lo32(s[n - 1]) + 32);\n\t";
+			out << "toBigEndian(s[n - 2], mem + lo32(s[n - 1])); n -= 2;";
+			break;
+		case Instruction::MSTORE8:
+			out << "if (n < 2) ETH_INTERPRET(" << pc << ");\n\tETH_CHARGE_MEM(" << pc << ", " << fee << ", lo32(s[n - 1]) + 1);\n\t";
+			out << "mem[lo32(s[n - 1])] = (unsigned char)s[n - 2].limbs[0]; n -= 2;";
+			break;
+		case Instruction::JUMP:
+			out << "target = s[n - 1]; --n; goto jump;";
+			break;
+		case Instruction::JUMPI:
+			out << "{ bool c = nz(s[n - 2]); target = s[n - 1]; n -= 2; if (c) goto jump; }";
+			break;
+		case Instruction::PC:
+			out << "s[n++] = w(" << pc << ");";
+			break;
+		case Instruction::MEMSIZE:
+			out << "s[n++] = w(memSize);";
+			break;
+		case Instruction::GAS:
+			out << "if (lt(gas, w(" << fee << "))) ETH_INTERPRET(" << pc << ");\n\t";
+			out << "ETH_ROOM(1); gas = sub(gas, w(" << fee << ")); s[n++] = gas;";
+			break;
+		case Instruction::RETURN:
+			out << "if (n < 2) ETH_INTERPRET(" << pc << ");\n\tETH_CHARGE_MEM(" << pc << ", " << fee << ", lo32(s[n - 1]) + lo32(s[n - 2]));\n\t";
+			out << "r->outOffset = lo32(s[n - 1]); r->outSize = lo32(s[n - 2]); n -= 2; ETH_LEAVE(" << pc << "); return NativeReturned;";
+			break;
+		case Instruction::SHA3:
+		case Instruction::CALLDATACOPY:
+		case Instruction::CODECOPY:
+		case Instruction::SSTORE:
+		case Instruction::CREATE:
+		case Instruction::CALL:
+			out << "ETH_STEP_DYNAMIC(" << pc << ", " << (unsigned)item.inst << ");";
+			break;
+		case Instruction::SUICIDE:
+			out << "ETH_STEP_DYNAMIC(" << pc << ", " << (unsigned)item.inst << "); return NativeStopped;";
+			break;
+		default:
+			if (item.inst >= Instruction::PUSH1 && item.inst <= Instruction::PUSH32)
+			{
+				CodeItem const& next = items[item.next];
+				if (chained[i] && next.inst == Instruction::JUMP)
+					out << jumpTo(code, end, item.data);
+				else if (chained[i] && next.inst == Instruction::JUMPI)
+					out << "{ bool c = nz(s[n - 1]); --n; if (c) " << jumpTo(code, end, item.data) << " } goto " << entry(item.next + 1) << ";";
+				else
+					out << "s[n++] = " << literal(item.data) << ";";
+			}
+			else
+				// Bad instruction: the interpreter charges for it and throws.
+				out << "ETH_INTERPRET(" << pc << ");";
+			break;
+		}
+		out << "\n";
+		if (chained[i])
+			out << "\tgoto " << within(i + 1) << ";\n";
+	}
+
+	// The sentinel, and jumps to anywhere else.
+	out << entry(end) << ":\n" << within(end) << ":\n\tETH_LEAVE(" << _code.size() << "ull); return NativeStopped;\n\n";
+	out << "jump:\n";
+	out << "\tif (target.limbs[1] | target.limbs[2] | target.limbs[3] || target.limbs[0] >= " << _code.size() << "ull)\n\t\tgoto " << entry(end) << ";\n";
+	out << "\tswitch (target.limbs[0])\n\t{\n";
+	for (size_t i = 0; i < end; ++i)
+		out << "\tcase " << items[i].pc << "ull: goto " << entry(i) << ";\n";
+	out << "\tdefault: ETH_INTERPRET(target.limbs[0]);\n\t}\n}\n";
+	return out.str();
+}
+
+string VMCompiler::cacheDir()
+{
+	lock_guard<mutex> l(s_lock);
+	return s_cacheDir.empty() ? (fs::path(getDataDir()) / "vmcache").string() : s_cacheDir;
+}
+
+void VMCompiler::setCacheDir(string const& _dir)
+{
+	lock_guard<mutex> l(s_lock);
+	s_cacheDir = _dir;
+}
+
+string VMCompiler::compiler()
+{
+	lock_guard<mutex> l(s_lock);
+	return s_compiler;
+}
+
+void VMCompiler::setCompiler(string const& _command)
+{
+	lock_guard<mutex> l(s_lock);
+	s_compiler = _command;
+}
+
+/// @returns @a _code built and loaded; null should it fail.
+static NativeEntry build(bytesConstRef _code)
+{
+#if defined(_WIN32)
+	(void)_code;
+	return nullptr;
+#else
+	string src = VMCompiler::source(_code);
+	if (src.empty())
+		return nullptr;
+	string name = toHex(sha3(src).ref());
+	try
+	{
+		fs::path dir = VMCompiler::cacheDir();
+		fs::path so = dir / (name + ".so");
+		if (!fs::exists(so))
+		{
+			fs::create_directories(dir);
+			fs::path cpp = dir / (name + ".cpp");
+			fs::path log = dir / (name + ".log");
+			fs::path built = dir / fs::unique_path(name + ".%%%%%%%%.so");
+			writeFile(cpp.string(), asBytes(src));
+			string command = VMCompiler::compiler() + " -std=c++11 -O2 -fPIC -fexceptions -shared -o '" + built.string() + "' '" + cpp.string() + "' > '" + log.string() + "' 2>&1";
+			if (std::system(command.c_str()) || !fs::exists(built))
+			{
+				cwarn << "Couldn't compile EVM code" << sha3(_code).abridged() << "; see" << log.string();
+				fs::remove(built);
+				return nullptr;
+			}
+			// Put in place in one go, so no other process loads it half written.
+			fs::rename(built, so);
+			fs::remove(cpp);
+			fs::remove(log);
+		}
+
+		void* lib = dlopen(so.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (!lib)
+		{
+			cwarn << "Couldn't load compiled EVM code:" << dlerror();
+			return nullptr;
+		}
+		return reinterpret_cast<NativeEntry>(dlsym(lib, "ethNativeRun"));
+	}
+	catch (fs::filesystem_error const& _e)
+	{
+		cwarn << "Couldn't compile EVM code" << sha3(_code).abridged() << ":" << _e.what();
+		return nullptr;
+	}
+#endif
+}
+
+NativeEntry VMCompiler::get(bytesConstRef _code, h256 _codeHash)
+{
+	if (!_codeHash)
+		return nullptr;
+	{
+		lock_guard<mutex> l(s_lock);
+		auto it = s_compiled.find(_codeHash);
+		if (it != s_compiled.end())
+			return it->second;
+	}
+
+	// Compile without holding everyone else up; should another thread get there first, theirs is kept.
+	NativeEntry ret = build(_code);
+	lock_guard<mutex> l(s_lock);
+	return s_compiled.insert(make_pair(_codeHash, ret)).first->second;
+}
@@ -0,0 +1,117 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMCompiler.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <libethsupport/Common.h>
+#include <libethsupport/FixedHash.h>
+
+namespace eth
+{
+
+/// Declare the interface between the VM and compiled code, and give it as text too, so compiled code is built with
+/// exactly the same declarations.
+#define ETH_NATIVE_INTERFACE(...) __VA_ARGS__ inline char const* nativeInterface() { return #__VA_ARGS__; }
+
+ETH_NATIVE_INTERFACE(
+
+/// A word on the stack; four limbs, least significant first, just as word256.
+struct NativeWord
+{
+	uint64_t limbs[4];
+};
+
+/// How a run of compiled code ended.
+enum NativeExit
+{
+	NativeStopped,		///< At STOP or SUICIDE, or off the end of the code.
+	NativeReturned,		///< At RETURN, with the output at outOffset in memory, outSize bytes.
+	NativeInterpret		///< Short of an instruction it can't run, which the interpreter must carry on from.
+};
+
+/// The state of a VM running compiled code, and the VM's entry points for what the code can't do itself.
+struct NativeRun
+{
+	NativeWord* stack;			///< Bottom of the stack.
+	uint64_t size;				///< Items on the stack.
+	uint64_t room;				///< Items there's room for.
+	unsigned char* memory;
+	uint64_t memorySize;
+	NativeWord gas;
+	uint64_t pc;				///< Where to start; on leaving, the instruction that ended the run, or to carry on from.
+	uint64_t outOffset;
+	uint64_t outSize;
+	unsigned char const* data;	///< Call data.
+	uint64_t dataSize;
+	void* vm;
+	void* ext;
+
+	/// Make room for _n more items on the stack.
+	void (*reserve)(NativeRun* _r, uint64_t _n);
+	/// Pay _fee plus the cost of growing memory to _size bytes, and grow it; zero, having done nothing, if short of gas.
+	int (*grow)(NativeRun* _r, uint64_t _fee, uint64_t _size);
+	/// Run the instruction _inst, at pc, in the VM; it pays any fee that isn't static itself, throwing as the VM does.
+	void (*step)(NativeRun* _r, unsigned _inst);
+	/// Divide _a by the non-zero _b.
+	void (*divmod)(NativeWord const* _a, NativeWord const* _b, NativeWord* o_q, NativeWord* o_r);
+};
+
+/// Compiled code; runs from _r->pc and @returns a NativeExit.
+typedef int (*NativeEntry)(NativeRun* _r);
+
+)
+
+/**
+ * @brief Compiles EVM code to native code: C++ generated from the code analysis, built by the system compiler into a
+ * shared object and loaded.
+ * Each piece of code becomes one function with a label for each instruction, working on the VM's own stack, memory and
+ * gas, handed over in a NativeRun. As in the threaded loop, a basic block has its gas and stack needs checked once on
+ * entry and then runs unchecked, and a PUSH followed by JUMP or JUMPI jumps straight to its target.
+ * Whatever the function can't do exactly as the interpreter would (a block it's short of gas or stack for, a bad
+ * instruction, a jump into PUSH data, memory it's short of gas to grow) it leaves with NativeInterpret, having not yet
+ * started on the instruction, and the VM carries on from there with the interpreter. Instructions needing the Ext, and
+ * those whose fee depends on it, are handed to the VM one at a time through NativeRun::step.
+ * Shared objects are kept in cacheDir() under the hash of their source, so they're reused by later runs and never
+ * picked up stale. Once loaded, they stay loaded for the life of the process.
+ */
+class VMCompiler
+{
+public:
+	/// @returns the compiled form of @a _code, whose hash is @a _codeHash, compiling it first if need be; null for code
+	/// without a hash (init code, which runs just the once), or if it can't be compiled.
+	/// Other threads are free to run compiled code meanwhile; the first to compile a given piece of code wins.
+	static NativeEntry get(bytesConstRef _code, h256 _codeHash);
+
+	/// @returns the C++ compiled for @a _code; empty if it has fees the generated code can't take.
+	static std::string source(bytesConstRef _code);
+
+	/// The directory shared objects are built and kept in; "vmcache" in the data directory unless set.
+	static std::string cacheDir();
+	static void setCacheDir(std::string const& _dir);
+
+	/// The command to compile with; "c++" unless set.
+	static std::string compiler();
+	static void setCompiler(std::string const& _command);
+};
+
+}
@@ -0,0 +1,184 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMProfiler.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "VMProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <boost/thread.hpp>
+using namespace std;
+using namespace eth;
+
+std::atomic<bool> VMProfiler::s_enabled(false);
+
+static void retire(VMProfiler* _p);
+
+// When a thread exits, what its profiler counted is kept and the profiler goes.
+static boost::thread_specific_ptr<VMProfiler> t_profiler(retire);
+static std::vector<std::unique_ptr<VMProfiler>> s_profilers;
+static std::mutex s_profilersLock;
+static VMProfile s_retired;			///< What the profilers of threads that have exited counted.
+static VMProfile s_baseline;
+
+/// Add what @a _p counted to @a _out.
+static void addTo(VMProfile& _out, VMProfiler const& _p)
+{
+	for (unsigned i = 0; i < 256; ++i)
+	{
+		_out.opcodes[i].count += _p.opcode(i).count;
+		_out.opcodes[i].gas += _p.opcode(i).gas;
+		_out.opcodes[i].cycles += _p.opcode(i).cycles;
+	}
+	_p.forEachCode([&](h256 const& _h, VMProfiler::CodeCounters const& _c)
+	{
+		CodeProfile& c = _out.code[_h];
+		c.runs += _c.runs;
+		c.steps += _c.steps;
+		c.gas += _c.gas;
+		c.cycles += _c.cycles;
+	});
+}
+
+static void retire(VMProfiler* _p)
+{
+	lock_guard<mutex> l(s_profilersLock);
+	addTo(s_retired, *_p);
+	for (auto it = s_profilers.begin(); it != s_profilers.end(); ++it)
+		if (it->get() == _p)
+		{
+			s_profilers.erase(it);
+			break;
+		}
+}
+
+VMProfiler::VMProfiler()
+{
+	for (auto& i: m_opcodes)
+	{
+		i.count = 0;
+		i.gas = 0;
+		i.cycles = 0;
+	}
+}
+
+unsigned VMProfiler::threads()
+{
+	lock_guard<mutex> l(s_profilersLock);
+	return s_profilers.size();
+}
+
+VMProfiler& VMProfiler::thread()
+{
+	if (!t_profiler.get())
+	{
+		lock_guard<mutex> l(s_profilersLock);
+		s_profilers.push_back(unique_ptr<VMProfiler>(new VMProfiler));
+		t_profiler.reset(s_profilers.back().get());
+	}
+	return *t_profiler;
+}
+
+VMProfiler::CodeCounters& VMProfiler::code(h256 const& _codeHash)
+{
+	// Only we ever add to m_code, so we can look without the lock.
+	auto it = m_code.find(_codeHash);
+	if (it != m_code.end())
+		return it->second;
+
+	lock_guard<mutex> l(x_code);
+	CodeCounters& ret = m_code[_codeHash];
+	ret.runs = 0;
+	ret.steps = 0;
+	ret.gas = 0;
+	ret.cycles = 0;
+	return ret;
+}
+
+static VMProfile totals()
+{
+	VMProfile ret = s_retired;
+	for (auto const& p: s_profilers)
+		addTo(ret, *p);
+	return ret;
+}
+
+VMProfile VMProfiler::profile()
+{
+	lock_guard<mutex> l(s_profilersLock);
+	VMProfile ret = totals();
+	for (unsigned i = 0; i < 256; ++i)
+	{
+		ret.opcodes[i].count -= s_baseline.opcodes[i].count;
+		ret.opcodes[i].gas -= s_baseline.opcodes[i].gas;
+		ret.opcodes[i].cycles -= s_baseline.opcodes[i].cycles;
+	}
+	for (auto it = ret.code.begin(); it != ret.code.end();)
+	{
+		auto b = s_baseline.code.find(it->first);
+		if (b != s_baseline.code.end())
+		{
+			it->second.runs -= b->second.runs;
+			it->second.steps -= b->second.steps;
+			it->second.gas -= b->second.gas;
+			it->second.cycles -= b->second.cycles;
+		}
+		if (it->second.runs)
+			++it;
+		else
+			it = ret.code.erase(it);
+	}
+	return ret;
+}
+
+void VMProfiler::reset()
+{
+	// The counters belong to their threads, so rather than zero them we remember where they were.
+	lock_guard<mutex> l(s_profilersLock);
+	s_baseline = totals();
+}
+
+std::ostream& eth::operator<<(std::ostream& _out, VMProfile const& _p)
+{
+	vector<pair<uint64_t, unsigned>> ops;
+	for (unsigned i = 0; i < 256; ++i)
+		if (_p.opcodes[i].count)
+			ops.push_back(make_pair(_p.opcodes[i].cycles, i));
+	sort(ops.rbegin(), ops.rend());
+	_out << "OPCODE          COUNT            GAS         CYCLES" << endl;
+	for (auto const& i: ops)
+	{
+		auto info = c_instructionInfo.find((Instruction)i.second);
+		OpcodeProfile const& o = _p.opcodes[i.second];
+		_out << left << setw(12) << (info != c_instructionInfo.end() ? info->second.name : "<invalid>") << right << setw(9) << o.count << setw(15) << o.gas << setw(15) << o.cycles << endl;
+	}
+
+	vector<pair<uint64_t, h256>> code;
+	for (auto const& i: _p.code)
+		code.push_back(make_pair(i.second.cycles, i.first));
+	sort(code.rbegin(), code.rend());
+	_out << endl << "CODE           RUNS      STEPS            GAS         CYCLES" << endl;
+	for (auto const& i: code)
+	{
+		CodeProfile const& c = _p.code.at(i.second);
+		_out << left << setw(10) << (i.second ? i.second.abridged() : "<init>") << right << setw(9) << c.runs << setw(11) << c.steps << setw(15) << c.gas << setw(15) << c.cycles << endl;
+	}
+	return _out;
+}
@@ -0,0 +1,194 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMProfiler.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <libethsupport/Common.h>
+#include <libethsupport/FixedHash.h>
+#include <libethcore/Instruction.h>
+#include "Word256.h"
+
+namespace eth
+{
+
+/// Totals for one opcode.
+struct OpcodeProfile
+{
+	uint64_t count = 0;		///< Times executed.
+	uint64_t gas = 0;		///< Gas spent; for CALL and CREATE, this includes what the callee used.
+	uint64_t cycles = 0;	///< Time spent, in CPU cycles where available (nanoseconds otherwise).
+};
+
+/// Totals for one piece of code, including any calls it made.
+struct CodeProfile
+{
+	uint64_t runs = 0;		///< Times the VM was started on it.
+	uint64_t steps = 0;		///< Instructions executed.
+	uint64_t gas = 0;		///< Gas spent.
+	uint64_t cycles = 0;	///< Time spent.
+};
+
+/**
+ * @brief A snapshot of the VM profile, summed over all threads.
+ * Code is keyed by its hash; init code, which has none, goes under the null hash.
+ */
+struct VMProfile
+{
+	std::array<OpcodeProfile, 256> opcodes;
+	std::map<h256, CodeProfile> code;
+};
+
+/**
+ * @brief Low-overhead profiler for the VM; off until setEnabled().
+ * While enabled, VM::go() runs the reference loop with profiling hooks. It counts executions, gas and time for each
+ * opcode and for each code hash. Each thread has its own counters, which only it writes. They're atomics, so
+ * profile() can read them from any thread without locking the VM out. The only lock on the VM side is taken the
+ * first time a thread runs a given piece of code.
+ */
+class VMProfiler
+{
+public:
+	/// @returns true if the VM should profile what it runs.
+	static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool _on) { s_enabled = _on; }
+
+	/// @returns the totals since the last reset(), over all threads.
+	static VMProfile profile();
+
+	/// Start counting from zero again.
+	static void reset();
+
+	/// @returns a timestamp for measuring cycles.
+	static uint64_t now()
+	{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_ia32_rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/// Counters for one opcode.
+	struct OpcodeCounters { std::atomic<uint64_t> count; std::atomic<uint64_t> gas; std::atomic<uint64_t> cycles; };
+
+	/// Counters for one piece of code.
+	struct CodeCounters { std::atomic<uint64_t> runs; std::atomic<uint64_t> steps; std::atomic<uint64_t> gas; std::atomic<uint64_t> cycles; };
+
+	/// Add @a _d to the counter @a _c, which must be one of the calling thread's.
+	static void bump(std::atomic<uint64_t>& _c, uint64_t _d) { _c.store(_c.load(std::memory_order_relaxed) + _d, std::memory_order_relaxed); }
+
+	/// @returns the calling thread's counters.
+	static VMProfiler& thread();
+
+	/// @returns the number of threads with counters of their own. Once a thread exits, what it counted is kept in the
+	/// totals and its counters go.
+	static unsigned threads();
+
+	/// @returns the calling thread's counters for opcode @a _op.
+	OpcodeCounters& opcode(byte _op) { return m_opcodes[_op]; }
+	OpcodeCounters const& opcode(byte _op) const { return m_opcodes[_op]; }
+
+	/// @returns the calling thread's counters for the code with hash @a _codeHash.
+	CodeCounters& code(h256 const& _codeHash);
+
+	/// Call @a _f with each code hash we have counters for, and the counters.
+	template <class F> void forEachCode(F const& _f) const { std::lock_guard<std::mutex> l(x_code); for (auto const& i: m_code) _f(i.first, i.second); }
+
+private:
+	VMProfiler();
+
+	std::array<OpcodeCounters, 256> m_opcodes;
+	std::unordered_map<h256, CodeCounters> m_code;	///< Nodes never move, so references to the counters stay good.
+	mutable std::mutex x_code;						///< Guards the shape of m_code (not the counters).
+
+	static std::atomic<bool> s_enabled;
+};
+
+/**
+ * @brief Accounts for one run of the VM on some code, and its instructions, to the thread's profiler.
+ * Each instruction is accounted for once the next begins (or the run ends), with whatever gas and time went since.
+ */
+class ProfiledRun
+{
+public:
+	/// Profile a run of the code with hash @a _codeHash by a VM whose gas left is @a _gasLeft.
+	ProfiledRun(h256 const& _codeHash, word256 const& _gasLeft):
+		m_profiler(VMProfiler::thread()),
+		m_code(m_profiler.code(_codeHash)),
+		m_gasLeft(_gasLeft),
+		m_startGas(_gasLeft),
+		m_lastGas(_gasLeft),
+		m_startTime(VMProfiler::now()),
+		m_lastTime(m_startTime)
+	{}
+	~ProfiledRun()
+	{
+		retire();
+		VMProfiler::bump(m_code.runs, 1);
+		VMProfiler::bump(m_code.gas, m_startGas > m_gasLeft ? (m_startGas - m_gasLeft).low64() : 0);
+		VMProfiler::bump(m_code.cycles, m_lastTime - m_startTime);
+	}
+	ProfiledRun(ProfiledRun const&) = delete;
+	ProfiledRun& operator=(ProfiledRun const&) = delete;
+
+	/// Note that instruction @a _op is starting.
+	void next(Instruction _op) { retire(); m_op = (byte)_op; m_running = true; }
+
+	/// Note that the instruction last started has finished; we account for it at the next one anyway.
+	void stepped() {}
+
+private:
+	/// Account for the instruction running, if any.
+	void retire()
+	{
+		uint64_t t = VMProfiler::now();
+		if (m_running)
+		{
+			auto& c = m_profiler.opcode(m_op);
+			VMProfiler::bump(c.count, 1);
+			VMProfiler::bump(c.gas, m_lastGas > m_gasLeft ? (m_lastGas - m_gasLeft).low64() : 0);
+			VMProfiler::bump(c.cycles, t - m_lastTime);
+			VMProfiler::bump(m_code.steps, 1);
+		}
+		m_lastGas = m_gasLeft;
+		m_lastTime = t;
+	}
+
+	VMProfiler& m_profiler;
+	VMProfiler::CodeCounters& m_code;
+	word256 const& m_gasLeft;
+	word256 m_startGas;
+	word256 m_lastGas;
+	uint64_t m_startTime;
+	uint64_t m_lastTime;
+	bool m_running = false;
+	byte m_op = 0;
+};
+
+std::ostream& operator<<(std::ostream& _out, VMProfile const& _p);
+
+}
@@ -0,0 +1,376 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMTrace.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "VMTrace.h"
+
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include "VM.h"
+using namespace std;
+using namespace eth;
+
+static const unsigned c_traceBufferSize = 1024 * 1024;	///< Bytes of trace we buffer before writing them out.
+
+/// Flags of an Effects record.
+static const byte c_memorySize = 1;
+static const byte c_memoryWrite = 2;
+static const byte c_storageWrite = 4;
+
+namespace
+{
+
+/// The trace file and what's waiting to go into it.
+struct TraceSink
+{
+	~TraceSink() { flush(); }
+	void flush() { if (out.is_open()) out.write((char const*)buffer.data(), buffer.size()); buffer.clear(); }
+
+	std::ofstream out;
+	bytes buffer;
+	std::mutex x_sink;
+};
+
+}
+
+static TraceSink s_sink;
+static std::atomic<bool> s_active(false);
+
+bool VMTracer::active()
+{
+	return s_active.load(memory_order_relaxed);
+}
+
+void VMTracer::open(std::string const& _path)
+{
+	lock_guard<mutex> l(s_sink.x_sink);
+	s_sink.flush();
+	if (s_sink.out.is_open())
+		s_sink.out.close();
+	s_sink.out.open(_path, ios::binary | ios::trunc);
+	if (!s_sink.out)
+	{
+		s_active = false;
+		throw BadVMTrace();
+	}
+	s_sink.buffer = bytes{'E', 'V', 'M', 'T', (byte)c_vmTraceVersion};
+	s_sink.buffer.reserve(c_traceBufferSize);
+	s_active = true;
+}
+
+void VMTracer::close()
+{
+	lock_guard<mutex> l(s_sink.x_sink);
+	s_active = false;
+	s_sink.flush();
+	s_sink.out.close();
+}
+
+void VMTracer::write(bytesConstRef _record)
+{
+	lock_guard<mutex> l(s_sink.x_sink);
+	if (!s_sink.out.is_open())
+		return;
+	s_sink.buffer.insert(s_sink.buffer.end(), _record.begin(), _record.end());
+	if (s_sink.buffer.size() >= c_traceBufferSize)
+		s_sink.flush();
+}
+
+static void putNumber(bytes& _out, uint64_t _n)
+{
+	for (; _n >= 0x80; _n >>= 7)
+		_out.push_back((byte)(_n | 0x80));
+	_out.push_back((byte)_n);
+}
+
+static void putWord(bytes& _out, byte const* _bigEndian)
+{
+	unsigned z = 0;
+	while (z < 32 && !_bigEndian[z])
+		++z;
+	_out.push_back((byte)(32 - z));
+	_out.insert(_out.end(), _bigEndian + z, _bigEndian + 32);
+}
+
+static void putWord(bytes& _out, word256 const& _w)
+{
+	byte b[32];
+	_w.toBigEndian(b);
+	putWord(_out, b);
+}
+
+/// @returns the words each instruction takes from the stack and puts back.
+static std::array<std::pair<byte, byte>, 256> const& stackEffects()
+{
+	static std::array<std::pair<byte, byte>, 256> s_ret = []()
+	{
+		std::array<std::pair<byte, byte>, 256> ret;
+		ret.fill(make_pair(0, 0));
+		for (auto const& i: c_instructionInfo)
+			ret[(byte)i.first] = make_pair((byte)i.second.args, (byte)i.second.ret);
+		return ret;
+	}();
+	return s_ret;
+}
+
+TracedRun::TracedRun(VM const& _vm, Address const& _address, h256 const& _codeHash):
+	m_vm(_vm)
+{
+	m_record.push_back((byte)VMTraceRecord::Enter);
+	putNumber(m_record, m_vm.m_curPC);
+	putWord(m_record, m_vm.m_gas);
+	putNumber(m_record, m_vm.m_stack.size());
+	for (auto const& i: m_vm.m_stack)
+		putWord(m_record, i);
+	putNumber(m_record, m_vm.m_temp.size());
+	m_record += m_vm.m_temp;
+	m_record += _address.asBytes();
+	m_record += _codeHash.asBytes();
+	VMTracer::write(&m_record);
+}
+
+TracedRun::~TracedRun()
+{
+	m_record.clear();
+	m_record.push_back((byte)VMTraceRecord::Exit);
+	m_record.push_back((byte)(!m_pending ? VMTraceExit::Paused : std::uncaught_exception() ? VMTraceExit::Excepted : VMTraceExit::Halted));
+	putWord(m_record, m_vm.m_gas);
+	VMTracer::write(&m_record);
+}
+
+void TracedRun::next(Instruction _op)
+{
+	auto const& s = m_vm.m_stack;
+	m_pending = true;
+	m_op = (byte)_op;
+	m_stackBefore = s.size();
+	m_memoryBefore = m_vm.m_temp.size();
+
+	// Work out now, while we have the arguments, what it might write.
+	m_writeSize = 0;
+	m_storing = false;
+	switch (_op)
+	{
+	case Instruction::MSTORE:
+	case Instruction::MSTORE8:
+		if (s.size() >= 1)
+		{
+			m_writeOffset = (unsigned)s.back();
+			m_writeSize = _op == Instruction::MSTORE ? 32 : 1;
+		}
+		break;
+	case Instruction::CALLDATACOPY:
+	case Instruction::CODECOPY:
+		if (s.size() >= 3)
+		{
+			m_writeOffset = (unsigned)s.back();
+			m_writeSize = (unsigned)s[s.size() - 3];
+		}
+		break;
+	case Instruction::CALL:
+		if (s.size() >= 7)
+		{
+			m_writeOffset = (unsigned)s[s.size() - 6];
+			m_writeSize = (unsigned)s[s.size() - 7];
+		}
+		break;
+	case Instruction::SSTORE:
+		if (s.size() >= 2)
+		{
+			m_storing = true;
+			m_key = (h256)s.back();
+			m_value = (h256)s[s.size() - 2];
+		}
+		break;
+	default:
+		break;
+	}
+
+	m_record.clear();
+	m_record.push_back((byte)VMTraceRecord::Step);
+	putNumber(m_record, m_vm.m_curPC);
+	m_record.push_back(m_op);
+	putWord(m_record, m_vm.m_gas);
+	VMTracer::write(&m_record);
+}
+
+void TracedRun::stepped()
+{
+	m_pending = false;
+	auto const& s = m_vm.m_stack;
+	auto const& mem = m_vm.m_temp;
+
+	size_t pops = stackEffects()[m_op].first;
+	size_t pushes = stackEffects()[m_op].second;
+	if (m_stackBefore < pops || s.size() != m_stackBefore - pops + pushes)
+	{
+		// Not what we expected; say it all.
+		pops = m_stackBefore;
+		pushes = s.size();
+	}
+
+	size_t writeSize = m_writeOffset < mem.size() ? min<size_t>(m_writeSize, mem.size() - m_writeOffset) : 0;
+	byte flags = (mem.size() != m_memoryBefore ? c_memorySize : 0) | (writeSize ? c_memoryWrite : 0) | (m_storing ? c_storageWrite : 0);
+
+	m_record.clear();
+	m_record.push_back((byte)VMTraceRecord::Effects);
+	m_record.push_back(flags);
+	putNumber(m_record, pops);
+	putNumber(m_record, pushes);
+	for (size_t i = s.size() - pushes; i < s.size(); ++i)
+		putWord(m_record, s[i]);
+	if (flags & c_memorySize)
+		putNumber(m_record, mem.size());
+	if (flags & c_memoryWrite)
+	{
+		putNumber(m_record, m_writeOffset);
+		putNumber(m_record, writeSize);
+		m_record.insert(m_record.end(), mem.begin() + m_writeOffset, mem.begin() + m_writeOffset + writeSize);
+	}
+	if (flags & c_storageWrite)
+	{
+		putWord(m_record, m_key.data());
+		putWord(m_record, m_value.data());
+	}
+	VMTracer::write(&m_record);
+}
+
+VMTraceReader::VMTraceReader(bytesConstRef _trace):
+	m_trace(_trace)
+{
+	if (m_trace.size() < 5 || memcmp(m_trace.data(), "EVMT", 4) || m_trace[4] != c_vmTraceVersion)
+		throw BadVMTrace();
+	m_offset = 5;
+}
+
+byte VMTraceReader::readByte()
+{
+	if (m_offset >= m_trace.size())
+		throw BadVMTrace();
+	return m_trace[m_offset++];
+}
+
+uint64_t VMTraceReader::readNumber()
+{
+	uint64_t ret = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		byte b = readByte();
+		ret |= uint64_t(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return ret;
+	}
+	throw BadVMTrace();
+}
+
+bytesConstRef VMTraceReader::readBytes(size_t _n)
+{
+	if (_n > m_trace.size() - m_offset)
+		throw BadVMTrace();
+	m_offset += _n;
+	return m_trace.cropped(m_offset - _n, _n);
+}
+
+u256 VMTraceReader::readWord()
+{
+	byte n = readByte();
+	if (n > 32)
+		throw BadVMTrace();
+	return fromBigEndian<u256>(readBytes(n));
+}
+
+bool VMTraceReader::next()
+{
+	if (m_offset == m_trace.size())
+		return false;
+
+	m_record = (VMTraceRecord)readByte();
+	switch (m_record)
+	{
+	case VMTraceRecord::Enter:
+	{
+		VMTraceFrame f;
+		m_pc = readNumber();
+		m_gas = readWord();
+		f.stack.resize(readNumber());
+		for (auto& i: f.stack)
+			i = readWord();
+		f.memory = readBytes(readNumber()).toBytes();
+		f.address = Address(readBytes(20).toBytes());
+		f.codeHash = h256(readBytes(32).toBytes());
+		m_depth = m_frames.size();
+		m_frames.push_back(std::move(f));
+		break;
+	}
+	case VMTraceRecord::Step:
+		if (m_frames.empty())
+			throw BadVMTrace();
+		m_pc = readNumber();
+		m_op = (Instruction)readByte();
+		m_gas = readWord();
+		m_depth = m_frames.size() - 1;
+		break;
+	case VMTraceRecord::Effects:
+	{
+		if (m_frames.empty())
+			throw BadVMTrace();
+		VMTraceFrame& f = m_frames.back();
+		byte flags = readByte();
+		size_t pops = readNumber();
+		size_t pushes = readNumber();
+		if (pops > f.stack.size())
+			throw BadVMTrace();
+		f.stack.resize(f.stack.size() - pops);
+		for (size_t i = 0; i < pushes; ++i)
+			f.stack.push_back(readWord());
+		if (flags & c_memorySize)
+			f.memory.resize(readNumber());
+		if (flags & c_memoryWrite)
+		{
+			size_t offset = readNumber();
+			bytesConstRef data = readBytes(readNumber());
+			if (offset + data.size() > f.memory.size())
+				throw BadVMTrace();
+			memcpy(f.memory.data() + offset, data.data(), data.size());
+		}
+		if (flags & c_storageWrite)
+		{
+			u256 key = readWord();
+			f.storage[key] = readWord();
+		}
+		m_depth = m_frames.size() - 1;
+		break;
+	}
+	case VMTraceRecord::Exit:
+		if (m_frames.empty())
+			throw BadVMTrace();
+		m_exit = (VMTraceExit)readByte();
+		m_gas = readWord();
+		m_exited = std::move(m_frames.back());
+		m_frames.pop_back();
+		m_depth = m_frames.size();
+		break;
+	default:
+		throw BadVMTrace();
+	}
+	return true;
+}
@@ -0,0 +1,173 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file VMTrace.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ *
+ * Binary VM trace: writing it as the VM runs, and reading it back.
+ *
+ * A trace is the magic "EVMT", a version byte, then records, each a kind byte followed by its fields. Numbers are
+ * LEB128 varints; words are a length byte followed by that many big-endian bytes, leading zeroes dropped.
+ *
+ * Enter:	pc, gas, stack size, stack words (bottom first), memory size, memory, address (20 bytes), code hash (32).
+ *			Starts a run of the VM: a new frame, or a paused one carrying on.
+ * Step:	pc, opcode byte, gas. An instruction starting, with the gas left before its fee.
+ * Effects:	flags, words popped, words pushed, the pushed words; then, by flag, the new memory size, the offset and
+ *			bytes of a memory write, and the key and value of a storage write. What the last Step did, once it's done.
+ * Exit:	how the run ended (VMTraceExit), gas left. The end of the innermost run.
+ *
+ * Runs nest: the records of a CALL's or CREATE's callee come between the caller's Step and its Effects.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <libethsupport/Common.h>
+#include <libethsupport/Exceptions.h>
+#include <libethcore/CommonEth.h>
+#include <libethcore/Instruction.h>
+
+namespace eth
+{
+
+class VM;
+
+class BadVMTrace: public Exception {};
+
+/// The kinds of record in a trace.
+enum class VMTraceRecord: byte { Enter = 1, Step, Effects, Exit };
+
+/// How a run of the VM ended.
+enum class VMTraceExit: byte { Halted = 0, Excepted, Paused };
+
+static const unsigned c_vmTraceVersion = 1;
+
+/**
+ * @brief The trace file, shared by every VM while it's open.
+ * Records are buffered and written out in large chunks. There's one trace, so only trace one thread's execution at a
+ * time; records of VMs running concurrently would interleave.
+ */
+class VMTracer
+{
+public:
+	/// @returns true if a trace is open.
+	static bool active();
+
+	/// Start tracing to the file at @a _path, closing any trace already open. Throws if it can't be written.
+	static void open(std::string const& _path);
+
+	/// Write out anything buffered and stop tracing.
+	static void close();
+
+	/// Append the record @a _record to the trace.
+	static void write(bytesConstRef _record);
+};
+
+/**
+ * @brief Writes the trace of one run of a VM.
+ * The VM calls next() as each instruction starts and stepped() once it's finished; the run's Exit is written when
+ * this goes away.
+ */
+class TracedRun
+{
+public:
+	TracedRun(VM const& _vm, Address const& _address, h256 const& _codeHash);
+	~TracedRun();
+	TracedRun(TracedRun const&) = delete;
+	TracedRun& operator=(TracedRun const&) = delete;
+
+	/// Note that instruction @a _op is starting.
+	void next(Instruction _op);
+
+	/// Note that the instruction last started has finished.
+	void stepped();
+
+private:
+	VM const& m_vm;
+	bytes m_record;					///< Scratch space for building records in.
+	bool m_pending = false;			///< True while an instruction has started but not finished.
+	byte m_op = 0;
+	size_t m_stackBefore = 0;
+	size_t m_memoryBefore = 0;
+	unsigned m_writeOffset = 0;		///< The memory the instruction may write to...
+	unsigned m_writeSize = 0;		///< ...and how much of it.
+	bool m_storing = false;			///< True if the instruction is an SSTORE, of...
+	h256 m_key;						///< ...this key...
+	h256 m_value;					///< ...with this value.
+};
+
+/// A run of the VM, as rebuilt from a trace.
+struct VMTraceFrame
+{
+	Address address;
+	h256 codeHash;
+	u256s stack;
+	bytes memory;
+	std::map<u256, u256> storage;	///< Storage written during the run.
+};
+
+/**
+ * @brief Reads a trace back, rebuilding each run's stack, memory and storage writes as it goes.
+ */
+class VMTraceReader
+{
+public:
+	/// Read the trace @a _trace, which must stay around as long as this. Throws BadVMTrace if it isn't one.
+	explicit VMTraceReader(bytesConstRef _trace);
+
+	/// Read the next record. @returns false at the end of the trace. Throws BadVMTrace if the record is broken.
+	bool next();
+
+	/// @returns the kind of record last read.
+	VMTraceRecord record() const { return m_record; }
+
+	/// @returns the number of runs the last record is nested inside; 0 for the outermost.
+	unsigned depth() const { return m_depth; }
+
+	/// @returns the run the last record was about. After an Exit, that's the run just ended.
+	VMTraceFrame const& frame() const { return m_record == VMTraceRecord::Exit ? m_exited : m_frames.back(); }
+
+	/// @returns where the last Step was and the gas it had; after an Enter, where the run starts and its gas; after an
+	/// Exit, the gas left.
+	size_t pc() const { return m_pc; }
+	Instruction instruction() const { return m_op; }
+	u256 gas() const { return m_gas; }
+
+	/// @returns how the run just ended, after an Exit.
+	VMTraceExit exit() const { return m_exit; }
+
+private:
+	byte readByte();
+	uint64_t readNumber();
+	u256 readWord();
+	bytesConstRef readBytes(size_t _n);
+
+	bytesConstRef m_trace;
+	size_t m_offset = 0;
+
+	std::vector<VMTraceFrame> m_frames;
+	VMTraceFrame m_exited;
+	VMTraceRecord m_record = VMTraceRecord::Enter;
+	unsigned m_depth = 0;
+	size_t m_pc = 0;
+	Instruction m_op = Instruction::STOP;
+	u256 m_gas;
+	VMTraceExit m_exit = VMTraceExit::Halted;
+};
+
+}
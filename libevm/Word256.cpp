@@ -0,0 +1,146 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Word256.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#include "Word256.h"
+
+using namespace std;
+using namespace eth;
+
+#if ETH_WORD256_INT128
+
+using u128 = unsigned __int128;
+
+static unsigned significantLimbs(std::array<uint64_t, 4> const& _l)
+{
+	unsigned ret = 4;
+	while (ret && !_l[ret - 1])
+		--ret;
+	return ret;
+}
+
+static unsigned leadingZeros(uint64_t _v)
+{
+	unsigned ret = 0;
+	for (; !(_v & (uint64_t(1) << 63)); _v <<= 1)
+		++ret;
+	return ret;
+}
+
+void word256::divmodSlow(word256 const& _a, word256 const& _b, word256& o_q, word256& o_r)
+{
+	unsigned m = significantLimbs(_a.m_limbs);
+	unsigned n = significantLimbs(_b.m_limbs);
+	word256 q;
+	word256 r;
+
+	if (n == 1)
+	{
+		// Short division by a single limb.
+		uint64_t d = _b.m_limbs[0];
+		u128 rem = 0;
+		for (unsigned i = m; i--;)
+		{
+			rem = (rem << 64) | _a.m_limbs[i];
+			q.m_limbs[i] = (uint64_t)(rem / d);
+			rem %= d;
+		}
+		r.m_limbs[0] = (uint64_t)rem;
+	}
+	else
+	{
+		// Knuth's algorithm D (TAOCP vol. 2, 4.3.1) on 64-bit digits.
+		// Normalise so the divisor's top digit has its top bit set.
+		unsigned s = leadingZeros(_b.m_limbs[n - 1]);
+		uint64_t vn[4];
+		uint64_t un[5];
+		for (unsigned i = n - 1; i > 0; --i)
+			vn[i] = (_b.m_limbs[i] << s) | (s ? _b.m_limbs[i - 1] >> (64 - s) : 0);
+		vn[0] = _b.m_limbs[0] << s;
+		un[m] = s ? _a.m_limbs[m - 1] >> (64 - s) : 0;
+		for (unsigned i = m - 1; i > 0; --i)
+			un[i] = (_a.m_limbs[i] << s) | (s ? _a.m_limbs[i - 1] >> (64 - s) : 0);
+		un[0] = _a.m_limbs[0] << s;
+
+		for (unsigned j = m - n + 1; j--;)
+		{
+			// Estimate the quotient digit from the top two digits and refine it with the third.
+			u128 num = ((u128)un[j + n] << 64) | un[j + n - 1];
+			u128 qhat = num / vn[n - 1];
+			u128 rhat = num % vn[n - 1];
+			while ((qhat >> 64) || qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2]))
+			{
+				--qhat;
+				rhat += vn[n - 1];
+				if (rhat >> 64)
+					break;
+			}
+
+			// Multiply and subtract.
+			uint64_t borrow = 0;
+			for (unsigned i = 0; i < n; ++i)
+			{
+				u128 p = qhat * vn[i];
+				uint64_t lo = (uint64_t)p;
+				uint64_t t = un[i + j] - lo;
+				uint64_t b = un[i + j] < lo;
+				un[i + j] = t - borrow;
+				borrow = (uint64_t)(p >> 64) + b + (t < borrow);
+			}
+			bool negative = un[j + n] < borrow;
+			un[j + n] -= borrow;
+
+			q.m_limbs[j] = (uint64_t)qhat;
+			if (negative)
+			{
+				// Estimate was one too many; add the divisor back.
+				--q.m_limbs[j];
+				uint64_t carry = 0;
+				for (unsigned i = 0; i < n; ++i)
+				{
+					u128 t = (u128)un[i + j] + vn[i] + carry;
+					un[i + j] = (uint64_t)t;
+					carry = (uint64_t)(t >> 64);
+				}
+				un[j + n] += carry;
+			}
+		}
+
+		// Denormalise the remainder.
+		for (unsigned i = 0; i < n; ++i)
+			r.m_limbs[i] = (un[i] >> s) | (s ? un[i + 1] << (64 - s) : 0);
+	}
+
+	o_q = q;
+	o_r = r;
+}
+
+#else
+
+void word256::divmodSlow(word256 const& _a, word256 const& _b, word256& o_q, word256& o_r)
+{
+	// No 128-bit arithmetic to build on; let the multiprecision library do it.
+	u256 a = (u256)_a;
+	u256 b = (u256)_b;
+	o_q = word256(a / b);
+	o_r = word256(a % b);
+}
+
+#endif
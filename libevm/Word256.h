@@ -0,0 +1,277 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Word256.h
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ */
+
+#pragma once
+
+#include <array>
+#include <libethsupport/Common.h>
+#include <libethsupport/FixedHash.h>
+
+namespace eth
+{
+
+#if defined(__SIZEOF_INT128__)
+#define ETH_WORD256_INT128 1
+#endif
+
+/**
+ * @brief A 256-bit unsigned machine word, as used on the VM stack.
+ * Four 64-bit limbs, least significant first. All arithmetic is modulo 2^256, so it behaves exactly as u256,
+ * to and from which it converts losslessly; it just doesn't go through the generic multiprecision code.
+ * The signed operations (sdiv(), smod(), slt(), sgt()) treat the word as two's complement.
+ */
+class word256
+{
+public:
+	/// Construct from a native integer; zero by default.
+	word256(uint64_t _v = 0): m_limbs{{_v, 0, 0, 0}} {}
+
+	/// Convert from u256.
+	explicit word256(u256 const& _u) { u256 u = _u; for (auto& l: m_limbs) { l = (uint64_t)u; u >>= 64; } }
+
+	/// Convert from a hash, treating it as big-endian.
+	explicit word256(h256 const& _h) { *this = fromBigEndian(_h.data()); }
+
+	/// @returns the word held big-endian in the 32 bytes at @a _p.
+	static word256 fromBigEndian(byte const* _p)
+	{
+		word256 ret;
+		for (unsigned i = 0; i < 4; ++i)
+			for (unsigned j = 0; j < 8; ++j)
+				ret.m_limbs[3 - i] = (ret.m_limbs[3 - i] << 8) | _p[i * 8 + j];
+		return ret;
+	}
+
+	/// Write the word big-endian into the 32 bytes at @a _p.
+	void toBigEndian(byte* _p) const
+	{
+		for (unsigned i = 0; i < 4; ++i)
+			for (unsigned j = 0; j < 8; ++j)
+				_p[i * 8 + j] = (byte)(m_limbs[3 - i] >> (56 - 8 * j));
+	}
+
+	/// Convert to u256.
+	explicit operator u256() const { u256 ret = m_limbs[3]; for (unsigned i = 3; i--;) ret = (ret << 64) | m_limbs[i]; return ret; }
+
+	/// Convert to a big-endian hash.
+	explicit operator h256() const { h256 ret; toBigEndian(ret.data()); return ret; }
+
+	/// @returns true iff non-zero.
+	explicit operator bool() const { return m_limbs[0] | m_limbs[1] | m_limbs[2] | m_limbs[3]; }
+
+	/// @returns the low 32 bits, just as (unsigned) does for u256.
+	explicit operator unsigned() const { return (unsigned)m_limbs[0]; }
+
+	/// @returns true iff the value fits in 64 bits.
+	bool fitsIn64() const { return !(m_limbs[1] | m_limbs[2] | m_limbs[3]); }
+
+	/// @returns the low 64 bits.
+	uint64_t low64() const { return m_limbs[0]; }
+
+	/// @returns the limbs, least significant first.
+	std::array<uint64_t, 4> const& limbs() const { return m_limbs; }
+
+	bool operator==(word256 const& _c) const { return m_limbs == _c.m_limbs; }
+	bool operator!=(word256 const& _c) const { return m_limbs != _c.m_limbs; }
+	bool operator<(word256 const& _c) const { for (unsigned i = 4; i--;) if (m_limbs[i] != _c.m_limbs[i]) return m_limbs[i] < _c.m_limbs[i]; return false; }
+	bool operator>(word256 const& _c) const { return _c < *this; }
+	bool operator<=(word256 const& _c) const { return !(_c < *this); }
+	bool operator>=(word256 const& _c) const { return !(*this < _c); }
+
+	word256& operator&=(word256 const& _c) { for (unsigned i = 0; i < 4; ++i) m_limbs[i] &= _c.m_limbs[i]; return *this; }
+	word256& operator|=(word256 const& _c) { for (unsigned i = 0; i < 4; ++i) m_limbs[i] |= _c.m_limbs[i]; return *this; }
+	word256& operator^=(word256 const& _c) { for (unsigned i = 0; i < 4; ++i) m_limbs[i] ^= _c.m_limbs[i]; return *this; }
+	word256 operator~() const { word256 ret; for (unsigned i = 0; i < 4; ++i) ret.m_limbs[i] = ~m_limbs[i]; return ret; }
+
+	word256& operator+=(word256 const& _c)
+	{
+		uint64_t carry = 0;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			uint64_t s = m_limbs[i] + carry;
+			carry = s < carry;
+			m_limbs[i] = s + _c.m_limbs[i];
+			carry += m_limbs[i] < s;
+		}
+		return *this;
+	}
+
+	word256& operator-=(word256 const& _c)
+	{
+		uint64_t borrow = 0;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			uint64_t d = m_limbs[i] - _c.m_limbs[i];
+			uint64_t b = m_limbs[i] < _c.m_limbs[i];
+			m_limbs[i] = d - borrow;
+			borrow = b | (d < borrow);
+		}
+		return *this;
+	}
+
+	word256 operator-() const { return word256() -= *this; }
+
+	word256& operator*=(word256 const& _c)
+	{
+		word256 ret;
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			uint64_t carry = 0;
+			for (unsigned j = 0; i + j < 4; ++j)
+			{
+				uint64_t hi;
+				uint64_t lo = mul64(m_limbs[i], _c.m_limbs[j], hi);
+				lo += carry;
+				hi += lo < carry;
+				ret.m_limbs[i + j] += lo;
+				hi += ret.m_limbs[i + j] < lo;
+				carry = hi;
+			}
+		}
+		return *this = ret;
+	}
+
+	word256& operator<<=(unsigned _n)
+	{
+		if (_n >= 256)
+			return *this = word256();
+		unsigned l = _n / 64;
+		unsigned b = _n % 64;
+		for (unsigned i = 4; i--;)
+			m_limbs[i] = (i >= l ? m_limbs[i - l] << b : 0) | (b && i > l ? m_limbs[i - l - 1] >> (64 - b) : 0);
+		return *this;
+	}
+
+	word256& operator>>=(unsigned _n)
+	{
+		if (_n >= 256)
+			return *this = word256();
+		unsigned l = _n / 64;
+		unsigned b = _n % 64;
+		for (unsigned i = 0; i < 4; ++i)
+			m_limbs[i] = (i + l < 4 ? m_limbs[i + l] >> b : 0) | (b && i + l + 1 < 4 ? m_limbs[i + l + 1] << (64 - b) : 0);
+		return *this;
+	}
+
+	/// @returns true iff the top (sign) bit is set.
+	bool isNegative() const { return m_limbs[3] >> 63; }
+
+	/// Divide @a _a by @a _b, which must be non-zero.
+	/// @a o_q and @a o_r may alias the operands.
+	static void divmod(word256 const& _a, word256 const& _b, word256& o_q, word256& o_r)
+	{
+		if (_a < _b)
+		{
+			o_r = _a;
+			o_q = word256();
+		}
+		else if (_a.fitsIn64())
+		{
+			uint64_t a = _a.m_limbs[0];
+			uint64_t b = _b.m_limbs[0];
+			o_q = a / b;
+			o_r = a % b;
+		}
+		else
+			divmodSlow(_a, _b, o_q, o_r);
+	}
+
+	word256& operator/=(word256 const& _c) { word256 r; divmod(*this, _c, *this, r); return *this; }
+	word256& operator%=(word256 const& _c) { word256 q; divmod(*this, _c, q, *this); return *this; }
+
+	/// @returns the full 128-bit product of @a _a and @a _b; the low half is returned and the high half put in @a o_hi.
+	static uint64_t mul64(uint64_t _a, uint64_t _b, uint64_t& o_hi)
+	{
+#if ETH_WORD256_INT128
+		unsigned __int128 p = (unsigned __int128)_a * _b;
+		o_hi = (uint64_t)(p >> 64);
+		return (uint64_t)p;
+#else
+		uint64_t al = (uint32_t)_a, ah = _a >> 32, bl = (uint32_t)_b, bh = _b >> 32;
+		uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+		uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+		o_hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+		return (mid << 32) | (uint32_t)ll;
+#endif
+	}
+
+private:
+	/// The general case of divmod(), for dividends that don't fit in 64 bits.
+	static void divmodSlow(word256 const& _a, word256 const& _b, word256& o_q, word256& o_r);
+
+	std::array<uint64_t, 4> m_limbs;
+};
+
+using word256s = std::vector<word256>;
+
+inline word256 operator+(word256 const& _a, word256 const& _b) { return word256(_a) += _b; }
+inline word256 operator-(word256 const& _a, word256 const& _b) { return word256(_a) -= _b; }
+inline word256 operator*(word256 const& _a, word256 const& _b) { return word256(_a) *= _b; }
+inline word256 operator/(word256 const& _a, word256 const& _b) { return word256(_a) /= _b; }
+inline word256 operator%(word256 const& _a, word256 const& _b) { return word256(_a) %= _b; }
+inline word256 operator&(word256 const& _a, word256 const& _b) { return word256(_a) &= _b; }
+inline word256 operator|(word256 const& _a, word256 const& _b) { return word256(_a) |= _b; }
+inline word256 operator^(word256 const& _a, word256 const& _b) { return word256(_a) ^= _b; }
+inline word256 operator<<(word256 const& _a, unsigned _n) { return word256(_a) <<= _n; }
+inline word256 operator>>(word256 const& _a, unsigned _n) { return word256(_a) >>= _n; }
+
+/// @returns @a _b raised to the power @a _e, modulo 2^256.
+inline word256 pow(word256 _b, unsigned _e)
+{
+	word256 ret = 1;
+	for (; _e; _e >>= 1, _b *= _b)
+		if (_e & 1)
+			ret *= _b;
+	return ret;
+}
+
+/// Signed division, rounding towards zero. @a _b must be non-zero.
+inline word256 sdiv(word256 const& _a, word256 const& _b)
+{
+	word256 q = (_a.isNegative() ? -_a : _a) / (_b.isNegative() ? -_b : _b);
+	return _a.isNegative() != _b.isNegative() ? -q : q;
+}
+
+/// Signed remainder, taking the sign of @a _a. @a _b must be non-zero.
+inline word256 smod(word256 const& _a, word256 const& _b)
+{
+	word256 r = (_a.isNegative() ? -_a : _a) % (_b.isNegative() ? -_b : _b);
+	return _a.isNegative() ? -r : r;
+}
+
+/// Signed less-than.
+inline bool slt(word256 const& _a, word256 const& _b)
+{
+	return _a.isNegative() != _b.isNegative() ? _a.isNegative() : _a < _b;
+}
+
+/// Signed greater-than.
+inline bool sgt(word256 const& _a, word256 const& _b)
+{
+	return slt(_b, _a);
+}
+
+inline std::ostream& operator<<(std::ostream& _out, word256 const& _w)
+{
+	return _out << (u256)_w;
+}
+
+}
@@ -22,6 +22,8 @@
 #include <thread>
 #include <chrono>
 #include <libethereum/Client.h>
+#include <libethereum/BlockChain.h>
+#include <libethereum/State.h>
 #include "TestHelper.h"
 
 namespace eth
@@ -46,4 +48,35 @@ void connectClients(Client& c1, Client& c2)
 	c2.connect("127.0.0.1", c1Port);
 }
 
+bool mineQuickly()
+{
+	c_genesisDifficulty = 1 << 4;
+	return BlockChain::genesis().difficulty == c_genesisDifficulty;
+}
+
+Transaction signedTransaction(KeyPair const& _from, u256 _nonce, Address _to, u256 _value, bytes const& _data)
+{
+	Transaction t;
+	t.nonce = _nonce;
+	t.value = _value;
+	t.receiveAddress = _to;
+	t.gasPrice = 10 * szabo;
+	t.gas = 10000;
+	t.data = _data;
+	t.sign(_from.secret());
+	return t;
+}
+
+h256 mineBlock(BlockChain& _bc, OverlayDB const& _db, Address _coinbase, h256 _parent, Transactions const& _txs)
+{
+	State s(_coinbase, _db);
+	s.sync(_bc, _parent ? _parent : _bc.currentHash());
+	for (auto const& t: _txs)
+		s.execute(t);
+	s.commitToMine(_bc);
+	while (!s.mine(100).completed) {}
+	_bc.import(s.blockData(), _db);
+	return sha3(s.blockData());
+}
+
 }
@@ -21,10 +21,27 @@
 
 #pragma once
 
+#include <libethereum/Transaction.h>
+
 namespace eth
 {
 
+class BlockChain;
+class Client;
+class OverlayDB;
+
 void mine(Client& c, int numBlocks);
 void connectClients(Client& c1, Client& c2);
 
+/// Have the chain start out at so low a difficulty that mining is all but instant. Call before anything has asked for
+/// the genesis block; @returns false should that be too late.
+bool mineQuickly();
+
+/// @returns a transaction from @a _from, with plenty of gas at a low price.
+Transaction signedTransaction(KeyPair const& _from, u256 _nonce, Address _to, u256 _value, bytes const& _data = bytes());
+
+/// Mine a block paying @a _coinbase, with @a _txs, on @a _parent (or the best block if null) and import it into @a _bc.
+/// @returns its hash.
+h256 mineBlock(BlockChain& _bc, OverlayDB const& _db, Address _coinbase, h256 _parent = h256(), Transactions const& _txs = Transactions());
+
 }
@@ -0,0 +1,85 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file blockChain.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * BlockChain tests: checkpoints are found again on reopening, and bound how far back a sync plays.
+ */
+
+#include <memory>
+#include <boost/filesystem/operations.hpp>
+#include <libethereum/BlockChain.h>
+#include <libethereum/State.h>
+#include <libethereum/StatePruner.h>
+#include <boost/test/unit_test.hpp>
+#include "TestHelper.h"
+
+using namespace std;
+using namespace eth;
+
+BOOST_AUTO_TEST_CASE(block_chain_checkpoints)
+{
+	BOOST_REQUIRE(mineQuickly());
+	string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	OverlayDB stateDB = State::openDB(path);
+	unique_ptr<BlockChain> bc(new BlockChain(path, false, 4));
+
+	// Two branches forking after the first block, each with a checkpoint at four. The shorter one's uncle makes up for
+	// a block, so it's a block more than that which takes it over.
+	Address alice = right160(sha3("alice"));
+	Address bob = right160(sha3("bob"));
+	vector<h256> a = { bc->genesisHash() };
+	for (unsigned i = 1; i <= 8; ++i)
+		a.push_back(mineBlock(*bc, stateDB, alice));
+	vector<h256> b = { a[0], a[1] };
+	for (unsigned i = 2; i <= 7; ++i)
+		b.push_back(mineBlock(*bc, stateDB, bob, b.back()));
+	BOOST_REQUIRE(bc->currentHash() == a[8]);
+
+	map<h256, h256> checkpoints;
+	for (h256 h: { a[0], a[4], a[8], b[4] })
+		checkpoints[h] = BlockInfo(bc->block(h)).stateRoot;
+	BOOST_CHECK(bc->checkpoints() == checkpoints);
+
+	// Opened again, it finds them all by going through its DB.
+	bc.reset();
+	bc.reset(new BlockChain(path, false, 4));
+	BOOST_CHECK(bc->checkpoints() == checkpoints);
+	BOOST_REQUIRE(bc->currentHash() == a[8]);
+
+	// Keep just the last two blocks' states (and the checkpoints'); going over to the other branch then plays back
+	// from its checkpoint, no further.
+	StatePruner pruner(stateDB, 2);
+	pruner.prune(*bc);
+	BOOST_REQUIRE(stateDB.lookup(BlockInfo(bc->block(b[7])).stateRoot).empty());
+
+	State s(Address(), stateDB);
+	s.sync(*bc, b[7]);
+	BOOST_CHECK_EQUAL(State::replayStats().last, 3u);
+	BOOST_CHECK(s.rootHash() == BlockInfo(bc->block(b[7])).stateRoot);
+
+	// Once more, with the other branch overtaking: each sync on the way plays back no more than that.
+	pruner.prune(*bc);
+	BOOST_REQUIRE(stateDB.lookup(BlockInfo(bc->block(b[7])).stateRoot).empty());
+	ReplayStats before = State::replayStats();
+	h256 head = mineBlock(*bc, stateDB, bob, b[7]);
+	ReplayStats after = State::replayStats();
+	BOOST_CHECK(bc->currentHash() == head);
+	BOOST_REQUIRE(after.syncs > before.syncs);
+	BOOST_CHECK(after.last <= 3);
+	BOOST_CHECK(after.blocks - before.blocks <= 3 * (after.syncs - before.syncs));
+}
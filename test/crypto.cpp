@@ -25,7 +25,9 @@
 #include <libethsupport/Common.h>
 #include <libethsupport/RLP.h>
 #include <libethsupport/Log.h>
+#include <libethcore/Exceptions.h>
 #include <libethereum/Transaction.h>
+#include <libevm/SHA3Cache.h>
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
@@ -151,3 +153,72 @@ int cryptoTest()
 	return 0;
 }
 
+BOOST_AUTO_TEST_CASE(sha3_cache_tests)
+{
+	cnote << "Testing SHA3 cache...";
+	SHA3Cache& c = SHA3Cache::thread();
+	c.clear();
+
+	// A few keys, looked up again and again, with lookalikes of the same contents but different sizes.
+	mt19937 eng(1);
+	vector<bytes> keys;
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		bytes k(eng() % (c_sha3CacheMaxInput + 1));
+		for (auto& b: k)
+			b = eng() % 3;
+		keys.push_back(k);
+		keys.push_back(bytes(k.size() + 1));
+	}
+	keys.push_back(bytes(c_sha3CacheMaxInput + 1, 1));
+	for (unsigned i = 0; i < 4000; ++i)
+	{
+		bytes const& k = keys[eng() % keys.size()];
+		BOOST_REQUIRE(c(&k) == sha3(k));
+	}
+	BOOST_CHECK(c.hits() > c.misses());
+
+	uint64_t hits = SHA3Cache::totalHits() + c.hits();
+	c.clear();
+	BOOST_CHECK(!c.hits() && !c.misses());
+	BOOST_CHECK(SHA3Cache::totalHits() == hits);
+	BOOST_CHECK(c(&keys[0]) == sha3(keys[0]) && c.misses() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(recover_senders_tests)
+{
+	cnote << "Testing parallel sender recovery...";
+	secp256k1_start();
+
+	vector<KeyPair> keys;
+	for (unsigned i = 0; i < 4; ++i)
+		keys.push_back(KeyPair(sha3("recover " + toString(i))));
+
+	Transactions ts;
+	for (unsigned i = 0; i < 40; ++i)
+	{
+		Transaction t;
+		t.nonce = i;
+		t.value = i * 1000;
+		t.receiveAddress = keys[(i + 1) % keys.size()].address();
+		t.sign(keys[i % keys.size()].secret());
+		// Decode it again, so nothing's been recovered yet.
+		ts.push_back(Transaction(t.rlp()));
+	}
+	ts[7].vrs.s = 0;
+
+	ThreadPool pool(2);
+	recoverSenders(ts, pool);
+	for (unsigned i = 0; i < ts.size(); ++i)
+		if (i == 7)
+			BOOST_CHECK_THROW(ts[i].sender(), InvalidSignature);
+		else
+			BOOST_CHECK(ts[i].sender() == keys[i % keys.size()].address());
+
+	// A copy changed since its sender was recovered no longer has that sender.
+	Transaction u = ts[0];
+	u.nonce++;
+	BOOST_CHECK(u.safeSender() != ts[0].sender());
+	u.nonce--;
+	BOOST_CHECK(u.sender() == ts[0].sender());
+}
@@ -0,0 +1,90 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file flatHashMap.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * Open-addressing hash map tests, checked against std::map.
+ */
+
+#include <map>
+#include <random>
+#include <libethsupport/Log.h>
+#include <libethsupport/FlatHashMap.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace eth;
+
+BOOST_AUTO_TEST_CASE(flat_hash_map_tests)
+{
+	cnote << "Testing FlatHashMap...";
+	mt19937_64 eng(1);
+	FlatHashMap<u256, u256, U256Hash> m;
+	map<u256, u256> ref;
+	for (unsigned t = 0; t < 50000; ++t)
+	{
+		// Small keys, so there's plenty of hitting, erasing and reinserting.
+		u256 k = eng() % 600;
+		if (eng() % 8 == 0)
+			k = (k << 200) | k;
+		switch (eng() % 4)
+		{
+		case 0:
+			BOOST_REQUIRE_EQUAL(m.erase(k), ref.erase(k));
+			break;
+		case 1:
+			BOOST_REQUIRE(m.insert(make_pair(k, u256(t))).second == ref.insert(make_pair(k, u256(t))).second);
+			break;
+		case 2:
+			m[k] = ref[k] = t;
+			break;
+		default:
+			BOOST_REQUIRE_EQUAL(m.count(k), ref.count(k));
+			if (ref.count(k))
+				BOOST_REQUIRE(m.at(k) == ref.at(k));
+			break;
+		}
+		BOOST_REQUIRE_EQUAL(m.size(), ref.size());
+	}
+
+	auto s = m.sorted();
+	BOOST_REQUIRE_EQUAL(s.size(), ref.size());
+	auto it = ref.begin();
+	for (auto i: s)
+	{
+		BOOST_CHECK(i->first == it->first && i->second == it->second);
+		++it;
+	}
+
+	m.clear();
+	BOOST_CHECK(m.empty() && m.begin() == m.end() && !m.count(0));
+}
+
+BOOST_AUTO_TEST_CASE(flat_hash_map_stable)
+{
+	cnote << "Testing FlatHashMap keeps entries put when they're only looked up...";
+	FlatHashMap<u256, u256, U256Hash> m;
+	for (unsigned n = 1; n < 200; ++n)
+	{
+		m[n] = n;
+		// However full it is, looking up what's there doesn't move it.
+		u256* first = &m.find(1)->second;
+		for (unsigned i = 1; i <= n; ++i)
+			BOOST_REQUIRE(m[i] == i && m.insert(make_pair(u256(i), u256(0))).second == false);
+		BOOST_REQUIRE(first == &m[1]);
+	}
+}
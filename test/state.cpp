@@ -20,11 +20,14 @@
  * State test functions.
  */
 
+#include <boost/test/unit_test.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <secp256k1/secp256k1.h>
+#include <liblll/Compiler.h>
 #include <libethereum/BlockChain.h>
 #include <libethereum/State.h>
 #include <libethereum/Defaults.h>
+#include "TestHelper.h"
 using namespace std;
 using namespace eth;
 
@@ -89,3 +92,68 @@ int stateTest()
 	return 0;
 }
 
+BOOST_AUTO_TEST_CASE(speculative_playback)
+{
+	BOOST_REQUIRE(mineQuickly());
+	string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	OverlayDB stateDB = State::openDB(path);
+	BlockChain bc(path);
+	secp256k1_start();
+
+	KeyPair alice = sha3("alice");
+	KeyPair bob = sha3("bob");
+	KeyPair carol = sha3("carol");
+	KeyPair dave = sha3("dave");
+	KeyPair erin = sha3("erin");
+	Address miner = KeyPair(sha3("miner")).address();
+	Address fresh = KeyPair(sha3("fresh")).address();
+	Address other = KeyPair(sha3("other")).address();
+
+	for (auto const& k: { alice, bob, carol, dave, erin })
+		mineBlock(bc, stateDB, k.address());
+
+	// One contract adds to a storage slot, another notes the coinbase's balance, the last passes on what it's sent.
+	Address counter = right160(sha3(rlpList(alice.address(), 0)));
+	Address watcher = right160(sha3(rlpList(alice.address(), 1)));
+	Address payer = right160(sha3(rlpList(alice.address(), 2)));
+	mineBlock(bc, stateDB, miner, h256(), Transactions{
+		signedTransaction(alice, 0, Address(), 0, compileLLL("(return 0 (lll (sstore 0 (+ (sload 0) (calldataload 0))) 0))")),
+		signedTransaction(alice, 1, Address(), 0, compileLLL("(return 0 (lll (sstore 0 (balance (coinbase))) 0))")),
+		signedTransaction(alice, 2, Address(), 0, compileLLL("(return 0 (lll (call (- (gas) 100) (calldataload 0) (callvalue) 0 0 0 0) 0))"))
+	});
+
+	// Each after the first has to see what one before it did, and just the one thing: the same storage slot, an account
+	// come into being by a CALL, the coinbase's balance, the same sender.
+	h256 h = mineBlock(bc, stateDB, miner, h256(), Transactions{
+		signedTransaction(alice, 3, counter, 0, h256(u256(1)).asBytes()),
+		signedTransaction(bob, 0, counter, 0, h256(u256(2)).asBytes()),
+		signedTransaction(carol, 0, payer, 1000, h256((u256)(u160)fresh).asBytes()),
+		signedTransaction(dave, 0, fresh, 500),
+		signedTransaction(erin, 0, watcher, 0),
+		signedTransaction(alice, 4, other, 100)
+	});
+	BOOST_REQUIRE(bc.currentHash() == h);
+
+	bytes block = bc.block(h).toBytes();
+	BlockInfo bi(&block);
+	BlockInfo parent(bc.block(bi.parentHash));
+	BlockInfo grandParent(bc.block(parent.parentHash));
+	auto playback = [&](ThreadPool& _pool)
+	{
+		State s(Address(), stateDB);
+		s.setSpeculationPool(_pool);
+		s.sync(bc, bi.parentHash);
+		s.playback(&block, bi, parent, grandParent, true);
+		return s;
+	};
+
+	ThreadPool inTurn(0);
+	ThreadPool speculative(3);
+	State a = playback(inTurn);
+	State b = playback(speculative);
+	BOOST_CHECK(a.rootHash() == bi.stateRoot);
+	BOOST_CHECK(b.rootHash() == a.rootHash());
+	BOOST_CHECK(a.diff(b).accounts.empty());
+	BOOST_CHECK(a.storage(counter, 0) == 3);
+	BOOST_CHECK(a.balance(fresh) == 1500);
+}
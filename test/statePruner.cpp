@@ -0,0 +1,138 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file statePruner.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * StatePruner tests: the states kept can still be read in full, and nothing else is left.
+ */
+
+#include <boost/filesystem/operations.hpp>
+#include <secp256k1/secp256k1.h>
+#include <liblll/Compiler.h>
+#include <libethereum/BlockChain.h>
+#include <libethereum/State.h>
+#include <libethereum/StatePruner.h>
+#include <boost/test/unit_test.hpp>
+#include "TestHelper.h"
+
+using namespace std;
+using namespace eth;
+
+/// Read every node of the state trie at @a _root, its accounts' storage tries and their code, just as the DB has them
+/// (not as the node cache remembers them), erasing each from @a io_keys. Throws should any be missing.
+static void readState(OverlayDB& _db, h256 _root, set<h256>& io_keys)
+{
+	EnforceRefs e(_db, true);
+	GenericTrieDB<OverlayDB> state(&_db, _root);
+	state.descendKey(_root, io_keys, false, nullptr);
+	for (auto const& i: state)
+	{
+		RLP account(i.second);
+		h256 storageRoot = account[2].toHash<h256>();
+		if (storageRoot && storageRoot != c_shaNull)
+		{
+			GenericTrieDB<OverlayDB> storage(&_db, storageRoot);
+			storage.descendKey(storageRoot, io_keys, false, nullptr);
+			unsigned slots = 0;
+			for (auto const& j: storage)
+				slots += !RLP(j.second).isEmpty();
+			BOOST_CHECK(slots > 0);
+		}
+		h256 codeHash = account[3].toHash<h256>();
+		if (codeHash != EmptySHA3)
+		{
+			BOOST_REQUIRE(!_db.lookup(codeHash).empty());
+			io_keys.erase(codeHash);
+		}
+	}
+}
+
+/// @returns the keys of every node in the state DB @a _db.
+static set<h256> stateKeys(OverlayDB const& _db)
+{
+	set<h256> ret;
+	unique_ptr<ldb::Iterator> it(_db.db()->NewIterator(ldb::ReadOptions()));
+	for (it->SeekToFirst(); it->Valid(); it->Next())
+		if (it->key().size() == 32)
+			ret.insert(h256((byte const*)it->key().data(), h256::ConstructFromPointer));
+	return ret;
+}
+
+static h256 stateRoot(BlockChain const& _bc, h256 _block)
+{
+	return BlockInfo(_bc.block(_block)).stateRoot;
+}
+
+BOOST_AUTO_TEST_CASE(state_pruner)
+{
+	BOOST_REQUIRE(mineQuickly());
+	string path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+	OverlayDB stateDB = State::openDB(path);
+	BlockChain bc(path);
+	secp256k1_start();
+
+	KeyPair alice = sha3("alice");
+	Address bob = KeyPair(sha3("bob")).address();
+	Address store = right160(sha3(rlpList(alice.address(), 0)));
+	auto setSlot = [&](u256 _nonce, u256 _value) { return signedTransaction(alice, _nonce, store, 0, h256(_value).asBytes()); };
+
+	// The main branch changes the one slot of a contract at each block; the other branch, forking off within the last
+	// few blocks, changes it too and brings in code of its own.
+	vector<h256> a = { bc.genesisHash(), mineBlock(bc, stateDB, alice.address()) };
+	a.push_back(mineBlock(bc, stateDB, alice.address(), h256(), Transactions{ signedTransaction(alice, 0, Address(), 0, compileLLL("(return 0 (lll (sstore 0 (calldataload 0)) 0))")) }));
+	for (unsigned i = 3; i <= 8; ++i)
+		a.push_back(mineBlock(bc, stateDB, alice.address(), h256(), Transactions{ setSlot(i - 2, i) }));
+	Address branchOnly = right160(sha3(rlpList(alice.address(), 4)));
+	vector<h256> b = { mineBlock(bc, stateDB, bob, a[5], Transactions{ signedTransaction(alice, 4, Address(), 0, compileLLL("(return 0 (lll (sstore 1 (calldataload 0)) 0))")), setSlot(5, 106) }) };
+	b.push_back(mineBlock(bc, stateDB, bob, b[0], Transactions{ setSlot(6, 107) }));
+	BOOST_REQUIRE(bc.currentHash() == a[8]);
+
+	State s(Address(), stateDB);
+	s.sync(bc, b[1]);
+	h256 branchCode = s.codeHash(branchOnly);
+	BOOST_REQUIRE(branchCode != EmptySHA3);
+
+	// A whole pass keeps the last four blocks' states, both branches of them, and the genesis; nothing else is left.
+	StatePruner pruner(stateDB, 4, 4);
+	pruner.prune(bc);
+	BOOST_CHECK_EQUAL(pruner.passes(), 1u);
+	set<h256> left = stateKeys(stateDB);
+	for (h256 h: { a[0], a[4], a[5], a[6], a[7], a[8], b[0], b[1] })
+		BOOST_CHECK_NO_THROW(readState(stateDB, stateRoot(bc, h), left));
+	BOOST_CHECK(left.empty());
+	for (h256 h: { a[1], a[2], a[3] })
+		BOOST_CHECK(stateDB.lookup(stateRoot(bc, h)).empty());
+
+	// A pass in the background, with blocks coming in meanwhile. Once it's under way, the slot goes back to a value it
+	// had only in a state no longer kept, so a storage root the pass finds unused is written anew.
+	for (unsigned i = 9; pruner.passes() < 2; ++i)
+	{
+		BOOST_REQUIRE(i < 1000);
+		a.push_back(mineBlock(bc, stateDB, alice.address(), h256(), Transactions{ setSlot(i - 2, i <= 12 ? i : 5) }));
+		pruner.noteChain(bc);
+	}
+	BOOST_REQUIRE(a.size() > 13);
+
+	left = stateKeys(stateDB);
+	for (unsigned i = a.size() - 5; i < a.size(); ++i)
+		BOOST_CHECK_NO_THROW(readState(stateDB, stateRoot(bc, a[i]), left));
+	BOOST_CHECK_NO_THROW(readState(stateDB, stateRoot(bc, a[0]), left));
+	for (h256 h: { a[4], a[5], a[6], a[7], b[0], b[1] })
+		BOOST_CHECK(stateDB.lookup(stateRoot(bc, h)).empty());
+	BOOST_CHECK(stateDB.lookup(branchCode).empty());
+	BOOST_CHECK(pruner.pruned() > 0);
+}
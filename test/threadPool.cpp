@@ -0,0 +1,62 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file threadPool.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * ThreadPool tests: everything is done once, and what's thrown comes back to the caller.
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <libethsupport/CommonIO.h>
+#include <libethsupport/Log.h>
+#include <libethsupport/ThreadPool.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace eth;
+
+BOOST_AUTO_TEST_CASE(thread_pool_tests)
+{
+	cnote << "Testing ThreadPool...";
+	ThreadPool pool(3);
+	BOOST_CHECK_EQUAL(pool.size(), 4);
+
+	for (size_t count: { 0, 1, 2, 1000 })
+	{
+		vector<atomic<unsigned>> done(count);
+		for (auto& i: done)
+			i = 0;
+		pool.run(count, [&](size_t i){ ++done[i]; });
+		for (auto const& i: done)
+			BOOST_CHECK_EQUAL(i.load(), 1);
+	}
+
+	// A run() from within another's is done on its caller's thread.
+	atomic<unsigned> inner(0);
+	pool.run(8, [&](size_t){ pool.run(8, [&](size_t){ ++inner; }); });
+	BOOST_CHECK_EQUAL(inner.load(), 64);
+
+	// What's thrown, on whichever thread, comes back to the caller.
+	for (size_t bad: { 0, 10, 999 })
+		BOOST_CHECK_THROW(pool.run(1000, [&](size_t i){ if (i == bad) throw runtime_error(toString(i)); }), runtime_error);
+
+	// And the pool is none the worse for it.
+	atomic<unsigned> after(0);
+	pool.run(100, [&](size_t){ ++after; });
+	BOOST_CHECK_EQUAL(after.load(), 100);
+}
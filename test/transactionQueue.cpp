@@ -0,0 +1,192 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file transactionQueue.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * Transaction queue tests: its indices stay in step as transactions come and go.
+ */
+
+#include <random>
+#include <libethsupport/Log.h>
+#include <libethereum/TransactionQueue.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace eth;
+
+static bytes signedTx(KeyPair const& _k, u256 _nonce, u256 _gasPrice, bytes const& _data = bytes())
+{
+	Transaction t;
+	t.nonce = _nonce;
+	t.value = 1;
+	t.receiveAddress = Address(1);
+	t.gasPrice = _gasPrice;
+	t.gas = 1000;
+	t.data = _data;
+	t.sign(_k.secret());
+	return t.rlp();
+}
+
+BOOST_AUTO_TEST_CASE(transaction_queue_tests)
+{
+	cnote << "Testing TransactionQueue...";
+	mt19937 eng(1);
+	vector<KeyPair> keys;
+	for (unsigned i = 0; i < 4; ++i)
+		keys.push_back(KeyPair::create());
+
+	// What should be queued: the best price seen for each sender and nonce.
+	map<pair<Address, u256>, u256> best;
+	TransactionQueue tq;
+	for (unsigned i = 0; i < 200; ++i)
+	{
+		auto const& k = keys[eng() % keys.size()];
+		u256 nonce = eng() % 20;
+		u256 price = eng() % 10 + 1;
+		auto key = make_pair(k.address(), nonce);
+		bool better = !best.count(key) || best[key] < price;
+		bytes tx = signedTx(k, nonce, price);
+		BOOST_CHECK_EQUAL(tq.import(&tx), better);
+		if (better)
+			best[key] = price;
+	}
+
+	BOOST_REQUIRE_EQUAL(tq.transactions().size(), best.size());
+	BOOST_REQUIRE_EQUAL(tq.byGasPrice().size(), best.size());
+	for (auto const& s: tq.bySender())
+		for (auto const& n: s.second)
+		{
+			Transaction const* t = tq.transaction(n.second);
+			BOOST_REQUIRE(t);
+			BOOST_CHECK(t->sender() == s.first);
+			BOOST_CHECK_EQUAL(t->nonce, n.first);
+			BOOST_CHECK_EQUAL(t->gasPrice, best[make_pair(s.first, n.first)]);
+			BOOST_CHECK(tq.byGasPrice().count(make_pair(t->gasPrice, n.second)));
+		}
+
+	// Drop the cheapest half; the rest stay indexed.
+	while (tq.byGasPrice().size() > best.size() / 2)
+		tq.drop(tq.byGasPrice().begin()->second);
+	size_t bySender = 0;
+	for (auto const& s: tq.bySender())
+	{
+		BOOST_CHECK(!s.second.empty());
+		bySender += s.second.size();
+	}
+	BOOST_CHECK_EQUAL(bySender, tq.transactions().size());
+	BOOST_CHECK_EQUAL(tq.byGasPrice().size(), tq.transactions().size());
+	for (auto const& i: tq.byGasPrice())
+		BOOST_CHECK(tq.transaction(i.second) && tq.transaction(i.second)->gasPrice == i.first);
+}
+
+BOOST_AUTO_TEST_CASE(transaction_queue_limits)
+{
+	cnote << "Testing TransactionQueue limits...";
+	KeyPair a = KeyPair::create();
+	KeyPair b = KeyPair::create();
+	TransactionQueue tq;
+	tq.setLimits(6, c_maxQueuedBytes, 4);
+
+	// Over the sender's limit, its furthest nonce goes.
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		bytes tx = signedTx(a, i + 1, 5 + i);
+		BOOST_CHECK(tq.import(&tx));
+	}
+	bytes far = signedTx(a, 9, 9);
+	BOOST_CHECK(!tq.import(&far));
+	bytes near = signedTx(a, 0, 9);
+	BOOST_CHECK(tq.import(&near));
+	BOOST_CHECK_EQUAL(tq.bySender().at(a.address()).size(), 4);
+	BOOST_CHECK(!tq.bySender().at(a.address()).count(4));
+
+	// Over the whole queue's, the cheapest goes, and its sender's of higher nonce with it.
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		bytes tx = signedTx(b, i, 7);
+		BOOST_CHECK(tq.import(&tx));
+	}
+	bytes cheap = signedTx(b, 2, 1);
+	BOOST_CHECK(!tq.import(&cheap));
+	bytes dear = signedTx(a, 1, 9);
+	BOOST_CHECK(tq.import(&dear));
+	BOOST_CHECK_EQUAL(tq.transactions().size(), 6);
+	tq.setLimits(4, c_maxQueuedBytes, 4);
+	BOOST_CHECK_EQUAL(tq.transactions().size(), 4);
+	BOOST_CHECK_EQUAL(tq.bySender().at(a.address()).size(), 2);
+	BOOST_CHECK_EQUAL(tq.bySender().at(b.address()).size(), 2);
+
+	auto s = tq.status();
+	BOOST_CHECK_EQUAL(s.transactions, 4);
+	BOOST_CHECK_EQUAL(s.senders, 2);
+	BOOST_CHECK_EQUAL(s.imported, 8);
+	BOOST_CHECK_EQUAL(s.rejected, 2);
+	BOOST_CHECK_EQUAL(s.replaced, 1);
+	BOOST_CHECK_EQUAL(s.evicted, 3);
+
+	// Nothing left but what's counted.
+	size_t bytes = 0;
+	for (auto const& i: tq.transactions())
+		bytes += i.second.size() + tq.transaction(i.first)->data.size();
+	BOOST_CHECK_EQUAL(s.bytes, bytes);
+}
+
+BOOST_AUTO_TEST_CASE(transaction_queue_eviction)
+{
+	cnote << "Testing TransactionQueue eviction...";
+	KeyPair a = KeyPair::create();
+	KeyPair b = KeyPair::create();
+	KeyPair c = KeyPair::create();
+	TransactionQueue tq;
+	tq.setLimits(4, c_maxQueuedBytes, 4);
+	for (auto const& tx: { signedTx(a, 0, 1), signedTx(a, 1, 1), signedTx(b, 0, 9), signedTx(b, 2, 9) })
+		BOOST_CHECK(tq.import(&tx));
+
+	// Behind a gap goes first, however well it pays.
+	bytes c0 = signedTx(c, 0, 5);
+	BOOST_CHECK(tq.import(&c0));
+	BOOST_CHECK_EQUAL(tq.transactions().size(), 4);
+	BOOST_CHECK(!tq.bySender().at(b.address()).count(2));
+	BOOST_CHECK_EQUAL(tq.bySender().at(a.address()).size(), 2);
+	BOOST_CHECK_EQUAL(tq.status().evicted, 1);
+
+	// One that would go with the cheapest is turned away, and what went with it comes back.
+	auto before = tq.transactions();
+	bytes a2 = signedTx(a, 2, 1);
+	BOOST_CHECK(!tq.import(&a2));
+	BOOST_CHECK(tq.transactions() == before);
+	BOOST_CHECK_EQUAL(tq.status().evicted, 1);
+	BOOST_CHECK_EQUAL(tq.status().rejected, 1);
+
+	// Nor is one lost to a replacement with no room for it.
+	TransactionQueue full;
+	bytes d0 = signedTx(a, 0, 5);
+	bytes e0 = signedTx(b, 0, 9);
+	BOOST_CHECK(full.import(&d0));
+	BOOST_CHECK(full.import(&e0));
+	size_t queued = full.status().bytes;
+	full.setLimits(c_maxQueuedTransactions, queued + 10, c_maxQueuedPerSender);
+	bytes d0big = signedTx(a, 0, 6, bytes(200, 1));
+	BOOST_CHECK(!full.import(&d0big));
+	BOOST_CHECK(full.transactions().count(sha3(d0)));
+	auto s = full.status();
+	BOOST_CHECK_EQUAL(s.transactions, 2);
+	BOOST_CHECK_EQUAL(s.bytes, queued);
+	BOOST_CHECK_EQUAL(s.replaced, 0);
+	BOOST_CHECK_EQUAL(s.evicted, 0);
+	BOOST_CHECK_EQUAL(s.rejected, 1);
+}
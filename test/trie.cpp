@@ -23,6 +23,7 @@
 #include <fstream>
 #include <random>
 #include "JsonSpiritHeaders.h"
+#include <libethsupport/ThreadPool.h>
 #include <libethsupport/TrieDB.h>
 #include "TrieHash.h"
 #include "MemTrie.h"
@@ -45,6 +46,38 @@ namespace eth
 	}
 }
 
+/// @returns @a _n random changes to the trie holding @a io_m, making them to @a io_m too. One in three is to a key
+/// already there, and one in @a _removes a remove.
+static map<string, string> randomChanges(mt19937& _eng, StringMap& io_m, unsigned _n, unsigned _removes)
+{
+	map<string, string> ret;
+	for (unsigned i = 0; i < _n; ++i)
+	{
+		string k = randomWord();
+		if (!io_m.empty() && _eng() % 3 == 0)
+		{
+			auto it = io_m.begin();
+			advance(it, _eng() % io_m.size());
+			k = it->first;
+		}
+		ret[k] = _eng() % _removes ? toString(_eng()) : string();
+	}
+	for (auto const& c: ret)
+		if (c.second.empty())
+			io_m.erase(c.first);
+		else
+			io_m[c.first] = c.second;
+	return ret;
+}
+
+/// @returns @a _changes as a batch for applyBatch(), referring into them.
+static vector<GenericTrieDB<MemoryDB>::Change> asBatch(map<string, string> const& _changes)
+{
+	vector<GenericTrieDB<MemoryDB>::Change> ret;
+	for (auto const& c: _changes)
+		ret.push_back(make_pair(bytesConstRef((byte const*)c.first.data(), c.first.size()), bytesConstRef((byte const*)c.second.data(), c.second.size())));
+	return ret;
+}
 
 BOOST_AUTO_TEST_CASE(trie_tests)
 {
@@ -302,3 +335,305 @@ BOOST_AUTO_TEST_CASE(trieStess)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(trieCopies)
+{
+	cnote << "Testing Tries over copied DBs...";
+	MemoryDB dm;
+	EnforceRefs e(dm, true);
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	StringMap m;
+	vector<pair<MemoryDB, StringMap>> copies;
+	vector<h256> roots;
+	// Enough copies for the DB's layers to get squashed a few times.
+	for (unsigned a = 0; a < c_maxMemoryDBLayers * 3; ++a)
+	{
+		for (int i = 0; i < 10; ++i)
+		{
+			auto k = randomWord();
+			auto v = toString(a * 10 + i);
+			m[k] = v;
+			d.insert(k, v);
+		}
+		if (a % 3 == 2)
+		{
+			d.remove(m.begin()->first);
+			m.erase(m.begin());
+		}
+		BOOST_REQUIRE_EQUAL(hash256(m), d.root());
+		copies.push_back(make_pair(dm, m));
+		roots.push_back(d.root());
+	}
+	BOOST_REQUIRE(d.check(true));
+
+	// Each copy still holds its trie, and changing one leaves the others be.
+	for (unsigned i = 0; i < copies.size(); ++i)
+	{
+		EnforceRefs ec(copies[i].first, true);
+		GenericTrieDB<MemoryDB> c(&copies[i].first, roots[i]);
+		BOOST_REQUIRE(c.check(true));
+		c.insert(string("copy"), toString(i));
+		copies[i].second["copy"] = toString(i);
+		BOOST_REQUIRE_EQUAL(hash256(copies[i].second), c.root());
+		roots[i] = c.root();
+	}
+	BOOST_REQUIRE(d.check(true));
+	BOOST_REQUIRE_EQUAL(hash256(m), d.root());
+	for (unsigned i = 0; i < copies.size(); ++i)
+	{
+		EnforceRefs ec(copies[i].first, true);
+		GenericTrieDB<MemoryDB> c(&copies[i].first, roots[i]);
+		BOOST_REQUIRE(c.check(true));
+		BOOST_REQUIRE_EQUAL(c.at(string("copy")), toString(i));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(trieNodeCache)
+{
+	cnote << "Testing the trie node cache...";
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+	StringMap m;
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto k = randomWord();
+		auto v = toString(i);
+		m[k] = v;
+		d.insert(k, v);
+	}
+	BOOST_REQUIRE_EQUAL(hash256(m), d.root());
+
+	// Copies share it; lookups through it find what's there, cold or warm, and nothing else.
+	MemoryDB copy = dm;
+	BOOST_REQUIRE(copy.nodeCache() == dm.nodeCache());
+	GenericTrieDB<MemoryDB> c(&copy, d.root());
+	for (unsigned pass = 0; pass < 2; ++pass)
+		for (auto const& i: m)
+		{
+			BOOST_REQUIRE_EQUAL(c.at(i.first), i.second);
+			BOOST_REQUIRE_EQUAL(c.at(i.first + "x"), string());
+		}
+	BOOST_CHECK(dm.nodeCache()->hits() > dm.nodeCache()->misses());
+
+	// Changing the trie leaves nodes cached that are no longer in it, but they're never reached.
+	for (unsigned i = 0; i < 100; ++i)
+	{
+		d.remove(m.begin()->first);
+		m.erase(m.begin());
+	}
+	BOOST_REQUIRE_EQUAL(hash256(m), d.root());
+	for (auto const& i: m)
+		BOOST_REQUIRE_EQUAL(d.at(i.first), i.second);
+
+	// Not enforcing refs is what lets it be used.
+	{
+		EnforceRefs e(dm, true);
+		BOOST_CHECK(!dm.nodeCache());
+		BOOST_REQUIRE(d.check(true));
+	}
+
+	// It stays within bounds, dropping the least recently used.
+	TrieNodeCache small(c_trieNodeCacheShards * 2);
+	vector<h256> hashes;
+	for (unsigned i = 0; i < c_trieNodeCacheShards * 8; ++i)
+	{
+		string rlp = asString((RLPStream(2) << toString(i) << "value").out());
+		hashes.push_back(sha3(rlp));
+		auto n = small.insert(hashes.back(), move(rlp));
+		BOOST_REQUIRE_EQUAL(n->node.itemCount, 2);
+		BOOST_REQUIRE_EQUAL(n->node.items[1].toString(), "value");
+	}
+	BOOST_CHECK(small.size() <= c_trieNodeCacheShards * 2);
+	BOOST_CHECK(small.find(hashes.back()));
+	BOOST_CHECK(!small.find(hashes.front()));
+}
+
+BOOST_AUTO_TEST_CASE(trieBatch)
+{
+	cnote << "Testing batched Trie updates...";
+	mt19937 eng(1);
+	for (unsigned a = 0; a < 100; ++a)
+	{
+		MemoryDB dm;
+		EnforceRefs e(dm, true);
+		GenericTrieDB<MemoryDB> d(&dm);
+		d.init();
+		StringMap m;
+		for (unsigned r = 0; r < 5; ++r)
+		{
+			// Inserts, and removes of keys that are there and keys that aren't.
+			auto changes = randomChanges(eng, m, eng() % (r ? 30 : 150), 3);
+			d.applyBatch(asBatch(changes));
+			BOOST_REQUIRE_EQUAL(hash256(m), d.root());
+			BOOST_REQUIRE(d.check(true));
+			for (auto const& i: m)
+				BOOST_REQUIRE_EQUAL(d.at(i.first), i.second);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(trieBatchParallel)
+{
+	cnote << "Testing batched Trie updates on threads...";
+	mt19937 eng(2);
+	ThreadPool pool(3);
+	for (unsigned a = 0; a < 10; ++a)
+	{
+		// The same batches, one trie updated on this thread and one on several; they must end up the same.
+		MemoryDB serialDB;
+		MemoryDB parallelDB;
+		EnforceRefs es(serialDB, true);
+		EnforceRefs ep(parallelDB, true);
+		GenericTrieDB<MemoryDB> serial(&serialDB);
+		GenericTrieDB<MemoryDB> parallel(&parallelDB);
+		serial.init();
+		parallel.init();
+		StringMap m;
+		for (unsigned r = 0; r < 4; ++r)
+		{
+			auto changes = randomChanges(eng, m, 1000, 4);
+			auto batch = asBatch(changes);
+			serial.applyBatch(batch);
+			parallel.applyBatch(batch, &pool);
+			BOOST_REQUIRE_EQUAL(hash256(m), serial.root());
+			BOOST_REQUIRE_EQUAL(serial.root(), parallel.root());
+			BOOST_REQUIRE(parallel.check(true));
+			BOOST_REQUIRE(serialDB.get() == parallelDB.get());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(trieSeek)
+{
+	cnote << "Testing Trie seeks and ranges...";
+	for (unsigned cached = 0; cached < 2; ++cached)
+	{
+		MemoryDB dm;
+		EnforceRefs e(dm, !cached);
+		GenericTrieDB<MemoryDB> d(&dm);
+		d.init();
+		BOOST_REQUIRE(d.begin() == d.end());
+		BOOST_REQUIRE(d.lower_bound(bytesConstRef()) == d.end());
+
+		StringMap m;
+		for (int i = 0; i < 500; ++i)
+		{
+			auto k = randomWord();
+			m[k] = toString(i);
+			d.insert(k, m[k]);
+		}
+
+		// Walking it all gives each entry, in order.
+		auto mit = m.begin();
+		for (auto const& i: d)
+		{
+			BOOST_REQUIRE(mit != m.end());
+			BOOST_REQUIRE_EQUAL(i.first.toString(), mit->first);
+			BOOST_REQUIRE_EQUAL(i.second.toString(), mit->second);
+			++mit;
+		}
+		BOOST_REQUIRE(mit == m.end());
+
+		// Seeking finds the first entry at or after a key, whether it's there, a prefix of one or between them.
+		vector<string> probes;
+		for (auto const& i: m)
+		{
+			probes.push_back(i.first);
+			probes.push_back(i.first + "\x7f");
+			probes.push_back(i.first.substr(0, i.first.size() / 2));
+		}
+		for (int i = 0; i < 200; ++i)
+			probes.push_back(randomWord());
+		probes.push_back(string());
+		probes.push_back(string(1, '\xff'));
+		for (auto const& p: probes)
+		{
+			auto it = d.lower_bound(p);
+			auto mit = m.lower_bound(p);
+			BOOST_REQUIRE_EQUAL(it == d.end(), mit == m.end());
+			if (mit != m.end())
+			{
+				BOOST_REQUIRE_EQUAL((*it).first.toString(), mit->first);
+				BOOST_REQUIRE_EQUAL((*it).second.toString(), mit->second);
+			}
+		}
+
+		// A range gives just the entries between its keys.
+		for (unsigned i = 0; i + 1 < probes.size(); i += 7)
+		{
+			string from = min(probes[i], probes[i + 1]);
+			string to = max(probes[i], probes[i + 1]);
+			auto mit = m.lower_bound(from);
+			for (auto const& j: d.range(bytesConstRef(&from), bytesConstRef(&to)))
+			{
+				BOOST_REQUIRE(mit != m.end() && mit->first < to);
+				BOOST_REQUIRE_EQUAL(j.first.toString(), mit->first);
+				++mit;
+			}
+			BOOST_REQUIRE(mit == m.lower_bound(to));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(trieProofs)
+{
+	cnote << "Testing Trie proofs...";
+	MemoryDB dm;
+	GenericTrieDB<MemoryDB> d(&dm);
+	d.init();
+
+	// The empty trie proves it has nothing.
+	string a = "a";
+	BOOST_REQUIRE(verifyTrieProof(d.root(), a, bytesConstRef(), d.prove(a)));
+
+	StringMap m;
+	for (int i = 0; i < 300; ++i)
+	{
+		auto k = randomWord();
+		m[k] = toString(i);
+		d.insert(k, m[k]);
+	}
+
+	for (auto const& i: m)
+	{
+		// What's there is proved, and nothing else is.
+		TrieProof p = d.prove(i.first);
+		BOOST_REQUIRE(verifyTrieProof(d.root(), i.first, i.second, p));
+		BOOST_REQUIRE(!verifyTrieProof(d.root(), i.first, i.second + "x", p));
+		BOOST_REQUIRE(!verifyTrieProof(d.root(), i.first, bytesConstRef(), p));
+		BOOST_REQUIRE(!verifyTrieProof(sha3(i.first), i.first, i.second, p));
+
+		// Nor does it stand with a node changed, missing or added.
+		TrieProof bad = p;
+		bad.back().back() ^= 1;
+		BOOST_REQUIRE(!verifyTrieProof(d.root(), i.first, i.second, bad));
+		bad = p;
+		bad.pop_back();
+		BOOST_REQUIRE(!verifyTrieProof(d.root(), i.first, i.second, bad));
+		bad = p;
+		bad.push_back(p.front());
+		BOOST_REQUIRE(!verifyTrieProof(d.root(), i.first, i.second, bad));
+
+		// Keys not there, a prefix of one or beyond it, are proved to be absent.
+		for (string k: {i.first + "\x7f", i.first.substr(0, i.first.size() - 1)})
+			if (!m.count(k))
+			{
+				TrieProof q = d.prove(k);
+				BOOST_REQUIRE(verifyTrieProof(d.root(), k, bytesConstRef(), q));
+				BOOST_REQUIRE(!verifyTrieProof(d.root(), k, i.second, q));
+			}
+	}
+
+	// Fixed-size keys, as in the state and storage tries.
+	using HashTrie = TrieDB<h256, MemoryDB>;
+	HashTrie t(&dm);
+	t.init();
+	for (unsigned i = 0; i < 100; ++i)
+		t.insert(h256(i), rlp(i + 1));
+	for (unsigned i = 0; i < 110; ++i)
+	{
+		bytes v = i < 100 ? rlp(i + 1) : bytes();
+		BOOST_REQUIRE(HashTrie::verify(t.root(), h256(i), &v, t.prove(h256(i))));
+	}
+}
@@ -22,10 +22,13 @@
 
 #include <fstream>
 #include <cstdint>
+#include <thread>
 #include <libethsupport/Log.h>
 #include <libethcore/Instruction.h>
 #include <libevm/ExtVMFace.h>
 #include <libevm/VM.h>
+#include <libevm/VMProfiler.h>
+#include <libevm/VMTrace.h>
 #include <liblll/Compiler.h>
 #include <libethereum/Transaction.h>
 #include "JsonSpiritHeaders.h"
@@ -377,7 +380,40 @@ public:
 	u256 gas;
 };
 
-void doTests(json_spirit::mValue& v, bool _fillin)
+/// The VM loops the tests can be run with; ThreadedStepped is the threaded loop limited in steps, and so without
+/// fusing, and Traced is the reference loop writing a trace.
+enum class Loop { Reference, Threaded, ThreadedStepped, Traced };
+
+static const char* c_traceFile = "vmtests.evmt";
+
+/// Check that replaying the trace of the run that left @a _vm as it is, on @a _fev, ends up in the same place.
+void checkTrace(VM const& _vm, FakeExtVM& _fev)
+{
+	bytes trace = contents(c_traceFile);
+	VMTraceReader r(&trace);
+	VMTraceFrame f;
+	u256 gas;
+	Instruction last = Instruction::STOP;
+	while (r.next())
+		if (r.record() == VMTraceRecord::Step && !r.depth())
+			last = r.instruction();
+		else if (r.record() == VMTraceRecord::Exit && !r.depth())
+		{
+			f = r.frame();
+			gas = r.gas();
+		}
+
+	// RETURN leaves without saying what it took from the stack.
+	if (last == Instruction::RETURN && f.stack.size() >= 2)
+		f.stack.resize(f.stack.size() - 2);
+	BOOST_CHECK(f.stack == _vm.stack());
+	BOOST_CHECK(f.memory == _vm.memory());
+	BOOST_CHECK(gas == _vm.gas());
+	for (auto const& i: f.storage)
+		BOOST_CHECK(_fev.store(i.first) == i.second);
+}
+
+void doTests(json_spirit::mValue& v, bool _fillin, Loop _loop = Loop::Reference)
 {
 	for (auto& i: v.get_obj())
 	{
@@ -401,7 +437,15 @@ void doTests(json_spirit::mValue& v, bool _fillin)
 		{
 			fev.importExec(i.get_obj());
 			vm.reset(fev.gas);
-			output = vm.go(fev).toBytes();
+			if (_loop == Loop::Traced)
+			{
+				VMTracer::open(c_traceFile);
+				output = vm.go(fev).toBytes();
+				VMTracer::close();
+				checkTrace(vm, fev);
+			}
+			else
+				output = (_loop == Loop::ThreadedStepped ? vm.goThreaded(fev, (uint64_t)1 << 40) : _loop == Loop::Threaded ? vm.goThreaded(fev) : vm.goReference(fev)).toBytes();
 		}
 		if (_fillin)
 		{
@@ -492,10 +536,48 @@ BOOST_AUTO_TEST_CASE(vm_tests)
 		string s = asString(contents("../../../tests/vmtests.json"));
 		BOOST_REQUIRE_MESSAGE(s.length() > 0, "Contents of 'vmtests.json' is empty. Have you cloned the 'tests' repo branch develop?");
 		json_spirit::read_string(s, v);
+		json_spirit::mValue threaded = v;
+		json_spirit::mValue stepped = v;
+		json_spirit::mValue traced = v;
 		eth::test::doTests(v, false);
+		cnote << "Testing threaded VM...";
+		eth::test::doTests(threaded, false, eth::test::Loop::Threaded);
+		cnote << "Testing threaded VM, limited in steps...";
+		eth::test::doTests(stepped, false, eth::test::Loop::ThreadedStepped);
+		cnote << "Testing traced VM...";
+		eth::test::doTests(traced, false, eth::test::Loop::Traced);
 	}
 	catch( std::exception& e)
 	{
 		BOOST_ERROR("Failed VM Test with Exception: " << e.what()); 
 	}
 }
+
+BOOST_AUTO_TEST_CASE(vm_profiler_threads)
+{
+	cnote << "Testing VM profiles of threads that exit...";
+	VMProfiler::reset();
+	unsigned before = VMProfiler::threads();
+
+	// Each thread counts some ADDs and some runs of one piece of code, then exits.
+	h256 code = sha3(string("code"));
+	for (unsigned i = 0; i < 20; ++i)
+	{
+		std::thread t([&]()
+		{
+			VMProfiler& p = VMProfiler::thread();
+			VMProfiler::bump(p.opcode((byte)Instruction::ADD).count, 3);
+			VMProfiler::bump(p.code(code).runs, 1);
+		});
+		t.join();
+	}
+
+	// What they counted stays, but their counters don't.
+	VMProfile p = VMProfiler::profile();
+	BOOST_CHECK_EQUAL(p.opcodes[(byte)Instruction::ADD].count, 60);
+	BOOST_CHECK_EQUAL(p.code[code].runs, 20);
+	BOOST_CHECK_EQUAL(VMProfiler::threads(), before);
+
+	VMProfiler::reset();
+	BOOST_CHECK(!VMProfiler::profile().opcodes[(byte)Instruction::ADD].count);
+}
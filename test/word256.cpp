@@ -0,0 +1,90 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file word256.cpp
+ * @author Gav Wood <i@gavwood.com>
+ * @date 2014
+ * VM word arithmetic tests, checked against u256.
+ */
+
+#include <random>
+#include <libethsupport/Log.h>
+#include <libevm/Word256.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace eth;
+
+static u256 randomU256(mt19937_64& _eng)
+{
+	// Bias towards the awkward cases: zero/full limbs, set sign bits, small values.
+	u256 ret = 0;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		uint64_t l = _eng();
+		switch (_eng() % 5)
+		{
+		case 0: l = 0; break;
+		case 1: l = ~uint64_t(0); break;
+		case 2: l |= uint64_t(1) << 63; break;
+		default: break;
+		}
+		ret = (ret << 64) | l;
+	}
+	switch (_eng() % 4)
+	{
+	case 0: return ret >> (_eng() % 256);
+	case 1: return _eng() % 3;
+	default: return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(word256_tests)
+{
+	cnote << "Testing VM words...";
+	mt19937_64 eng(1);
+	for (unsigned t = 0; t < 20000; ++t)
+	{
+		u256 a = randomU256(eng);
+		u256 b = randomU256(eng);
+		word256 x(a);
+		word256 y(b);
+		unsigned e = (unsigned)b % 300;
+
+		BOOST_REQUIRE((u256)x == a);
+		BOOST_REQUIRE(word256((h256)a) == x && (h256)x == (h256)a);
+		BOOST_REQUIRE((unsigned)x == (unsigned)a);
+		BOOST_CHECK((u256)(x + y) == a + b);
+		BOOST_CHECK((u256)(x - y) == a - b);
+		BOOST_CHECK((u256)(x * y) == a * b);
+		BOOST_CHECK((u256)(x & y) == (a & b));
+		BOOST_CHECK((u256)(x | y) == (a | b));
+		BOOST_CHECK((u256)(x ^ y) == (a ^ b));
+		BOOST_CHECK((u256)~(x - 1) == ~(a - 1));
+		BOOST_CHECK((u256)(x << e) == a << e);
+		BOOST_CHECK((u256)(x >> e) == a >> e);
+		BOOST_CHECK((u256)pow(x, e) == boost::multiprecision::pow(a, e));
+		BOOST_CHECK((x < y) == (a < b) && (x > y) == (a > b) && (x == y) == (a == b));
+		BOOST_CHECK(slt(x, y) == (u2s(a) < u2s(b)) && sgt(x, y) == (u2s(a) > u2s(b)));
+		if (b)
+		{
+			BOOST_CHECK((u256)(x / y) == a / b);
+			BOOST_CHECK((u256)(x % y) == a % b);
+			BOOST_CHECK((u256)sdiv(x, y) == s2u(u2s(a) / u2s(b)));
+			BOOST_CHECK((u256)smod(x, y) == s2u(u2s(a) % u2s(b)));
+		}
+	}
+}